@@ -540,7 +540,7 @@ blocklist_apps_cb (gpointer data)
   /* Don’t bother saving the app filter (which could result in asking the user
    * for admin permission) if it hasn’t changed. */
   if (self->last_saved_filter != NULL &&
-      mct_app_filter_equal (new_filter, self->last_saved_filter))
+      mct_app_filter_policy_equal (new_filter, self->last_saved_filter))
     {
       g_debug ("Not saving app filter as it hasn’t changed");
       return G_SOURCE_REMOVE;
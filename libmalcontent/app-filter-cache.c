@@ -0,0 +1,450 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2020 Endless Mobile, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gdesktopappinfo.h>
+#include <gio/gio.h>
+#include <libmalcontent/app-filter.h>
+#include <libmalcontent/app-filter-cache.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "libmalcontent/app-filter-cache-private.h"
+
+
+/* Enough of the status of a file to tell whether it has been replaced or
+ * modified since it was last checked, even within the same second. */
+typedef struct
+{
+  dev_t dev;
+  ino_t ino;
+  struct timespec mtime;
+  struct timespec ctime;
+} FileIdentity;
+
+/* A cached result of mct_app_filter_is_appinfo_allowed() for an app, which
+ * was loaded from the desktop file at @filename while it had @identity. */
+typedef struct
+{
+  gchar *filename;  /* (owned) (not nullable) (type filename) */
+  FileIdentity identity;
+  gboolean allowed;
+} CachedVerdict;
+
+static void
+cached_verdict_free (CachedVerdict *verdict)
+{
+  g_free (verdict->filename);
+  g_free (verdict);
+}
+
+/**
+ * MctAppFilterCache:
+ *
+ * #MctAppFilterCache caches the results of
+ * mct_app_filter_is_appinfo_allowed() for an #MctAppFilter, for callers which
+ * check the same apps repeatedly, such as app launchers.
+ *
+ * Results are cached by desktop ID (see g_app_info_get_id()), so checking an
+ * app which has already been checked is a single hash table lookup. A result
+ * is only used for an app loaded from the same desktop file as it was
+ * calculated for. When installed apps change (as notified by
+ * #GAppInfoMonitor), the results for any desktop files which have been
+ * modified, replaced or removed are dropped. All results are dropped when the
+ * filter is replaced using mct_app_filter_cache_set_filter(), or when `$PATH`
+ * changes, as programs are looked up in it.
+ *
+ * Apps which don’t have a desktop ID, or don’t come from a desktop file, are
+ * not cached, and are checked using mct_app_filter_is_appinfo_allowed() every
+ * time.
+ *
+ * An #MctAppFilterCache must only be used from the thread which created it,
+ * and the #GMainContext which was the thread-default when it was created must
+ * be iterated for the cache to notice when apps change. Until then, results
+ * for a modified desktop file may be out of date.
+ *
+ * Since: 0.11.0
+ */
+struct _MctAppFilterCache
+{
+  GObject parent_instance;
+
+  MctAppFilter *filter;  /* (owned) (not nullable) */
+
+  GAppInfoMonitor *monitor;  /* (owned) */
+  gulong monitor_changed_id;
+
+  GHashTable *verdicts;  /* (owned) (element-type utf8 CachedVerdict) */
+
+  /* Value of `$PATH` which @verdicts were calculated with. */
+  gchar *path;  /* (owned) (nullable) */
+
+  /* Number of checks answered from @verdicts, for testing. */
+  guint n_hits;
+};
+
+G_DEFINE_TYPE (MctAppFilterCache, mct_app_filter_cache, G_TYPE_OBJECT)
+
+typedef enum
+{
+  PROP_FILTER = 1,
+} MctAppFilterCacheProperty;
+
+static GParamSpec *props[PROP_FILTER + 1] = { NULL, };
+
+static void
+mct_app_filter_cache_init (MctAppFilterCache *self)
+{
+  self->verdicts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                          (GDestroyNotify) cached_verdict_free);
+}
+
+static void
+mct_app_filter_cache_get_property (GObject    *object,
+                                   guint       property_id,
+                                   GValue     *value,
+                                   GParamSpec *spec)
+{
+  MctAppFilterCache *self = MCT_APP_FILTER_CACHE (object);
+
+  switch ((MctAppFilterCacheProperty) property_id)
+    {
+    case PROP_FILTER:
+      g_value_set_boxed (value, self->filter);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, spec);
+      break;
+    }
+}
+
+static void
+mct_app_filter_cache_set_property (GObject      *object,
+                                   guint         property_id,
+                                   const GValue *value,
+                                   GParamSpec   *spec)
+{
+  MctAppFilterCache *self = MCT_APP_FILTER_CACHE (object);
+
+  switch ((MctAppFilterCacheProperty) property_id)
+    {
+    case PROP_FILTER:
+      mct_app_filter_cache_set_filter (self, g_value_get_boxed (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, spec);
+      break;
+    }
+}
+
+static void app_info_monitor_changed_cb (GAppInfoMonitor *monitor,
+                                         gpointer         user_data);
+
+static void
+mct_app_filter_cache_constructed (GObject *object)
+{
+  MctAppFilterCache *self = MCT_APP_FILTER_CACHE (object);
+
+  /* Chain up. */
+  G_OBJECT_CLASS (mct_app_filter_cache_parent_class)->constructed (object);
+
+  g_assert (self->filter != NULL);
+
+  /* Invalidate the cache whenever installed apps change. */
+  self->monitor = g_app_info_monitor_get ();
+  self->monitor_changed_id = g_signal_connect (self->monitor, "changed",
+                                               (GCallback) app_info_monitor_changed_cb,
+                                               self);
+}
+
+static void
+mct_app_filter_cache_dispose (GObject *object)
+{
+  MctAppFilterCache *self = MCT_APP_FILTER_CACHE (object);
+
+  if (self->monitor_changed_id != 0 && self->monitor != NULL)
+    {
+      g_signal_handler_disconnect (self->monitor, self->monitor_changed_id);
+      self->monitor_changed_id = 0;
+    }
+  g_clear_object (&self->monitor);
+
+  g_clear_pointer (&self->filter, mct_app_filter_unref);
+  g_clear_pointer (&self->verdicts, g_hash_table_unref);
+  g_clear_pointer (&self->path, g_free);
+
+  G_OBJECT_CLASS (mct_app_filter_cache_parent_class)->dispose (object);
+}
+
+static void
+mct_app_filter_cache_class_init (MctAppFilterCacheClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->constructed = mct_app_filter_cache_constructed;
+  object_class->dispose = mct_app_filter_cache_dispose;
+  object_class->get_property = mct_app_filter_cache_get_property;
+  object_class->set_property = mct_app_filter_cache_set_property;
+
+  /**
+   * MctAppFilterCache:filter: (not nullable)
+   *
+   * The app filter which verdicts are cached for. Changing it invalidates the
+   * cache, unless the new filter is equal to the old one.
+   *
+   * Since: 0.11.0
+   */
+  props[PROP_FILTER] = g_param_spec_boxed ("filter",
+                                           "Filter",
+                                           "The app filter which verdicts are cached for.",
+                                           MCT_TYPE_APP_FILTER,
+                                           G_PARAM_READWRITE |
+                                           G_PARAM_CONSTRUCT |
+                                           G_PARAM_STATIC_STRINGS |
+                                           G_PARAM_EXPLICIT_NOTIFY);
+
+  g_object_class_install_properties (object_class,
+                                     G_N_ELEMENTS (props),
+                                     props);
+}
+
+/**
+ * mct_app_filter_cache_new:
+ * @filter: (transfer none): the app filter to cache verdicts for
+ *
+ * Create a new #MctAppFilterCache for @filter.
+ *
+ * Returns: (transfer full): a new #MctAppFilterCache
+ * Since: 0.11.0
+ */
+MctAppFilterCache *
+mct_app_filter_cache_new (MctAppFilter *filter)
+{
+  g_return_val_if_fail (filter != NULL, NULL);
+
+  return g_object_new (MCT_TYPE_APP_FILTER_CACHE,
+                       "filter", filter,
+                       NULL);
+}
+
+static gboolean
+get_file_identity (const gchar  *filename,
+                   FileIdentity *identity_out)
+{
+  struct stat statbuf;
+
+  if (stat (filename, &statbuf) != 0)
+    return FALSE;
+
+  identity_out->dev = statbuf.st_dev;
+  identity_out->ino = statbuf.st_ino;
+  identity_out->mtime = statbuf.st_mtim;
+  identity_out->ctime = statbuf.st_ctim;
+
+  return TRUE;
+}
+
+static gboolean
+file_identity_equal (const FileIdentity *a,
+                     const FileIdentity *b)
+{
+  return (a->dev == b->dev &&
+          a->ino == b->ino &&
+          a->mtime.tv_sec == b->mtime.tv_sec &&
+          a->mtime.tv_nsec == b->mtime.tv_nsec &&
+          a->ctime.tv_sec == b->ctime.tv_sec &&
+          a->ctime.tv_nsec == b->ctime.tv_nsec);
+}
+
+static gboolean
+verdict_is_stale_cb (gpointer key,
+                     gpointer value,
+                     gpointer user_data)
+{
+  const CachedVerdict *verdict = value;
+  FileIdentity identity;
+
+  return (!get_file_identity (verdict->filename, &identity) ||
+          !file_identity_equal (&identity, &verdict->identity));
+}
+
+static void
+app_info_monitor_changed_cb (GAppInfoMonitor *monitor,
+                             gpointer         user_data)
+{
+  MctAppFilterCache *self = MCT_APP_FILTER_CACHE (user_data);
+
+  /* Some desktop files have changed. Only drop the verdicts for those, so
+   * installing one app doesn’t cause all the others to be checked again. */
+  g_hash_table_foreach_remove (self->verdicts, verdict_is_stale_cb, NULL);
+}
+
+/**
+ * mct_app_filter_cache_get_filter:
+ * @self: an #MctAppFilterCache
+ *
+ * Get the value of #MctAppFilterCache:filter.
+ *
+ * Returns: (transfer none): the app filter verdicts are cached for
+ * Since: 0.11.0
+ */
+MctAppFilter *
+mct_app_filter_cache_get_filter (MctAppFilterCache *self)
+{
+  g_return_val_if_fail (MCT_IS_APP_FILTER_CACHE (self), NULL);
+
+  return self->filter;
+}
+
+/**
+ * mct_app_filter_cache_set_filter:
+ * @self: an #MctAppFilterCache
+ * @filter: (transfer none): the new app filter to cache verdicts for
+ *
+ * Set the value of #MctAppFilterCache:filter. If @filter is not equal to the
+ * current filter (according to mct_app_filter_equal()), all cached verdicts
+ * are invalidated.
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_cache_set_filter (MctAppFilterCache *self,
+                                 MctAppFilter      *filter)
+{
+  g_autoptr(MctAppFilter) old_filter = NULL;
+
+  g_return_if_fail (MCT_IS_APP_FILTER_CACHE (self));
+  g_return_if_fail (filter != NULL);
+
+  if (self->filter == filter)
+    return;
+
+  old_filter = g_steal_pointer (&self->filter);
+  self->filter = mct_app_filter_ref (filter);
+
+  if (old_filter == NULL || !mct_app_filter_equal (old_filter, filter))
+    mct_app_filter_cache_invalidate (self);
+
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_FILTER]);
+}
+
+/**
+ * mct_app_filter_cache_is_appinfo_allowed:
+ * @self: an #MctAppFilterCache
+ * @app_info: (transfer none): application information
+ *
+ * Check whether the app with the given @app_info is allowed to be run
+ * according to #MctAppFilterCache:filter. The result is the same as that of
+ * mct_app_filter_is_appinfo_allowed(), but is cached for apps which have a
+ * desktop ID and come from a desktop file, so repeated checks of the same app
+ * are cheap.
+ *
+ * Returns: %TRUE if the user the filter corresponds to is allowed to run the
+ *    app represented by @app_info according to the filter policy; %FALSE
+ *    otherwise
+ * Since: 0.11.0
+ */
+gboolean
+mct_app_filter_cache_is_appinfo_allowed (MctAppFilterCache *self,
+                                         GAppInfo          *app_info)
+{
+  const gchar *id, *filename, *path;
+  CachedVerdict *verdict;
+  FileIdentity identity;
+  gboolean allowed;
+
+  g_return_val_if_fail (MCT_IS_APP_FILTER_CACHE (self), FALSE);
+  g_return_val_if_fail (G_IS_APP_INFO (app_info), FALSE);
+
+  id = g_app_info_get_id (app_info);
+  filename = G_IS_DESKTOP_APP_INFO (app_info) ?
+             g_desktop_app_info_get_filename (G_DESKTOP_APP_INFO (app_info)) : NULL;
+
+  if (id == NULL || filename == NULL)
+    return mct_app_filter_is_appinfo_allowed (self->filter, app_info);
+
+  /* Programs are looked up in `$PATH`, so the verdicts depend on it. */
+  path = g_getenv ("PATH");
+  if (g_strcmp0 (path, self->path) != 0)
+    {
+      mct_app_filter_cache_invalidate (self);
+      g_free (self->path);
+      self->path = g_strdup (path);
+    }
+
+  /* The desktop ID might now refer to a different desktop file, if another
+   * app with the same ID has been installed which takes precedence. */
+  verdict = g_hash_table_lookup (self->verdicts, id);
+  if (verdict != NULL && g_str_equal (verdict->filename, filename))
+    {
+      self->n_hits++;
+      return verdict->allowed;
+    }
+
+  allowed = mct_app_filter_is_appinfo_allowed (self->filter, app_info);
+
+  /* Note the status of the desktop file, so the verdict can be dropped if the
+   * file changes. If the file has gone, don’t cache the verdict. */
+  if (!get_file_identity (filename, &identity))
+    {
+      g_hash_table_remove (self->verdicts, id);
+      return allowed;
+    }
+
+  verdict = g_new0 (CachedVerdict, 1);
+  verdict->filename = g_strdup (filename);
+  verdict->identity = identity;
+  verdict->allowed = allowed;
+  g_hash_table_replace (self->verdicts, g_strdup (id), verdict);
+
+  return allowed;
+}
+
+/**
+ * mct_app_filter_cache_invalidate:
+ * @self: an #MctAppFilterCache
+ *
+ * Drop all cached verdicts, so that subsequent checks recalculate them. This
+ * is done automatically when installed apps change, or when
+ * #MctAppFilterCache:filter changes, so it typically doesn’t need to be called.
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_cache_invalidate (MctAppFilterCache *self)
+{
+  g_return_if_fail (MCT_IS_APP_FILTER_CACHE (self));
+
+  g_hash_table_remove_all (self->verdicts);
+}
+
+/* Get the number of checks which have been answered from the cache, so the
+ * tests can tell whether it’s being used. */
+guint
+_mct_app_filter_cache_get_n_hits (MctAppFilterCache *self)
+{
+  g_return_val_if_fail (MCT_IS_APP_FILTER_CACHE (self), 0);
+
+  return self->n_hits;
+}
@@ -0,0 +1,43 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2020 Endless Mobile, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib-object.h>
+#include <libmalcontent/app-filter.h>
+
+G_BEGIN_DECLS
+
+#define MCT_TYPE_APP_FILTER_CACHE mct_app_filter_cache_get_type ()
+G_DECLARE_FINAL_TYPE (MctAppFilterCache, mct_app_filter_cache, MCT, APP_FILTER_CACHE, GObject)
+
+MctAppFilterCache *mct_app_filter_cache_new (MctAppFilter *filter);
+
+MctAppFilter *mct_app_filter_cache_get_filter (MctAppFilterCache *self);
+void          mct_app_filter_cache_set_filter (MctAppFilterCache *self,
+                                               MctAppFilter      *filter);
+
+gboolean      mct_app_filter_cache_is_appinfo_allowed (MctAppFilterCache *self,
+                                                       GAppInfo          *app_info);
+
+void          mct_app_filter_cache_invalidate (MctAppFilterCache *self);
+
+G_END_DECLS
@@ -46,18 +46,81 @@ typedef enum
   MCT_APP_FILTER_LIST_ALLOWLIST,
 } MctAppFilterListType;
 
+/* Number of sections defined by OARS 1.0 and 1.1. */
+#define MCT_APP_FILTER_N_KNOWN_OARS_SECTIONS 28
+
+/* A prefix pattern from the app list: the first @len bytes of @str, which is
+ * borrowed from the app list and is not nul-terminated at @len. */
+typedef struct
+{
+  const gchar *str;
+  gsize len;
+} MctAppFilterPrefix;
+
 struct _MctAppFilter
 {
-  gint ref_count;
+  gint ref_count;  /* (atomic) */
 
   uid_t user_id;
 
-  gchar **app_list;  /* (not nullable) (owned) (array zero-terminated=1) */
+  /* The strings in @app_list are borrowed from @app_list_variant, so that a
+   * deserialised filter shares them with the variant it was loaded from rather
+   * than copying them. If string interning is enabled (see
+   * mct_app_filter_set_intern_strings()), the strings are interned instead,
+   * and @app_list_variant is %NULL. */
+  const gchar **app_list;  /* (not nullable) (owned) (array zero-terminated=1) */
+  GVariant *app_list_variant;  /* (type as) (nullable) (owned non-floating) */
   MctAppFilterListType app_list_type;
 
+  /* Indexes over the entries in @app_list, split by the kind of entry. The
+   * keys are borrowed from @app_list, which remains the canonical form. */
+  GHashTable *app_list_paths;  /* (not nullable) (owned) (element-type utf8 utf8) */
+  GHashTable *app_list_flatpak_refs;  /* (not nullable) (owned) (element-type utf8 utf8) */
+  GHashTable *app_list_content_types;  /* (not nullable) (owned) (element-type utf8 utf8) */
+
+  /* App IDs extracted from the `app/` flatpak refs in @app_list. These are
+   * owned by the table, or interned if @app_list is. */
+  GHashTable *app_list_flatpak_app_ids;  /* (not nullable) (owned) (element-type utf8 utf8) */
+
+  /* Prefix patterns (entries ending in `*`) from @app_list, split by kind
+   * like the indexes above. Each array is sorted, and prefixes which are
+   * covered by a shorter prefix are removed, so that a query can be matched
+   * with a single binary search. */
+  GArray *app_list_flatpak_ref_prefixes;  /* (not nullable) (owned) (element-type MctAppFilterPrefix) */
+  GArray *app_list_flatpak_app_id_prefixes;  /* (not nullable) (owned) (element-type MctAppFilterPrefix) */
+  GArray *app_list_content_type_prefixes;  /* (not nullable) (owned) (element-type MctAppFilterPrefix) */
+
   GVariant *oars_ratings;  /* (type a{ss}) (owned non-floating) */
+
+  /* Decoded form of @oars_ratings, which is only kept for serialisation.
+   * Sections defined by OARS 1.0 and 1.1 are stored in @oars_known_values,
+   * indexed by their position in the table of known sections in app-filter.c.
+   * A known section is only present if its bit is set in @oars_known_present.
+   * Any other sections are stored in @oars_unknown_values, whose keys are
+   * borrowed from @oars_ratings. */
+  guint32 oars_known_present;
+  MctAppFilterOarsValue oars_known_values[MCT_APP_FILTER_N_KNOWN_OARS_SECTIONS];
+  GHashTable *oars_unknown_values;  /* (nullable) (owned) (element-type utf8 MctAppFilterOarsValue) */
+
   gboolean allow_user_installation;
   gboolean allow_system_installation;
+
+  /* Properties derived from the above, which are calculated once at
+   * construction as the filter is immutable. The strings in @oars_sections are
+   * borrowed from the OARS tables. */
+  gboolean is_enabled;
+  const gchar **oars_sections;  /* (owned) (array zero-terminated=1 length=n_oars_sections) */
+  gsize n_oars_sections;
+
+  /* Derived properties which are calculated on first use, as not all users
+   * need them. As the filter may be used from multiple threads, each is set
+   * atomically, once. */
+  GBytes *serialized;  /* (nullable) (owned) (atomic) */
+  gchar *digest;  /* (nullable) (owned) (atomic) */
+
+  /* Content types from @app_list_content_types, plus all the registered
+   * content types which are subclasses of them. */
+  GHashTable *content_type_closure;  /* (nullable) (owned) (atomic) (element-type utf8 utf8) */
 };
 
 G_END_DECLS
@@ -45,11 +45,41 @@ mct_app_filter_error_quark (void)
 G_DEFINE_BOXED_TYPE (MctAppFilter, mct_app_filter,
                      mct_app_filter_ref, mct_app_filter_unref)
 
+/* Whether to intern app list entries in new filters. See
+ * mct_app_filter_set_intern_strings(). */
+static gint intern_strings = FALSE;  /* (atomic) */
+
+/**
+ * mct_app_filter_set_intern_strings:
+ * @enabled: %TRUE to intern app list entries, %FALSE otherwise
+ *
+ * Set whether app filters created after this call store their app list
+ * entries in the process-wide string pool used by g_intern_string(), rather
+ * than each holding its own copy.
+ *
+ * This reduces memory use in processes which hold the app filters for a lot
+ * of users at once, where the same flatpak refs and content types typically
+ * appear in many of them. However, interned strings are never freed, so it
+ * should only be enabled in processes which will see a bounded set of
+ * entries. It is disabled by default.
+ *
+ * This affects mct_app_filter_deserialize() and mct_app_filter_builder_end().
+ * It does not change the behaviour of any app filter methods.
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_set_intern_strings (gboolean enabled)
+{
+  g_atomic_int_set (&intern_strings, !!enabled);
+}
+
 /**
  * mct_app_filter_ref:
  * @filter: (transfer none): an #MctAppFilter
  *
  * Increment the reference count of @filter, and return the same pointer to it.
+ * This is atomic, so is safe to call from multiple threads.
  *
  * Returns: (transfer full): the same pointer as @filter
  * Since: 0.2.0
@@ -58,10 +88,10 @@ MctAppFilter *
 mct_app_filter_ref (MctAppFilter *filter)
 {
   g_return_val_if_fail (filter != NULL, NULL);
-  g_return_val_if_fail (filter->ref_count >= 1, NULL);
-  g_return_val_if_fail (filter->ref_count <= G_MAXINT - 1, NULL);
+  g_return_val_if_fail (g_atomic_int_get (&filter->ref_count) >= 1, NULL);
+  g_return_val_if_fail (g_atomic_int_get (&filter->ref_count) <= G_MAXINT - 1, NULL);
 
-  filter->ref_count++;
+  g_atomic_int_inc (&filter->ref_count);
   return filter;
 }
 
@@ -70,7 +100,8 @@ mct_app_filter_ref (MctAppFilter *filter)
  * @filter: (transfer full): an #MctAppFilter
  *
  * Decrement the reference count of @filter. If the reference count reaches
- * zero, free the @filter and all its resources.
+ * zero, free the @filter and all its resources. This is atomic, so is safe to
+ * call from multiple threads.
  *
  * Since: 0.2.0
  */
@@ -78,13 +109,24 @@ void
 mct_app_filter_unref (MctAppFilter *filter)
 {
   g_return_if_fail (filter != NULL);
-  g_return_if_fail (filter->ref_count >= 1);
+  g_return_if_fail (g_atomic_int_get (&filter->ref_count) >= 1);
 
-  filter->ref_count--;
-
-  if (filter->ref_count <= 0)
+  if (g_atomic_int_dec_and_test (&filter->ref_count))
     {
-      g_strfreev (filter->app_list);
+      g_array_unref (filter->app_list_content_type_prefixes);
+      g_array_unref (filter->app_list_flatpak_app_id_prefixes);
+      g_array_unref (filter->app_list_flatpak_ref_prefixes);
+      g_hash_table_unref (filter->app_list_flatpak_app_ids);
+      g_hash_table_unref (filter->app_list_content_types);
+      g_hash_table_unref (filter->app_list_flatpak_refs);
+      g_hash_table_unref (filter->app_list_paths);
+      g_clear_pointer (&filter->content_type_closure, g_hash_table_unref);
+      g_free (filter->digest);
+      g_clear_pointer (&filter->serialized, g_bytes_unref);
+      g_free (filter->app_list);
+      g_clear_pointer (&filter->app_list_variant, g_variant_unref);
+      g_free (filter->oars_sections);
+      g_clear_pointer (&filter->oars_unknown_values, g_hash_table_unref);
       g_variant_unref (filter->oars_ratings);
       g_free (filter);
     }
@@ -123,6 +165,181 @@ oars_str_to_enum (const gchar *value_str)
     return MCT_APP_FILTER_OARS_VALUE_UNKNOWN;
 }
 
+/* Sections defined by OARS 1.0 and 1.1, in lexicographic order so they can be
+ * binary searched. The index of a section in this table is its index in
+ * #MctAppFilter.oars_known_values. */
+static const gchar * const oars_known_sections[] =
+{
+  "drugs-alcohol",
+  "drugs-narcotics",
+  "drugs-tobacco",
+  "language-discrimination",
+  "language-humor",
+  "language-profanity",
+  "money-advertising",
+  "money-gambling",
+  "money-purchasing",
+  "sex-adultery",
+  "sex-appearance",
+  "sex-homosexuality",
+  "sex-nudity",
+  "sex-prostitution",
+  "sex-themes",
+  "social-audio",
+  "social-chat",
+  "social-contacts",
+  "social-info",
+  "social-location",
+  "violence-bloodshed",
+  "violence-cartoon",
+  "violence-desecration",
+  "violence-fantasy",
+  "violence-realistic",
+  "violence-sexual",
+  "violence-slavery",
+  "violence-worship",
+};
+
+G_STATIC_ASSERT (G_N_ELEMENTS (oars_known_sections) == MCT_APP_FILTER_N_KNOWN_OARS_SECTIONS);
+G_STATIC_ASSERT (MCT_APP_FILTER_N_KNOWN_OARS_SECTIONS <= sizeof (guint32) * 8);
+
+/* Get the index of @oars_section in oars_known_sections, or -1 if it’s not a
+ * section defined by OARS 1.0 or 1.1. */
+static gint
+oars_known_section_index (const gchar *oars_section)
+{
+  gsize lower = 0;
+  gsize upper = G_N_ELEMENTS (oars_known_sections);
+
+  while (lower < upper)
+    {
+      gsize mid = lower + (upper - lower) / 2;
+      int cmp = strcmp (oars_section, oars_known_sections[mid]);
+
+      if (cmp == 0)
+        return (gint) mid;
+      else if (cmp < 0)
+        upper = mid;
+      else
+        lower = mid + 1;
+    }
+
+  return -1;
+}
+
+/* Decode @filter->oars_ratings into the OARS lookup tables in @filter, so that
+ * queries don’t have to parse the variant. If a section appears more than once
+ * in the variant, the first value is used, as with g_variant_lookup(). */
+static void
+mct_app_filter_decode_oars_ratings (MctAppFilter *filter)
+{
+  GVariantIter iter;
+  const gchar *oars_section, *oars_value;
+
+  filter->oars_known_present = 0;
+  filter->oars_unknown_values = NULL;
+
+  g_variant_iter_init (&iter, filter->oars_ratings);
+
+  while (g_variant_iter_next (&iter, "{&s&s}", &oars_section, &oars_value))
+    {
+      MctAppFilterOarsValue value = oars_str_to_enum (oars_value);
+      gint idx = oars_known_section_index (oars_section);
+
+      if (idx >= 0)
+        {
+          if (!(filter->oars_known_present & (1u << idx)))
+            {
+              filter->oars_known_present |= (1u << idx);
+              filter->oars_known_values[idx] = value;
+            }
+        }
+      else
+        {
+          if (filter->oars_unknown_values == NULL)
+            filter->oars_unknown_values = g_hash_table_new (g_str_hash, g_str_equal);
+
+          if (!g_hash_table_contains (filter->oars_unknown_values, oars_section))
+            g_hash_table_insert (filter->oars_unknown_values,
+                                 (gpointer) oars_section, GINT_TO_POINTER (value));
+        }
+    }
+}
+
+static gint
+strcmp_cb (gconstpointer a,
+           gconstpointer b)
+{
+  const gchar *str_a = *((const gchar * const *) a);
+  const gchar *str_b = *((const gchar * const *) b);
+
+  return g_strcmp0 (str_a, str_b);
+}
+
+/* Calculate the properties of @filter which are derived from its other
+ * members, so that mct_app_filter_is_enabled() and
+ * mct_app_filter_get_oars_sections() don’t have to recalculate them on every
+ * call. The filter is immutable, so they can never change. This must be called
+ * after mct_app_filter_build_app_list_index() and
+ * mct_app_filter_decode_oars_ratings(). */
+static void
+mct_app_filter_calculate_derived_properties (MctAppFilter *filter)
+{
+  g_autoptr(GPtrArray) sections = g_ptr_array_new_with_free_func (NULL);
+  gboolean oars_ratings_all_intense_or_unknown;
+  GHashTableIter iter;
+  gpointer oars_section, value_ptr;
+
+  /* The least restrictive OARS filter has all values as intense, or unknown. */
+  oars_ratings_all_intense_or_unknown = TRUE;
+
+  for (gsize i = 0; i < G_N_ELEMENTS (oars_known_sections); i++)
+    {
+      MctAppFilterOarsValue value = filter->oars_known_values[i];
+
+      if (!(filter->oars_known_present & (1u << i)))
+        continue;
+
+      g_ptr_array_add (sections, (gpointer) oars_known_sections[i]);
+
+      if (value != MCT_APP_FILTER_OARS_VALUE_UNKNOWN &&
+          value != MCT_APP_FILTER_OARS_VALUE_INTENSE)
+        oars_ratings_all_intense_or_unknown = FALSE;
+    }
+
+  if (filter->oars_unknown_values != NULL)
+    {
+      g_hash_table_iter_init (&iter, filter->oars_unknown_values);
+
+      while (g_hash_table_iter_next (&iter, &oars_section, &value_ptr))
+        {
+          MctAppFilterOarsValue value = GPOINTER_TO_INT (value_ptr);
+
+          g_ptr_array_add (sections, oars_section);
+
+          if (value != MCT_APP_FILTER_OARS_VALUE_UNKNOWN &&
+              value != MCT_APP_FILTER_OARS_VALUE_INTENSE)
+            oars_ratings_all_intense_or_unknown = FALSE;
+        }
+    }
+
+  /* Sort alphabetically for easier comparisons later. */
+  g_ptr_array_sort (sections, strcmp_cb);
+
+  filter->n_oars_sections = sections->len;
+  g_ptr_array_add (sections, NULL);  /* NULL terminator */
+  filter->oars_sections = (const gchar **) g_ptr_array_free (g_steal_pointer (&sections), FALSE);
+
+  /* Check all fields against their default values. Ignore
+   * `allow_system_installation` since it’s false by default, so the default
+   * value is already the most restrictive. */
+  filter->is_enabled = ((filter->app_list_type == MCT_APP_FILTER_LIST_BLOCKLIST &&
+                         filter->app_list[0] != NULL) ||
+                        filter->app_list_type == MCT_APP_FILTER_LIST_ALLOWLIST ||
+                        !oars_ratings_all_intense_or_unknown ||
+                        !filter->allow_user_installation);
+}
+
 /**
  * mct_app_filter_is_enabled:
  * @filter: an #MctAppFilter
@@ -138,37 +355,84 @@ oars_str_to_enum (const gchar *value_str)
 gboolean
 mct_app_filter_is_enabled (MctAppFilter *filter)
 {
-  gboolean oars_ratings_all_intense_or_unknown;
-  GVariantIter iter;
-  const gchar *oars_value;
-
   g_return_val_if_fail (filter != NULL, FALSE);
   g_return_val_if_fail (filter->ref_count >= 1, FALSE);
 
-  /* The least restrictive OARS filter has all values as intense, or unknown. */
-  oars_ratings_all_intense_or_unknown = TRUE;
-  g_variant_iter_init (&iter, filter->oars_ratings);
+  return filter->is_enabled;
+}
+
+/* Check whether @path is an absolute path which is already in the form
+ * g_canonicalize_filename() would return for it, and is valid UTF-8, so it can
+ * be used for lookups as-is. This doesn’t allocate. It returns %FALSE for some
+ * unusual paths which are canonical (such as those starting with `//`), which
+ * is fine as callers then fall back to canonicalising them. */
+static gboolean
+is_canonical_utf8_path (const gchar *path)
+{
+  const gchar *p;
+
+  if (*path != '/')
+    return FALSE;
+
+  /* Check there are no empty, `.` or `..` components, and no trailing slash.
+   * @p points to the slash before each component. The root path `/` is the only
+   * one which may end in a slash. */
+  p = (path[1] != '\0') ? path : path + 1;
 
-  while (g_variant_iter_loop (&iter, "{&s&s}", NULL, &oars_value))
+  while (*p != '\0')
     {
-      MctAppFilterOarsValue value = oars_str_to_enum (oars_value);
+      const gchar *component = p + 1;
+      gsize component_len = strcspn (component, "/");
 
-      if (value != MCT_APP_FILTER_OARS_VALUE_UNKNOWN &&
-          value != MCT_APP_FILTER_OARS_VALUE_INTENSE)
-        {
-          oars_ratings_all_intense_or_unknown = FALSE;
-          break;
-        }
+      if (component_len == 0 ||
+          (component_len == 1 && component[0] == '.') ||
+          (component_len == 2 && component[0] == '.' && component[1] == '.'))
+        return FALSE;
+
+      p = component + component_len;
     }
 
-  /* Check all fields against their default values. Ignore
-   * `allow_system_installation` since it’s false by default, so the default
-   * value is already the most restrictive. */
-  return ((filter->app_list_type == MCT_APP_FILTER_LIST_BLOCKLIST &&
-           filter->app_list[0] != NULL) ||
-          filter->app_list_type == MCT_APP_FILTER_LIST_ALLOWLIST ||
-          !oars_ratings_all_intense_or_unknown ||
-          !filter->allow_user_installation);
+  /* If the filename encoding is UTF-8, g_filename_to_utf8() only validates. */
+  return (g_get_filename_charsets (NULL) &&
+          g_utf8_validate (path, -1, NULL));
+}
+
+/* Canonicalise @path as mct_app_filter_is_path_allowed() and
+ * mct_app_filter_builder_blocklist_path() require. If @path is already
+ * canonical, it is returned and @path_out is not set; otherwise the
+ * canonicalised path is returned and also stored in @path_out, which the
+ * caller must free. %NULL is returned if @path can’t be converted to UTF-8. */
+static const gchar *
+canonicalize_utf8_path (const gchar  *path,
+                        gchar       **path_out)
+{
+  g_autofree gchar *canonical_path = NULL;
+
+  if (is_canonical_utf8_path (path))
+    return path;
+
+  canonical_path = g_canonicalize_filename (path, "/");
+  *path_out = g_filename_to_utf8 (canonical_path, -1, NULL, NULL, NULL);
+
+  return *path_out;
+}
+
+/* Check whether the canonical UTF-8 @path is allowed by @filter. */
+static gboolean
+canonical_path_is_allowed (MctAppFilter *filter,
+                           const gchar  *path)
+{
+  gboolean path_in_list = g_hash_table_contains (filter->app_list_paths, path);
+
+  switch (filter->app_list_type)
+    {
+    case MCT_APP_FILTER_LIST_BLOCKLIST:
+      return !path_in_list;
+    case MCT_APP_FILTER_LIST_ALLOWLIST:
+      return path_in_list;
+    default:
+      g_assert_not_reached ();
+    }
 }
 
 /**
@@ -179,6 +443,8 @@ mct_app_filter_is_enabled (MctAppFilter *filter)
  * Check whether the program at @path is allowed to be run according to this
  * app filter. @path will be canonicalised without doing any I/O.
  *
+ * If @path is already canonical, this does not allocate.
+ *
  * Returns: %TRUE if the user this @filter corresponds to is allowed to run the
  *    program at @path according to the @filter policy; %FALSE otherwise
  * Since: 0.2.0
@@ -187,28 +453,47 @@ gboolean
 mct_app_filter_is_path_allowed (MctAppFilter *filter,
                                 const gchar  *path)
 {
+  g_autofree gchar *canonical_path_owned = NULL;
+  const gchar *canonical_path;
+
   g_return_val_if_fail (filter != NULL, FALSE);
   g_return_val_if_fail (filter->ref_count >= 1, FALSE);
   g_return_val_if_fail (path != NULL, FALSE);
   g_return_val_if_fail (g_path_is_absolute (path), FALSE);
 
-  g_autofree gchar *canonical_path = g_canonicalize_filename (path, "/");
-  g_autofree gchar *canonical_path_utf8 = g_filename_to_utf8 (canonical_path, -1,
-                                                              NULL, NULL, NULL);
-  g_return_val_if_fail (canonical_path_utf8 != NULL, FALSE);
+  canonical_path = canonicalize_utf8_path (path, &canonical_path_owned);
+  g_return_val_if_fail (canonical_path != NULL, FALSE);
 
-  gboolean path_in_list = g_strv_contains ((const gchar * const *) filter->app_list,
-                                           canonical_path_utf8);
+  return canonical_path_is_allowed (filter, canonical_path);
+}
 
-  switch (filter->app_list_type)
-    {
-    case MCT_APP_FILTER_LIST_BLOCKLIST:
-      return !path_in_list;
-    case MCT_APP_FILTER_LIST_ALLOWLIST:
-      return path_in_list;
-    default:
-      g_assert_not_reached ();
-    }
+/**
+ * mct_app_filter_is_canonical_path_allowed:
+ * @filter: an #MctAppFilter
+ * @path: absolute, canonical path of a program to check
+ *
+ * Check whether the program at @path is allowed to be run according to this
+ * app filter. This is a version of mct_app_filter_is_path_allowed() for
+ * callers who have already canonicalised @path, for example using
+ * g_canonicalize_filename() followed by g_filename_to_utf8(). It does no
+ * canonicalisation or conversion of @path itself, and never allocates.
+ *
+ * If @path is not canonical, the result is undefined.
+ *
+ * Returns: %TRUE if the user this @filter corresponds to is allowed to run the
+ *    program at @path according to the @filter policy; %FALSE otherwise
+ * Since: 0.11.0
+ */
+gboolean
+mct_app_filter_is_canonical_path_allowed (MctAppFilter *filter,
+                                          const gchar  *path)
+{
+  g_return_val_if_fail (filter != NULL, FALSE);
+  g_return_val_if_fail (filter->ref_count >= 1, FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (g_path_is_absolute (path), FALSE);
+
+  return canonical_path_is_allowed (filter, path);
 }
 
 /* Check whether a given @ref is a valid flatpak ref.
@@ -221,22 +506,222 @@ mct_app_filter_is_path_allowed (MctAppFilter *filter,
  *
  * We avoid using flatpak_ref_parse() to allow for libflatpak
  * to depend on malcontent without causing a cyclic dependency.
+ *
+ * This is called in the preconditions of every query, so it scans @ref once
+ * and doesn’t allocate.
  */
 static gboolean
 is_valid_flatpak_ref (const gchar *ref)
 {
-  g_auto(GStrv) parts = NULL;
+  const gchar *p;
+  gsize n_slashes = 0;
+  gsize component_len = 0;
 
   if (ref == NULL)
     return FALSE;
 
-  parts = g_strsplit (ref, "/", 0);
-  return (g_strv_length (parts) == 4 &&
-          (strcmp (parts[0], "app") == 0 ||
-           strcmp (parts[0], "runtime") == 0) &&
-          *parts[1] != '\0' &&
-          *parts[2] != '\0' &&
-          *parts[3] != '\0');
+  if (g_str_has_prefix (ref, "app/"))
+    p = ref + strlen ("app/");
+  else if (g_str_has_prefix (ref, "runtime/"))
+    p = ref + strlen ("runtime/");
+  else
+    return FALSE;
+
+  /* The name, arch and branch must be separated by exactly one slash each. */
+  for (; *p != '\0'; p++)
+    {
+      if (*p != '/')
+        {
+          component_len++;
+          continue;
+        }
+
+      if (component_len == 0 || ++n_slashes > 2)
+        return FALSE;
+
+      component_len = 0;
+    }
+
+  return (n_slashes == 2 && component_len > 0);
+}
+
+/* Check whether the first @len bytes of @prefix could be the start of a valid
+ * flatpak ref, as checked by is_valid_flatpak_ref(). The prefix must include
+ * the `app/` or `runtime/` kind, so `app/com.example.` and `runtime/` are
+ * valid, but `ap` is not. */
+static gboolean
+is_valid_flatpak_ref_prefix (const gchar *prefix,
+                             gsize        len)
+{
+  const gchar *p, *end = prefix + len;
+  gsize n_slashes = 0;
+  gsize component_len = 0;
+
+  if (len >= strlen ("app/") && strncmp (prefix, "app/", strlen ("app/")) == 0)
+    p = prefix + strlen ("app/");
+  else if (len >= strlen ("runtime/") && strncmp (prefix, "runtime/", strlen ("runtime/")) == 0)
+    p = prefix + strlen ("runtime/");
+  else
+    return FALSE;
+
+  /* As with is_valid_flatpak_ref(), but the final component may be empty or
+   * missing. */
+  for (; p < end; p++)
+    {
+      if (*p != '/')
+        {
+          component_len++;
+          continue;
+        }
+
+      if (component_len == 0 || ++n_slashes > 2)
+        return FALSE;
+
+      component_len = 0;
+    }
+
+  return TRUE;
+}
+
+/* Check whether a given @content_type is valid.
+ *
+ * For simplicity this method will only check whether:
+ * - the @content_type contains exactly 1 slash char
+ * - the @content_type does not start with a slash char
+ * - the type and subtype components of the @content_type are not empty
+ *
+ * Like is_valid_flatpak_ref(), this scans @content_type once and doesn’t
+ * allocate.
+ */
+static gboolean
+is_valid_content_type (const gchar *content_type)
+{
+  const gchar *slash;
+
+  if (content_type == NULL)
+    return FALSE;
+
+  slash = strchr (content_type, '/');
+
+  return (slash != NULL &&
+          slash != content_type &&
+          slash[1] != '\0' &&
+          strchr (slash + 1, '/') == NULL);
+}
+
+/* Check whether the first @len bytes of @prefix could be the start of a valid
+ * content type, as checked by is_valid_content_type(). For example,
+ * `x-scheme-handler/` and `image/x-` are valid. */
+static gboolean
+is_valid_content_type_prefix (const gchar *prefix,
+                              gsize        len)
+{
+  const gchar *slash;
+
+  if (len == 0 || prefix[0] == '/')
+    return FALSE;
+
+  slash = memchr (prefix, '/', len);
+
+  return (slash == NULL ||
+          memchr (slash + 1, '/', len - (slash + 1 - prefix)) == NULL);
+}
+
+/* If @entry is a prefix pattern — a prefix followed by a single `*`, which is
+ * the only `*` in the entry, where the prefix is valid as the start of a
+ * flatpak ref or a content type — return the length of the prefix. Otherwise,
+ * return 0, and @entry is matched literally. */
+static gsize
+prefix_pattern_len (const gchar *entry)
+{
+  const gchar *star = strchr (entry, '*');
+  gsize len;
+
+  if (star == NULL || star == entry || star[1] != '\0')
+    return 0;
+
+  len = star - entry;
+
+  if (!is_valid_flatpak_ref_prefix (entry, len) &&
+      !is_valid_content_type_prefix (entry, len))
+    return 0;
+
+  return len;
+}
+
+static gint
+prefix_cmp (gconstpointer a,
+            gconstpointer b)
+{
+  const MctAppFilterPrefix *prefix_a = a;
+  const MctAppFilterPrefix *prefix_b = b;
+  gint cmp = strncmp (prefix_a->str, prefix_b->str, MIN (prefix_a->len, prefix_b->len));
+
+  if (cmp != 0)
+    return cmp;
+  else if (prefix_a->len < prefix_b->len)
+    return -1;
+  else if (prefix_a->len > prefix_b->len)
+    return 1;
+  else
+    return 0;
+}
+
+/* Sort @prefixes and remove any prefix which starts with another prefix in the
+ * array, as it can only match strings which the shorter prefix already
+ * matches. A prefix sorts directly before the entries it is a prefix of, so
+ * this only needs to compare each entry with the last one kept. */
+static void
+prefix_set_compile (GArray *prefixes)
+{
+  gsize n_kept = 0;
+
+  g_array_sort (prefixes, prefix_cmp);
+
+  for (gsize i = 0; i < prefixes->len; i++)
+    {
+      MctAppFilterPrefix prefix = g_array_index (prefixes, MctAppFilterPrefix, i);
+
+      if (n_kept > 0)
+        {
+          const MctAppFilterPrefix *last = &g_array_index (prefixes, MctAppFilterPrefix, n_kept - 1);
+
+          if (last->len <= prefix.len &&
+              strncmp (last->str, prefix.str, last->len) == 0)
+            continue;
+        }
+
+      g_array_index (prefixes, MctAppFilterPrefix, n_kept++) = prefix;
+    }
+
+  g_array_set_size (prefixes, n_kept);
+}
+
+/* Check whether @str starts with any of the prefixes in @prefixes, which must
+ * have been compiled with prefix_set_compile(). As no prefix in the array
+ * starts with another, at most one can match @str, and all the prefixes before
+ * it in the array compare less than @str; so a binary search finds it. */
+static gboolean
+prefix_set_matches (GArray      *prefixes,
+                    const gchar *str)
+{
+  gsize lower = 0, upper = prefixes->len;
+
+  while (lower < upper)
+    {
+      gsize mid = lower + (upper - lower) / 2;
+      const MctAppFilterPrefix *prefix = &g_array_index (prefixes, MctAppFilterPrefix, mid);
+      gint cmp = strncmp (prefix->str, str, prefix->len);
+
+      if (cmp == 0)
+        return TRUE;
+      else if (cmp < 0)
+        lower = mid + 1;
+      else
+        upper = mid;
+    }
+
+  return FALSE;
 }
 
 /**
@@ -245,7 +730,9 @@ is_valid_flatpak_ref (const gchar *ref)
  * @app_ref: flatpak ref for the app, for example `app/org.gnome.Builder/x86_64/master`
  *
  * Check whether the flatpak app with the given @app_ref is allowed to be run
- * according to this app filter.
+ * according to this app filter. This matches @app_ref against the flatpak refs
+ * in the app list, and against any flatpak ref prefixes (see
+ * mct_app_filter_builder_blocklist_flatpak_ref_prefix()).
  *
  * Returns: %TRUE if the user this @filter corresponds to is allowed to run the
  *    flatpak called @app_ref according to the @filter policy; %FALSE otherwise
@@ -260,8 +747,10 @@ mct_app_filter_is_flatpak_ref_allowed (MctAppFilter *filter,
   g_return_val_if_fail (app_ref != NULL, FALSE);
   g_return_val_if_fail (is_valid_flatpak_ref (app_ref), FALSE);
 
-  gboolean ref_in_list = g_strv_contains ((const gchar * const *) filter->app_list,
-                                          app_ref);
+  gboolean ref_in_list = (g_hash_table_contains (filter->app_list_flatpak_refs,
+                                                 app_ref) ||
+                           prefix_set_matches (filter->app_list_flatpak_ref_prefixes,
+                                               app_ref));
 
   switch (filter->app_list_type)
     {
@@ -285,6 +774,8 @@ mct_app_filter_is_flatpak_ref_allowed (MctAppFilter *filter,
  * contains flatpak refs (for example, `app/org.gnome.Builder/x86_64/master`)
  * which contain architecture and branch information. App IDs (for example,
  * `org.gnome.Builder`) do not contain architecture or branch information.
+ * Flatpak ref prefixes which end within the app ID (for example,
+ * `app/org.gnome.*`) match all app IDs which start with that part of them.
  *
  * Returns: %TRUE if the user this @filter corresponds to is allowed to run the
  *    flatpak called @app_id according to the @filter policy; %FALSE otherwise
@@ -298,20 +789,10 @@ mct_app_filter_is_flatpak_app_allowed (MctAppFilter *filter,
   g_return_val_if_fail (filter->ref_count >= 1, FALSE);
   g_return_val_if_fail (app_id != NULL, FALSE);
 
-  gsize app_id_len = strlen (app_id);
-
-  gboolean id_in_list = FALSE;
-  for (gsize i = 0; filter->app_list[i] != NULL; i++)
-    {
-      if (is_valid_flatpak_ref (filter->app_list[i]) &&
-          g_str_has_prefix (filter->app_list[i], "app/") &&
-          strncmp (filter->app_list[i] + strlen ("app/"), app_id, app_id_len) == 0 &&
-          filter->app_list[i][strlen ("app/") + app_id_len] == '/')
-        {
-          id_in_list = TRUE;
-          break;
-        }
-    }
+  gboolean id_in_list = (g_hash_table_contains (filter->app_list_flatpak_app_ids,
+                                                app_id) ||
+                          prefix_set_matches (filter->app_list_flatpak_app_id_prefixes,
+                                              app_id));
 
   switch (filter->app_list_type)
     {
@@ -324,45 +805,125 @@ mct_app_filter_is_flatpak_app_allowed (MctAppFilter *filter,
     }
 }
 
-/**
- * mct_app_filter_is_appinfo_allowed:
- * @filter: an #MctAppFilter
- * @app_info: (transfer none): application information
- *
- * Check whether the app with the given @app_info is allowed to be run
- * according to this app filter. This matches on multiple keys potentially
- * present in the #GAppInfo, including the path of the executable.
- *
- * Returns: %TRUE if the user this @filter corresponds to is allowed to run the
- *    app represented by @app_info according to the @filter policy; %FALSE
- *    otherwise
- * Since: 0.2.0
- */
-gboolean
-mct_app_filter_is_appinfo_allowed (MctAppFilter *filter,
-                                   GAppInfo     *app_info)
+/* State for checking one or more #GAppInfos against a filter. The flags are
+ * worked out once from the filter, rather than for each app: a blocklist with
+ * no entries of a given kind can never block an app because of that kind, so
+ * the lookups for it can be skipped entirely. When checking a batch of apps,
+ * the verdicts for executables and content types are also cached, as lots of
+ * apps share them (for example, all flatpak apps are run using `flatpak`, and
+ * finding that in `$PATH` does I/O). */
+typedef struct
+{
+  MctAppFilter *filter;  /* (unowned) */
+
+  gboolean check_program;
+  gboolean check_flatpak_apps;
+
+  GHashTable *program_verdicts;  /* (nullable) (owned) (element-type filename gboolean) */
+  GHashTable *content_type_verdicts;  /* (nullable) (owned) (element-type utf8 gboolean) */
+} AppInfoCheck;
+
+static void
+app_info_check_init (AppInfoCheck *check,
+                     MctAppFilter *filter,
+                     gboolean      cache_verdicts)
 {
+  gboolean is_blocklist = (filter->app_list_type == MCT_APP_FILTER_LIST_BLOCKLIST);
+
+  check->filter = filter;
+  check->check_program = (!is_blocklist ||
+                          g_hash_table_size (filter->app_list_paths) > 0);
+  check->check_flatpak_apps = (!is_blocklist ||
+                               g_hash_table_size (filter->app_list_flatpak_app_ids) > 0 ||
+                               filter->app_list_flatpak_app_id_prefixes->len > 0);
+
+  if (cache_verdicts)
+    {
+      check->program_verdicts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      check->content_type_verdicts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    }
+  else
+    {
+      check->program_verdicts = NULL;
+      check->content_type_verdicts = NULL;
+    }
+}
+
+static void
+app_info_check_clear (AppInfoCheck *check)
+{
+  g_clear_pointer (&check->program_verdicts, g_hash_table_unref);
+  g_clear_pointer (&check->content_type_verdicts, g_hash_table_unref);
+}
+
+/* Check whether the executable for @app_info, as found in `$PATH`, is
+ * allowed. An executable which can’t be found is allowed, as it can’t be
+ * run anyway. */
+static gboolean
+app_info_check_program (AppInfoCheck *check,
+                        GAppInfo     *app_info)
+{
+  const gchar *executable = g_app_info_get_executable (app_info);
   g_autofree gchar *abs_path = NULL;
-  const gchar * const *types = NULL;
+  gpointer verdict;
+  gboolean allowed;
 
-  g_return_val_if_fail (filter != NULL, FALSE);
-  g_return_val_if_fail (filter->ref_count >= 1, FALSE);
-  g_return_val_if_fail (G_IS_APP_INFO (app_info), FALSE);
+  if (!check->check_program)
+    return TRUE;
+
+  if (check->program_verdicts != NULL && executable != NULL &&
+      g_hash_table_lookup_extended (check->program_verdicts, executable, NULL, &verdict))
+    return GPOINTER_TO_INT (verdict);
+
+  abs_path = g_find_program_in_path (executable);
+  allowed = (abs_path == NULL ||
+             mct_app_filter_is_path_allowed (check->filter, abs_path));
+
+  if (check->program_verdicts != NULL && executable != NULL)
+    g_hash_table_insert (check->program_verdicts, g_strdup (executable),
+                         GINT_TO_POINTER (allowed));
+
+  return allowed;
+}
+
+static gboolean
+app_info_check_content_type (AppInfoCheck *check,
+                             const gchar  *content_type)
+{
+  gpointer verdict;
+  gboolean allowed;
+
+  if (check->content_type_verdicts != NULL &&
+      g_hash_table_lookup_extended (check->content_type_verdicts, content_type, NULL, &verdict))
+    return GPOINTER_TO_INT (verdict);
+
+  allowed = mct_app_filter_is_content_type_allowed (check->filter, content_type);
 
-  abs_path = g_find_program_in_path (g_app_info_get_executable (app_info));
+  if (check->content_type_verdicts != NULL)
+    g_hash_table_insert (check->content_type_verdicts, g_strdup (content_type),
+                         GINT_TO_POINTER (allowed));
+
+  return allowed;
+}
+
+/* Implementation of mct_app_filter_is_appinfo_allowed(). */
+static gboolean
+app_info_check_is_allowed (AppInfoCheck *check,
+                           GAppInfo     *app_info)
+{
+  const gchar * const *types = NULL;
 
-  if (abs_path != NULL &&
-      !mct_app_filter_is_path_allowed (filter, abs_path))
+  if (!app_info_check_program (check, app_info))
     return FALSE;
 
   types = g_app_info_get_supported_types (app_info);
   for (gsize i = 0; types != NULL && types[i] != NULL; i++)
     {
-      if (!mct_app_filter_is_content_type_allowed (filter, types[i]))
+      if (!app_info_check_content_type (check, types[i]))
         return FALSE;
     }
 
-  if (G_IS_DESKTOP_APP_INFO (app_info))
+  if (check->check_flatpak_apps && G_IS_DESKTOP_APP_INFO (app_info))
     {
       g_autofree gchar *flatpak_app = NULL;
       g_autofree gchar *old_flatpak_apps_str = NULL;
@@ -373,7 +934,7 @@ mct_app_filter_is_appinfo_allowed (MctAppFilter *filter,
         flatpak_app = g_strstrip (flatpak_app);
 
       if (flatpak_app != NULL &&
-          !mct_app_filter_is_flatpak_app_allowed (filter, flatpak_app))
+          !mct_app_filter_is_flatpak_app_allowed (check->filter, flatpak_app))
         return FALSE;
 
       /* FIXME: This could do with the g_desktop_app_info_get_string_list() API
@@ -392,7 +953,7 @@ mct_app_filter_is_appinfo_allowed (MctAppFilter *filter,
               old_flatpak_app = g_strstrip (old_flatpak_app);
 
               if (*old_flatpak_app != '\0' &&
-                  !mct_app_filter_is_flatpak_app_allowed (filter, old_flatpak_app))
+                  !mct_app_filter_is_flatpak_app_allowed (check->filter, old_flatpak_app))
                 return FALSE;
             }
         }
@@ -401,25 +962,81 @@ mct_app_filter_is_appinfo_allowed (MctAppFilter *filter,
   return TRUE;
 }
 
-/* Check whether a given @content_type is valid.
+/**
+ * mct_app_filter_is_appinfo_allowed:
+ * @filter: an #MctAppFilter
+ * @app_info: (transfer none): application information
  *
- * For simplicity this method will only check whether:
- * - the @content_type contains exactly 1 slash char
- * - the @content_type does not start with a slash char
- * - the type and subtype components of the @content_type are not empty
+ * Check whether the app with the given @app_info is allowed to be run
+ * according to this app filter. This matches on multiple keys potentially
+ * present in the #GAppInfo, including the path of the executable.
+ *
+ * Returns: %TRUE if the user this @filter corresponds to is allowed to run the
+ *    app represented by @app_info according to the @filter policy; %FALSE
+ *    otherwise
+ * Since: 0.2.0
  */
-static gboolean
-is_valid_content_type (const gchar *content_type)
+gboolean
+mct_app_filter_is_appinfo_allowed (MctAppFilter *filter,
+                                   GAppInfo     *app_info)
 {
-  g_auto(GStrv) parts = NULL;
+  AppInfoCheck check;
+  gboolean allowed;
 
-  if (content_type == NULL)
-    return FALSE;
+  g_return_val_if_fail (filter != NULL, FALSE);
+  g_return_val_if_fail (filter->ref_count >= 1, FALSE);
+  g_return_val_if_fail (G_IS_APP_INFO (app_info), FALSE);
+
+  app_info_check_init (&check, filter, FALSE);
+  allowed = app_info_check_is_allowed (&check, app_info);
+  app_info_check_clear (&check);
+
+  return allowed;
+}
 
-  parts = g_strsplit (content_type, "/", 0);
-  return (g_strv_length (parts) == 2 &&
-          *parts[0] != '\0' &&
-          *parts[1] != '\0');
+/**
+ * mct_app_filter_check_app_infos:
+ * @filter: an #MctAppFilter
+ * @app_infos: (array length=n_app_infos): applications to check
+ * @n_app_infos: number of elements in @app_infos
+ *
+ * Check whether each of the apps in @app_infos is allowed to be run according
+ * to this app filter. This is equivalent to calling
+ * mct_app_filter_is_appinfo_allowed() on each of them, but is faster for
+ * large numbers of apps, as it shares work between them: the lookup of each
+ * executable in `$PATH`, and the check of each content type, is only done
+ * once for the whole batch.
+ *
+ * Returns: (transfer full) (array length=n_app_infos): array of verdicts, one
+ *    for each element of @app_infos, which are %TRUE if the user this @filter
+ *    corresponds to is allowed to run the corresponding app; %FALSE otherwise
+ * Since: 0.11.0
+ */
+gboolean *
+mct_app_filter_check_app_infos (MctAppFilter     *filter,
+                                GAppInfo * const *app_infos,
+                                gsize             n_app_infos)
+{
+  AppInfoCheck check;
+  g_autofree gboolean *allowed = NULL;
+
+  g_return_val_if_fail (filter != NULL, NULL);
+  g_return_val_if_fail (filter->ref_count >= 1, NULL);
+  g_return_val_if_fail (app_infos != NULL || n_app_infos == 0, NULL);
+
+  for (gsize i = 0; i < n_app_infos; i++)
+    g_return_val_if_fail (G_IS_APP_INFO (app_infos[i]), NULL);
+
+  allowed = g_new0 (gboolean, n_app_infos);
+
+  app_info_check_init (&check, filter, TRUE);
+
+  for (gsize i = 0; i < n_app_infos; i++)
+    allowed[i] = app_info_check_is_allowed (&check, app_infos[i]);
+
+  app_info_check_clear (&check);
+
+  return g_steal_pointer (&allowed);
 }
 
 /**
@@ -433,6 +1050,9 @@ is_valid_content_type (const gchar *content_type)
  * Note that this method doesn’t match content subtypes. For example, if
  * `application/xml` is added to the blocklist but `application/xspf+xml` is not,
  * a check for whether `application/xspf+xml` is blocklisted would return false.
+ * Use mct_app_filter_is_content_type_hierarchy_allowed() to match subtypes.
+ * It does match content type prefixes (see
+ * mct_app_filter_builder_blocklist_content_type_prefix()).
  *
  * Returns: %TRUE if the user this @filter corresponds to is allowed to run
  *    programs handling @content_type according to the @filter policy;
@@ -448,8 +1068,10 @@ mct_app_filter_is_content_type_allowed (MctAppFilter *filter,
   g_return_val_if_fail (content_type != NULL, FALSE);
   g_return_val_if_fail (is_valid_content_type (content_type), FALSE);
 
-  gboolean ref_in_list = g_strv_contains ((const gchar * const *) filter->app_list,
-                                          content_type);
+  gboolean ref_in_list = (g_hash_table_contains (filter->app_list_content_types,
+                                                 content_type) ||
+                           prefix_set_matches (filter->app_list_content_type_prefixes,
+                                               content_type));
 
   switch (filter->app_list_type)
     {
@@ -462,14 +1084,286 @@ mct_app_filter_is_content_type_allowed (MctAppFilter *filter,
     }
 }
 
-static gint
-strcmp_cb (gconstpointer a,
-           gconstpointer b)
+/* Build the set of content types which are in @filter’s app list, or which
+ * are registered and are a subclass of one which is (according to
+ * g_content_type_is_a()). Prefix patterns are not included. */
+static GHashTable *
+mct_app_filter_build_content_type_closure (MctAppFilter *filter)
 {
-  const gchar *str_a = *((const gchar * const *) a);
-  const gchar *str_b = *((const gchar * const *) b);
+  g_autoptr(GHashTable) closure = NULL;
+  GList *registered;
+  GHashTableIter iter;
+  gpointer key;
 
-  return g_strcmp0 (str_a, str_b);
+  closure = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  g_hash_table_iter_init (&iter, filter->app_list_content_types);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    g_hash_table_add (closure, g_strdup (key));
+
+  if (g_hash_table_size (closure) == 0)
+    return g_steal_pointer (&closure);
+
+  /* This is O(N×M) in the number of registered content types and the number
+   * of content types in the app list, which is why it’s only done once. */
+  registered = g_content_types_get_registered ();
+
+  for (GList *l = registered; l != NULL; l = l->next)
+    {
+      const gchar *content_type = l->data;
+
+      if (g_hash_table_contains (closure, content_type))
+        continue;
+
+      g_hash_table_iter_init (&iter, filter->app_list_content_types);
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        {
+          if (g_content_type_is_a (content_type, key))
+            {
+              g_hash_table_add (closure, g_steal_pointer (&l->data));
+              break;
+            }
+        }
+    }
+
+  g_list_free_full (registered, g_free);
+
+  return g_steal_pointer (&closure);
+}
+
+/**
+ * mct_app_filter_is_content_type_hierarchy_allowed:
+ * @filter: an #MctAppFilter
+ * @content_type: content type to check
+ *
+ * Check whether apps handling the given @content_type are allowed to be run
+ * according to this app filter, taking the content type hierarchy into
+ * account.
+ *
+ * This is like mct_app_filter_is_content_type_allowed(), except that
+ * @content_type also matches if it is a subclass (according to
+ * g_content_type_is_a()) of a content type in the app filter. For example, if
+ * `application/xml` is added to the blocklist, `application/xspf+xml` is
+ * blocklisted too.
+ *
+ * The subclasses of the content types in the filter are worked out from the
+ * registered content types (see g_content_types_get_registered()) the first
+ * time this is called on @filter, so subsequent calls are a single lookup.
+ * Content types which are not registered, and prefix patterns, are only
+ * matched exactly, as with mct_app_filter_is_content_type_allowed().
+ *
+ * Returns: %TRUE if the user this @filter corresponds to is allowed to run
+ *    programs handling @content_type according to the @filter policy;
+ *    %FALSE otherwise
+ * Since: 0.11.0
+ */
+gboolean
+mct_app_filter_is_content_type_hierarchy_allowed (MctAppFilter *filter,
+                                                  const gchar  *content_type)
+{
+  GHashTable *closure;
+
+  g_return_val_if_fail (filter != NULL, FALSE);
+  g_return_val_if_fail (filter->ref_count >= 1, FALSE);
+  g_return_val_if_fail (content_type != NULL, FALSE);
+  g_return_val_if_fail (is_valid_content_type (content_type), FALSE);
+
+  closure = g_atomic_pointer_get (&filter->content_type_closure);
+
+  if (closure == NULL)
+    {
+      GHashTable *new_closure = mct_app_filter_build_content_type_closure (filter);
+
+      /* Another thread may have got here first. */
+      if (g_atomic_pointer_compare_and_exchange (&filter->content_type_closure, NULL, new_closure))
+        {
+          closure = new_closure;
+        }
+      else
+        {
+          g_hash_table_unref (new_closure);
+          closure = g_atomic_pointer_get (&filter->content_type_closure);
+        }
+    }
+
+  gboolean ref_in_list = (g_hash_table_contains (closure, content_type) ||
+                          prefix_set_matches (filter->app_list_content_type_prefixes,
+                                              content_type));
+
+  switch (filter->app_list_type)
+    {
+    case MCT_APP_FILTER_LIST_BLOCKLIST:
+      return !ref_in_list;
+    case MCT_APP_FILTER_LIST_ALLOWLIST:
+      return ref_in_list;
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+/* Set @filter->app_list from @app_list_variant, which must be of type `as`.
+ * Ownership of @app_list_variant is transferred. If interning is enabled, the
+ * entries are interned and @app_list_variant is freed; otherwise the entries
+ * are borrowed from it. */
+static void
+mct_app_filter_take_app_list (MctAppFilter *filter,
+                              GVariant     *app_list_variant)
+{
+  gsize n_entries;
+
+  if (g_atomic_int_get (&intern_strings))
+    {
+      g_autofree const gchar **entries = g_variant_get_strv (app_list_variant, &n_entries);
+
+      filter->app_list = g_new (const gchar *, n_entries + 1);
+      for (gsize i = 0; i < n_entries; i++)
+        filter->app_list[i] = g_intern_string (entries[i]);
+      filter->app_list[n_entries] = NULL;
+
+      filter->app_list_variant = NULL;
+      g_variant_unref (app_list_variant);
+    }
+  else
+    {
+      filter->app_list_variant = app_list_variant;
+      filter->app_list = g_variant_get_strv (filter->app_list_variant, NULL);
+    }
+}
+
+/* Get @filter->app_list as a variant of type `as`. This is the variant the
+ * app list was loaded from if there is one, or a new floating variant if the
+ * entries are interned. Either is suitable for passing to `@as` in
+ * g_variant_new(). */
+static GVariant *
+mct_app_filter_get_app_list_variant (MctAppFilter *filter)
+{
+  if (filter->app_list_variant != NULL)
+    return filter->app_list_variant;
+
+  return g_variant_new_strv (filter->app_list, -1);
+}
+
+/* Add the first @app_id_len bytes of @app_id to the app ID index of
+ * @filter. */
+static void
+mct_app_filter_index_app_id (MctAppFilter *filter,
+                             const gchar  *app_id,
+                             gsize         app_id_len)
+{
+  gchar *app_id_owned = g_strndup (app_id, app_id_len);
+
+  if (filter->app_list_variant == NULL)
+    {
+      /* The app list is interned, so intern its app IDs too. */
+      g_hash_table_add (filter->app_list_flatpak_app_ids,
+                        (gpointer) g_intern_string (app_id_owned));
+      g_free (app_id_owned);
+    }
+  else
+    {
+      g_hash_table_add (filter->app_list_flatpak_app_ids, app_id_owned);
+    }
+}
+
+/* Add the prefix pattern @entry, whose prefix is @prefix_len bytes long, to
+ * the prefix indexes of @filter. A flatpak ref prefix which includes a whole
+ * app ID (such as `app/org.gnome.Builder/x86_64/*`) matches that app ID
+ * exactly; otherwise (such as `app/org.gnome.*`) the prefix of the app ID is
+ * itself a prefix pattern. */
+static void
+mct_app_filter_index_prefix_pattern (MctAppFilter *filter,
+                                     const gchar  *entry,
+                                     gsize         prefix_len)
+{
+  const MctAppFilterPrefix prefix = { entry, prefix_len };
+
+  if (is_valid_flatpak_ref_prefix (entry, prefix_len))
+    {
+      g_array_append_val (filter->app_list_flatpak_ref_prefixes, prefix);
+
+      if (g_str_has_prefix (entry, "app/"))
+        {
+          const gchar *app_id = entry + strlen ("app/");
+          gsize app_id_len = prefix_len - strlen ("app/");
+          const gchar *app_id_end = memchr (app_id, '/', app_id_len);
+
+          if (app_id_end != NULL)
+            {
+              mct_app_filter_index_app_id (filter, app_id, app_id_end - app_id);
+            }
+          else
+            {
+              const MctAppFilterPrefix app_id_prefix = { app_id, app_id_len };
+              g_array_append_val (filter->app_list_flatpak_app_id_prefixes, app_id_prefix);
+            }
+        }
+    }
+  else if (is_valid_content_type_prefix (entry, prefix_len))
+    {
+      g_array_append_val (filter->app_list_content_type_prefixes, prefix);
+    }
+}
+
+/* Build the lookup indexes over @filter->app_list, so that the
+ * mct_app_filter_is_*_allowed() checks don’t have to scan the whole list. The
+ * kinds of entry are disjoint: paths are absolute, and neither flatpak refs nor
+ * content types can start with a slash. Entries which are not of any known
+ * kind can never match a query, so are not indexed.
+ *
+ * The app IDs of all `app/` flatpak refs are also extracted, so that
+ * mct_app_filter_is_flatpak_app_allowed() is a single lookup too.
+ *
+ * Entries ending in `*` (other than paths) are prefix patterns, and are
+ * indexed separately; see mct_app_filter_index_prefix_pattern(). */
+static void
+mct_app_filter_build_app_list_index (MctAppFilter *filter)
+{
+  filter->app_list_paths = g_hash_table_new (g_str_hash, g_str_equal);
+  filter->app_list_flatpak_refs = g_hash_table_new (g_str_hash, g_str_equal);
+  filter->app_list_content_types = g_hash_table_new (g_str_hash, g_str_equal);
+  filter->app_list_flatpak_app_ids = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                            (filter->app_list_variant != NULL) ? g_free : NULL,
+                                                            NULL);
+  filter->app_list_flatpak_ref_prefixes = g_array_new (FALSE, FALSE, sizeof (MctAppFilterPrefix));
+  filter->app_list_flatpak_app_id_prefixes = g_array_new (FALSE, FALSE, sizeof (MctAppFilterPrefix));
+  filter->app_list_content_type_prefixes = g_array_new (FALSE, FALSE, sizeof (MctAppFilterPrefix));
+
+  for (gsize i = 0; filter->app_list[i] != NULL; i++)
+    {
+      const gchar *entry = filter->app_list[i];
+      gsize prefix_len;
+
+      if (*entry == '/')
+        {
+          g_hash_table_add (filter->app_list_paths, (gpointer) entry);
+          continue;
+        }
+
+      prefix_len = prefix_pattern_len (entry);
+
+      if (prefix_len > 0)
+        mct_app_filter_index_prefix_pattern (filter, entry, prefix_len);
+      else if (is_valid_flatpak_ref (entry))
+        {
+          g_hash_table_add (filter->app_list_flatpak_refs, (gpointer) entry);
+
+          /* This gives `org.gnome.Builder` from
+           * `app/org.gnome.Builder/x86_64/master`. */
+          if (g_str_has_prefix (entry, "app/"))
+            {
+              const gchar *app_id = entry + strlen ("app/");
+              const gchar *app_id_end = strchr (app_id, '/');
+
+              mct_app_filter_index_app_id (filter, app_id, app_id_end - app_id);
+            }
+        }
+      else if (is_valid_content_type (entry))
+        g_hash_table_add (filter->app_list_content_types, (gpointer) entry);
+    }
+
+  prefix_set_compile (filter->app_list_flatpak_ref_prefixes);
+  prefix_set_compile (filter->app_list_flatpak_app_id_prefixes);
+  prefix_set_compile (filter->app_list_content_type_prefixes);
 }
 
 /**
@@ -487,24 +1381,38 @@ strcmp_cb (gconstpointer a,
 const gchar **
 mct_app_filter_get_oars_sections (MctAppFilter *filter)
 {
-  g_autoptr(GPtrArray) sections = g_ptr_array_new_with_free_func (NULL);
-  GVariantIter iter;
-  const gchar *oars_section;
+  const gchar **sections;
 
   g_return_val_if_fail (filter != NULL, NULL);
   g_return_val_if_fail (filter->ref_count >= 1, NULL);
 
-  g_variant_iter_init (&iter, filter->oars_ratings);
+  sections = g_new (const gchar *, filter->n_oars_sections + 1);
+  memcpy (sections, filter->oars_sections,
+          sizeof (*sections) * (filter->n_oars_sections + 1));
 
-  while (g_variant_iter_loop (&iter, "{&s&s}", &oars_section, NULL))
-    g_ptr_array_add (sections, (gpointer) oars_section);
+  return sections;
+}
 
-  /* Sort alphabetically for easier comparisons later. */
-  g_ptr_array_sort (sections, strcmp_cb);
+/* Look up the value of @oars_section in the decoded OARS tables in @filter. */
+static MctAppFilterOarsValue
+lookup_oars_value (MctAppFilter *filter,
+                   const gchar  *oars_section)
+{
+  gint idx;
+  gpointer value_ptr;
 
-  g_ptr_array_add (sections, NULL);  /* NULL terminator */
+  idx = oars_known_section_index (oars_section);
+
+  if (idx >= 0)
+    return (filter->oars_known_present & (1u << idx)) ?
+           filter->oars_known_values[idx] : MCT_APP_FILTER_OARS_VALUE_UNKNOWN;
+
+  if (filter->oars_unknown_values != NULL &&
+      g_hash_table_lookup_extended (filter->oars_unknown_values, oars_section,
+                                    NULL, &value_ptr))
+    return GPOINTER_TO_INT (value_ptr);
 
-  return (const gchar **) g_ptr_array_free (g_steal_pointer (&sections), FALSE);
+  return MCT_APP_FILTER_OARS_VALUE_UNKNOWN;
 }
 
 /**
@@ -529,18 +1437,81 @@ MctAppFilterOarsValue
 mct_app_filter_get_oars_value (MctAppFilter *filter,
                                const gchar  *oars_section)
 {
-  const gchar *value_str;
-
   g_return_val_if_fail (filter != NULL, MCT_APP_FILTER_OARS_VALUE_UNKNOWN);
   g_return_val_if_fail (filter->ref_count >= 1,
                         MCT_APP_FILTER_OARS_VALUE_UNKNOWN);
   g_return_val_if_fail (oars_section != NULL && *oars_section != '\0',
                         MCT_APP_FILTER_OARS_VALUE_UNKNOWN);
 
-  if (!g_variant_lookup (filter->oars_ratings, oars_section, "&s", &value_str))
-    return MCT_APP_FILTER_OARS_VALUE_UNKNOWN;
+  return lookup_oars_value (filter, oars_section);
+}
+
+/**
+ * mct_app_filter_is_content_rating_allowed:
+ * @filter: an #MctAppFilter
+ * @content_rating: (type a{ss}): OARS content rating of an app, mapping OARS
+ *    section names to values (`none`, `mild`, `moderate` or `intense`)
+ * @offending_section_out: (out) (optional) (nullable) (transfer none): return
+ *    location for the name of the first section of @content_rating which is
+ *    more intense than @filter allows, or %NULL if the app is allowed
+ *
+ * Check whether an app with the given @content_rating is allowed according to
+ * the OARS filter in @filter. This is equivalent to calling
+ * mct_app_filter_get_oars_value() for each section in @content_rating and
+ * comparing the values, but is done in a single pass over @content_rating.
+ *
+ * Sections which @filter has no value for (%MCT_APP_FILTER_OARS_VALUE_UNKNOWN)
+ * are not restricted. Sections in @content_rating which have an unrecognised
+ * value are ignored.
+ *
+ * If a section is returned in @offending_section_out, it is owned by
+ * @content_rating.
+ *
+ * This does not factor in mct_app_filter_is_user_installation_allowed() or
+ * mct_app_filter_is_system_installation_allowed().
+ *
+ * Returns: %TRUE if an app with @content_rating is allowed to be shown to the
+ *    user whose @filter this is; %FALSE otherwise
+ * Since: 0.11.0
+ */
+gboolean
+mct_app_filter_is_content_rating_allowed (MctAppFilter  *filter,
+                                          GVariant      *content_rating,
+                                          const gchar  **offending_section_out)
+{
+  GVariantIter iter;
+  const gchar *oars_section, *oars_value;
+
+  g_return_val_if_fail (filter != NULL, FALSE);
+  g_return_val_if_fail (filter->ref_count >= 1, FALSE);
+  g_return_val_if_fail (content_rating != NULL, FALSE);
+  g_return_val_if_fail (g_variant_is_of_type (content_rating, G_VARIANT_TYPE ("a{ss}")), FALSE);
+
+  g_variant_iter_init (&iter, content_rating);
+
+  while (g_variant_iter_next (&iter, "{&s&s}", &oars_section, &oars_value))
+    {
+      MctAppFilterOarsValue app_value = oars_str_to_enum (oars_value);
+      MctAppFilterOarsValue filter_value;
+
+      if (app_value == MCT_APP_FILTER_OARS_VALUE_UNKNOWN)
+        continue;
+
+      filter_value = lookup_oars_value (filter, oars_section);
+
+      if (filter_value != MCT_APP_FILTER_OARS_VALUE_UNKNOWN &&
+          app_value > filter_value)
+        {
+          if (offending_section_out != NULL)
+            *offending_section_out = oars_section;
+          return FALSE;
+        }
+    }
 
-  return oars_str_to_enum (value_str);
+  if (offending_section_out != NULL)
+    *offending_section_out = NULL;
+
+  return TRUE;
 }
 
 /**
@@ -600,19 +1571,33 @@ mct_app_filter_is_system_installation_allowed (MctAppFilter *filter)
 static GVariant *
 _mct_app_filter_build_app_filter_variant (MctAppFilter *filter)
 {
-  g_auto(GVariantBuilder) builder = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("(bas)"));
-
   g_return_val_if_fail (filter != NULL, NULL);
   g_return_val_if_fail (filter->ref_count >= 1, NULL);
 
-  g_variant_builder_add (&builder, "b",
-                         (filter->app_list_type == MCT_APP_FILTER_LIST_ALLOWLIST));
-  g_variant_builder_open (&builder, G_VARIANT_TYPE ("as"));
-
-  for (gsize i = 0; filter->app_list[i] != NULL; i++)
-    g_variant_builder_add (&builder, "s", filter->app_list[i]);
+  /* This reuses @app_list_variant, if set, rather than copying the strings
+   * out of it. */
+  return g_variant_new ("(b@as)",
+                        (filter->app_list_type == MCT_APP_FILTER_LIST_ALLOWLIST),
+                        mct_app_filter_get_app_list_variant (filter));
+}
 
-  g_variant_builder_close (&builder);
+/* Build the serialised form of @filter. See mct_app_filter_serialize(). */
+static GVariant *
+mct_app_filter_build_serialized (MctAppFilter *filter)
+{
+  g_auto(GVariantBuilder) builder = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("a{sv}"));
+
+  /* The serialisation format is exactly the
+   * `com.endlessm.ParentalControls.AppFilter` D-Bus interface. */
+  g_variant_builder_add (&builder, "{sv}", "AppFilter",
+                         _mct_app_filter_build_app_filter_variant (filter));
+  g_variant_builder_add (&builder, "{sv}", "OarsFilter",
+                         g_variant_new ("(s@a{ss})", "oars-1.1",
+                                        filter->oars_ratings));
+  g_variant_builder_add (&builder, "{sv}", "AllowUserInstallation",
+                         g_variant_new_boolean (filter->allow_user_installation));
+  g_variant_builder_add (&builder, "{sv}", "AllowSystemInstallation",
+                         g_variant_new_boolean (filter->allow_system_installation));
 
   return g_variant_builder_end (&builder);
 }
@@ -627,6 +1612,9 @@ _mct_app_filter_build_app_filter_variant (MctAppFilter *filter)
  * variant produced by the current or any previous version of
  * mct_app_filter_serialize().
  *
+ * Since 0.11.0, the serialised data is built the first time this is called,
+ * and is shared by all the variants returned by subsequent calls.
+ *
  * Returns: (transfer floating): a new, floating #GVariant containing the app
  *    filter
  * Since: 0.7.0
@@ -634,24 +1622,31 @@ _mct_app_filter_build_app_filter_variant (MctAppFilter *filter)
 GVariant *
 mct_app_filter_serialize (MctAppFilter *filter)
 {
-  g_auto(GVariantBuilder) builder = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("a{sv}"));
+  GBytes *serialized;
 
   g_return_val_if_fail (filter != NULL, NULL);
   g_return_val_if_fail (filter->ref_count >= 1, NULL);
 
-  /* The serialisation format is exactly the
-   * `com.endlessm.ParentalControls.AppFilter` D-Bus interface. */
-  g_variant_builder_add (&builder, "{sv}", "AppFilter",
-                         _mct_app_filter_build_app_filter_variant (filter));
-  g_variant_builder_add (&builder, "{sv}", "OarsFilter",
-                         g_variant_new ("(s@a{ss})", "oars-1.1",
-                                        filter->oars_ratings));
-  g_variant_builder_add (&builder, "{sv}", "AllowUserInstallation",
-                         g_variant_new_boolean (filter->allow_user_installation));
-  g_variant_builder_add (&builder, "{sv}", "AllowSystemInstallation",
-                         g_variant_new_boolean (filter->allow_system_installation));
+  serialized = g_atomic_pointer_get (&filter->serialized);
 
-  return g_variant_builder_end (&builder);
+  if (serialized == NULL)
+    {
+      g_autoptr(GVariant) variant = g_variant_ref_sink (mct_app_filter_build_serialized (filter));
+      GBytes *new_serialized = g_variant_get_data_as_bytes (variant);
+
+      /* Another thread may have got here first. */
+      if (g_atomic_pointer_compare_and_exchange (&filter->serialized, NULL, new_serialized))
+        {
+          serialized = new_serialized;
+        }
+      else
+        {
+          g_bytes_unref (new_serialized);
+          serialized = g_atomic_pointer_get (&filter->serialized);
+        }
+    }
+
+  return g_variant_new_from_bytes (G_VARIANT_TYPE_VARDICT, serialized, TRUE);
 }
 
 /**
@@ -667,6 +1662,21 @@ mct_app_filter_serialize (MctAppFilter *filter)
  *
  * If deserialization fails, %MCT_MANAGER_ERROR_INVALID_DATA will be returned.
  *
+ * Since 0.11.0, the app filter borrows the strings in its app list from
+ * @variant rather than copying them, and keeps a reference to the part of
+ * @variant which contains them. For large filters, this avoids keeping two
+ * copies of the list in memory.
+ *
+ * Since 0.11.0, an entry in the app list which ends in a single `*`, and
+ * whose remainder is a valid flatpak ref prefix or content type prefix, is a
+ * prefix pattern, as added by
+ * mct_app_filter_builder_blocklist_flatpak_ref_prefix() and
+ * mct_app_filter_builder_blocklist_content_type_prefix(). Older versions of
+ * libmalcontent matched such entries literally, so an entry like
+ * `app/org.example.Foo/*` saved by an older version previously matched no
+ * apps, but now matches all refs for `org.example.Foo`. All other entries
+ * containing `*` are still matched literally.
+ *
  * Returns: (transfer full): deserialized app filter
  * Since: 0.7.0
  */
@@ -676,7 +1686,7 @@ mct_app_filter_deserialize (GVariant  *variant,
                             GError   **error)
 {
   gboolean is_allowlist;
-  g_auto(GStrv) app_list = NULL;
+  g_autoptr(GVariant) app_list_variant = NULL;
   const gchar *content_rating_kind;
   g_autoptr(GVariant) oars_variant = NULL;
   gboolean allow_user_installation;
@@ -699,12 +1709,12 @@ mct_app_filter_deserialize (GVariant  *variant,
   /* Extract the properties we care about. The default values here should be
    * kept in sync with those in the `com.endlessm.ParentalControls.AppFilter`
    * D-Bus interface. */
-  if (!g_variant_lookup (variant, "AppFilter", "(b^as)",
-                         &is_allowlist, &app_list))
+  if (!g_variant_lookup (variant, "AppFilter", "(b@as)",
+                         &is_allowlist, &app_list_variant))
     {
       /* Default value. */
       is_allowlist = FALSE;
-      app_list = g_new0 (gchar *, 1);
+      app_list_variant = g_variant_ref_sink (g_variant_new_strv (NULL, 0));
     }
 
   if (!g_variant_lookup (variant, "OarsFilter", "(&s@a{ss})",
@@ -745,22 +1755,126 @@ mct_app_filter_deserialize (GVariant  *variant,
   app_filter = g_new0 (MctAppFilter, 1);
   app_filter->ref_count = 1;
   app_filter->user_id = user_id;
-  app_filter->app_list = g_steal_pointer (&app_list);
+  mct_app_filter_take_app_list (app_filter, g_steal_pointer (&app_list_variant));
   app_filter->app_list_type =
     is_allowlist ? MCT_APP_FILTER_LIST_ALLOWLIST : MCT_APP_FILTER_LIST_BLOCKLIST;
   app_filter->oars_ratings = g_steal_pointer (&oars_variant);
   app_filter->allow_user_installation = allow_user_installation;
   app_filter->allow_system_installation = allow_system_installation;
 
+  mct_app_filter_build_app_list_index (app_filter);
+  mct_app_filter_decode_oars_ratings (app_filter);
+  mct_app_filter_calculate_derived_properties (app_filter);
+
   return g_steal_pointer (&app_filter);
 }
 
+/* Return a sorted copy of the %NULL-terminated array @strv, without the
+ * terminator or any duplicates. The strings are borrowed from @strv. */
+static GPtrArray *
+sorted_strv_copy (const gchar * const *strv)
+{
+  GPtrArray *sorted = g_ptr_array_new ();
+  gsize i, j;
+
+  for (i = 0; strv[i] != NULL; i++)
+    g_ptr_array_add (sorted, (gpointer) strv[i]);
+  g_ptr_array_sort (sorted, strcmp_cb);
+
+  for (i = 0, j = 0; i < sorted->len; i++)
+    {
+      if (j == 0 || !g_str_equal (sorted->pdata[i], sorted->pdata[j - 1]))
+        sorted->pdata[j++] = sorted->pdata[i];
+    }
+  g_ptr_array_set_size (sorted, j);
+
+  return sorted;
+}
+
+/* Build a variant which describes the policy in @filter, for calculating its
+ * digest. Unlike the serialised form, this doesn’t depend on the order of the
+ * app list or OARS sections, on duplicate app list entries, or on the
+ * spelling of unrecognised OARS values. The leading version number must be
+ * incremented if the format changes. */
+static GVariant *
+mct_app_filter_build_digest_variant (MctAppFilter *filter)
+{
+  g_autoptr(GPtrArray) app_list = sorted_strv_copy (filter->app_list);
+  g_auto(GVariantBuilder) oars_builder = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("a(su)"));
+
+  /* @oars_sections is sorted. */
+  for (gsize i = 0; i < filter->n_oars_sections; i++)
+    g_variant_builder_add (&oars_builder, "(su)", filter->oars_sections[i],
+                           (guint32) lookup_oars_value (filter, filter->oars_sections[i]));
+
+  return g_variant_new ("(ub@as@a(su)bb)",
+                        (guint32) 2,
+                        (filter->app_list_type == MCT_APP_FILTER_LIST_ALLOWLIST),
+                        g_variant_new_strv ((const gchar * const *) app_list->pdata,
+                                            app_list->len),
+                        g_variant_builder_end (&oars_builder),
+                        filter->allow_user_installation,
+                        filter->allow_system_installation);
+}
+
+/**
+ * mct_app_filter_get_digest:
+ * @filter: an #MctAppFilter
+ *
+ * Get a digest of the policy in @filter. Filters which apply the same policy
+ * have the same digest, regardless of which user they are for, or whether they
+ * were built or deserialised. This makes the digest suitable as a cache key,
+ * or for cheaply checking whether a filter has changed.
+ *
+ * The digest is a SHA-256 checksum in lowercase hexadecimal. It is calculated
+ * the first time it is needed, and then cached.
+ *
+ * Returns: (transfer none): digest of the policy in @filter
+ * Since: 0.11.0
+ */
+const gchar *
+mct_app_filter_get_digest (MctAppFilter *filter)
+{
+  gchar *digest;
+
+  g_return_val_if_fail (filter != NULL, NULL);
+  g_return_val_if_fail (filter->ref_count >= 1, NULL);
+
+  digest = g_atomic_pointer_get (&filter->digest);
+
+  if (digest == NULL)
+    {
+      g_autoptr(GVariant) variant = g_variant_ref_sink (mct_app_filter_build_digest_variant (filter));
+      gchar *new_digest = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+                                                       g_variant_get_data (variant),
+                                                       g_variant_get_size (variant));
+
+      /* Another thread may have got here first. */
+      if (g_atomic_pointer_compare_and_exchange (&filter->digest, NULL, new_digest))
+        {
+          digest = new_digest;
+        }
+      else
+        {
+          g_free (new_digest);
+          digest = g_atomic_pointer_get (&filter->digest);
+        }
+    }
+
+  return digest;
+}
+
 /**
  * mct_app_filter_equal:
  * @a: (not nullable): an #MctAppFilter
  * @b: (not nullable): an #MctAppFilter
  *
- * Check whether app filters @a and @b are equal.
+ * Check whether app filters @a and @b are equal: they are for the same user,
+ * and have identical contents, including the order of their app lists and any
+ * duplicate entries in them.
+ *
+ * To check whether two filters apply the same policy, regardless of how they
+ * were constructed, use mct_app_filter_policy_equal() instead.
  *
  * Returns: %TRUE if @a and @b are equal, %FALSE otherwise
  * Since: 0.10.0
@@ -769,11 +1883,25 @@ gboolean
 mct_app_filter_equal (MctAppFilter *a,
                       MctAppFilter *b)
 {
+  const gchar *a_digest, *b_digest;
+
   g_return_val_if_fail (a != NULL, FALSE);
   g_return_val_if_fail (a->ref_count >= 1, FALSE);
   g_return_val_if_fail (b != NULL, FALSE);
   g_return_val_if_fail (b->ref_count >= 1, FALSE);
 
+  if (a == b)
+    return TRUE;
+
+  /* Identical filters always have the same digest, so if both digests have
+   * already been calculated, they can rule out equality cheaply. Don’t
+   * calculate them here though, as that’s more work than the comparison. */
+  a_digest = g_atomic_pointer_get (&a->digest);
+  b_digest = g_atomic_pointer_get (&b->digest);
+
+  if (a_digest != NULL && b_digest != NULL && !g_str_equal (a_digest, b_digest))
+    return FALSE;
+
   return (a->user_id == b->user_id &&
           a->app_list_type == b->app_list_type &&
           a->allow_user_installation == b->allow_user_installation &&
@@ -782,6 +1910,244 @@ mct_app_filter_equal (MctAppFilter *a,
           g_variant_equal (a->oars_ratings, b->oars_ratings));
 }
 
+/**
+ * mct_app_filter_policy_equal:
+ * @a: (not nullable): an #MctAppFilter
+ * @b: (not nullable): an #MctAppFilter
+ *
+ * Check whether app filters @a and @b apply the same policy. Unlike
+ * mct_app_filter_equal(), this ignores which user the filters are for, the
+ * order of their app lists and any duplicate entries in them, and the order
+ * of their OARS sections.
+ *
+ * This compares the filters’ digests (see mct_app_filter_get_digest()), so is
+ * cheap once the digests have been calculated.
+ *
+ * Returns: %TRUE if @a and @b apply the same policy, %FALSE otherwise
+ * Since: 0.11.0
+ */
+gboolean
+mct_app_filter_policy_equal (MctAppFilter *a,
+                             MctAppFilter *b)
+{
+  g_return_val_if_fail (a != NULL, FALSE);
+  g_return_val_if_fail (a->ref_count >= 1, FALSE);
+  g_return_val_if_fail (b != NULL, FALSE);
+  g_return_val_if_fail (b->ref_count >= 1, FALSE);
+
+  if (a == b)
+    return TRUE;
+
+  return g_str_equal (mct_app_filter_get_digest (a), mct_app_filter_get_digest (b));
+}
+
+/* Add a copy of @str to @array, if the caller asked for it. */
+static void
+add_diff_entry (GPtrArray   *array,
+                const gchar *str)
+{
+  if (array != NULL)
+    g_ptr_array_add (array, g_strdup (str));
+}
+
+static gchar **
+diff_entries_end (GPtrArray *array)
+{
+  if (array == NULL)
+    return NULL;
+
+  g_ptr_array_add (array, NULL);
+  return (gchar **) g_ptr_array_free (array, FALSE);
+}
+
+/**
+ * mct_app_filter_diff:
+ * @old_filter: an #MctAppFilter
+ * @new_filter: an #MctAppFilter
+ * @added_entries_out: (out) (optional) (transfer full) (array zero-terminated=1):
+ *    return location for the app list entries which are in @new_filter but
+ *    not @old_filter
+ * @removed_entries_out: (out) (optional) (transfer full) (array zero-terminated=1):
+ *    return location for the app list entries which are in @old_filter but
+ *    not @new_filter
+ * @changed_oars_sections_out: (out) (optional) (transfer full) (array zero-terminated=1):
+ *    return location for the OARS sections whose values differ between the
+ *    filters, including sections which are only present in one of them
+ *
+ * Work out what has changed in the policy between @old_filter and
+ * @new_filter. The user the filters are for is not compared.
+ *
+ * The returned flags say which parts of the policy have changed, and map
+ * directly to the properties of the `com.endlessm.ParentalControls.AppFilter`
+ * D-Bus interface, so callers can update only the properties which changed.
+ * The details of the changes to the app list and OARS values are returned in
+ * the out arguments, each in lexicographic order and without duplicates.
+ *
+ * %MCT_APP_FILTER_DIFF_FLAGS_NONE is returned exactly when both filters have
+ * the same digest (see mct_app_filter_get_digest()).
+ *
+ * Returns: flags indicating which parts of the policy differ
+ * Since: 0.11.0
+ */
+MctAppFilterDiffFlags
+mct_app_filter_diff (MctAppFilter   *old_filter,
+                     MctAppFilter   *new_filter,
+                     gchar        ***added_entries_out,
+                     gchar        ***removed_entries_out,
+                     gchar        ***changed_oars_sections_out)
+{
+  MctAppFilterDiffFlags flags = MCT_APP_FILTER_DIFF_FLAGS_NONE;
+  g_autoptr(GPtrArray) old_entries = NULL;
+  g_autoptr(GPtrArray) new_entries = NULL;
+  gsize i, j;
+  g_autoptr(GPtrArray) added = NULL;
+  g_autoptr(GPtrArray) removed = NULL;
+  g_autoptr(GPtrArray) changed_oars = NULL;
+
+  g_return_val_if_fail (old_filter != NULL, MCT_APP_FILTER_DIFF_FLAGS_NONE);
+  g_return_val_if_fail (old_filter->ref_count >= 1, MCT_APP_FILTER_DIFF_FLAGS_NONE);
+  g_return_val_if_fail (new_filter != NULL, MCT_APP_FILTER_DIFF_FLAGS_NONE);
+  g_return_val_if_fail (new_filter->ref_count >= 1, MCT_APP_FILTER_DIFF_FLAGS_NONE);
+
+  if (added_entries_out != NULL)
+    added = g_ptr_array_new_with_free_func (g_free);
+  if (removed_entries_out != NULL)
+    removed = g_ptr_array_new_with_free_func (g_free);
+  if (changed_oars_sections_out != NULL)
+    changed_oars = g_ptr_array_new_with_free_func (g_free);
+
+  if (old_filter->app_list_type != new_filter->app_list_type)
+    flags |= MCT_APP_FILTER_DIFF_FLAGS_APP_LIST_TYPE;
+  if (old_filter->allow_user_installation != new_filter->allow_user_installation)
+    flags |= MCT_APP_FILTER_DIFF_FLAGS_USER_INSTALLATION;
+  if (old_filter->allow_system_installation != new_filter->allow_system_installation)
+    flags |= MCT_APP_FILTER_DIFF_FLAGS_SYSTEM_INSTALLATION;
+
+  /* Merge the sorted app lists. The app list is not kept sorted (its order is
+   * preserved for serialisation), so sort copies of it here. */
+  old_entries = sorted_strv_copy (old_filter->app_list);
+  new_entries = sorted_strv_copy (new_filter->app_list);
+
+  for (i = 0, j = 0; i < old_entries->len || j < new_entries->len;)
+    {
+      gint cmp;
+
+      if (i == old_entries->len)
+        cmp = 1;
+      else if (j == new_entries->len)
+        cmp = -1;
+      else
+        cmp = strcmp (g_ptr_array_index (old_entries, i),
+                      g_ptr_array_index (new_entries, j));
+
+      if (cmp < 0)
+        {
+          flags |= MCT_APP_FILTER_DIFF_FLAGS_APP_LIST;
+          add_diff_entry (removed, g_ptr_array_index (old_entries, i++));
+        }
+      else if (cmp > 0)
+        {
+          flags |= MCT_APP_FILTER_DIFF_FLAGS_APP_LIST;
+          add_diff_entry (added, g_ptr_array_index (new_entries, j++));
+        }
+      else
+        {
+          i++;
+          j++;
+        }
+    }
+
+  /* Merge the OARS sections, which are already sorted. */
+  for (i = 0, j = 0; i < old_filter->n_oars_sections || j < new_filter->n_oars_sections;)
+    {
+      const gchar *section;
+      gint cmp;
+
+      if (i == old_filter->n_oars_sections)
+        cmp = 1;
+      else if (j == new_filter->n_oars_sections)
+        cmp = -1;
+      else
+        cmp = strcmp (old_filter->oars_sections[i], new_filter->oars_sections[j]);
+
+      if (cmp < 0)
+        {
+          section = old_filter->oars_sections[i++];
+        }
+      else if (cmp > 0)
+        {
+          section = new_filter->oars_sections[j++];
+        }
+      else
+        {
+          section = old_filter->oars_sections[i++];
+          j++;
+
+          if (lookup_oars_value (old_filter, section) ==
+              lookup_oars_value (new_filter, section))
+            continue;
+        }
+
+      flags |= MCT_APP_FILTER_DIFF_FLAGS_OARS;
+      add_diff_entry (changed_oars, section);
+    }
+
+  if (added_entries_out != NULL)
+    *added_entries_out = diff_entries_end (g_steal_pointer (&added));
+  if (removed_entries_out != NULL)
+    *removed_entries_out = diff_entries_end (g_steal_pointer (&removed));
+  if (changed_oars_sections_out != NULL)
+    *changed_oars_sections_out = diff_entries_end (g_steal_pointer (&changed_oars));
+
+  return flags;
+}
+
+/* Extra state for an #MctAppFilterBuilder, which doesn’t fit in its public
+ * struct. This is allocated lazily, as MCT_APP_FILTER_BUILDER_INIT() from older
+ * headers initialises the pointer to it to %NULL. */
+typedef struct
+{
+  /* Set of the entries in the builder’s app list, so duplicates can be
+   * rejected in constant time. The keys are borrowed from the app list. */
+  GHashTable *app_list_set;  /* (nullable) (owned) (element-type utf8 utf8) */
+
+  /* Whether the builder’s app list and OARS table may be shared with other
+   * builders (by mct_app_filter_builder_copy()), in which case they must be
+   * copied before being modified. */
+  gboolean app_list_shared;
+  gboolean oars_shared;
+
+  /* Whether the strings in the builder’s app list are borrowed, rather than
+   * owned by the app list. This is the case for builders created by
+   * mct_app_filter_builder_new_from_filter() and for copies of builders, so
+   * that the app list can be copied without copying its strings. The strings
+   * are kept alive by @source_filter, @borrowed_lists and @entries: the app
+   * list itself doesn’t have a free function. */
+  gboolean app_list_borrowed;
+
+  /* Strings added to the app list while @app_list_borrowed is set. Only this
+   * builder adds to it, but copies of the builder keep references to it. */
+  GPtrArray *entries;  /* (nullable) (owned) (element-type utf8) */
+
+  /* App lists, and the @entries of other builders, which strings in the app
+   * list are borrowed from. */
+  GPtrArray *borrowed_lists;  /* (nullable) (owned) (element-type GPtrArray) */
+
+  /* The filter which strings in the app list are borrowed from, if the builder
+   * was created by mct_app_filter_builder_new_from_filter(). */
+  MctAppFilter *source_filter;  /* (nullable) (owned) */
+} MctAppFilterBuilderExtra;
+
+static void
+mct_app_filter_builder_extra_free (MctAppFilterBuilderExtra *extra)
+{
+  g_clear_pointer (&extra->app_list_set, g_hash_table_unref);
+  g_clear_pointer (&extra->entries, g_ptr_array_unref);
+  g_clear_pointer (&extra->borrowed_lists, g_ptr_array_unref);
+  g_clear_pointer (&extra->source_filter, mct_app_filter_unref);
+  g_free (extra);
+}
+
 /*
  * Actual implementation of #MctAppFilterBuilder.
  *
@@ -789,13 +2155,17 @@ mct_app_filter_equal (MctAppFilter *a,
  */
 typedef struct
 {
-  GPtrArray *blocklist;  /* (nullable) (owned) (element-type utf8) */
+  GPtrArray *app_list;  /* (nullable) (owned) (element-type utf8) */
   GHashTable *oars;  /* (nullable) (owned) (element-type utf8 MctAppFilterOarsValue) */
   gboolean allow_user_installation;
   gboolean allow_system_installation;
 
-  /*< private >*/
-  gpointer padding[2];
+  MctAppFilterBuilderExtra *extra;  /* (nullable) (owned) */
+
+  /* Whether @app_list is an allowlist rather than a blocklist. This occupies
+   * the last padding slot, which MCT_APP_FILTER_BUILDER_INIT() sets to zero,
+   * so builders default to a blocklist. */
+  gboolean is_allowlist;
 } MctAppFilterBuilderReal;
 
 G_STATIC_ASSERT (sizeof (MctAppFilterBuilderReal) ==
@@ -806,6 +2176,111 @@ G_STATIC_ASSERT (__alignof__ (MctAppFilterBuilderReal) ==
 G_DEFINE_BOXED_TYPE (MctAppFilterBuilder, mct_app_filter_builder,
                      mct_app_filter_builder_copy, mct_app_filter_builder_free)
 
+static MctAppFilterBuilderExtra *
+mct_app_filter_builder_ensure_extra (MctAppFilterBuilderReal *_builder)
+{
+  if (_builder->extra == NULL)
+    _builder->extra = g_new0 (MctAppFilterBuilderExtra, 1);
+
+  return _builder->extra;
+}
+
+/* Get the set of entries in the app list in @_builder, creating it if
+ * needed. */
+static GHashTable *
+mct_app_filter_builder_ensure_app_list_set (MctAppFilterBuilderReal *_builder)
+{
+  MctAppFilterBuilderExtra *extra = mct_app_filter_builder_ensure_extra (_builder);
+
+  if (extra->app_list_set == NULL)
+    {
+      extra->app_list_set = g_hash_table_new (g_str_hash, g_str_equal);
+
+      for (gsize i = 0; i < _builder->app_list->len; i++)
+        g_hash_table_add (extra->app_list_set,
+                          g_ptr_array_index (_builder->app_list, i));
+    }
+
+  return extra->app_list_set;
+}
+
+/* Keep @list alive until the app list in @extra no longer borrows from it. */
+static void
+mct_app_filter_builder_extra_borrow_list (MctAppFilterBuilderExtra *extra,
+                                          GPtrArray                *list)
+{
+  if (extra->borrowed_lists == NULL)
+    extra->borrowed_lists = g_ptr_array_new_with_free_func ((GDestroyNotify) g_ptr_array_unref);
+
+  g_ptr_array_add (extra->borrowed_lists, g_ptr_array_ref (list));
+}
+
+/* Ensure the app list in @_builder is not shared with any other builder, so it
+ * can be modified. Only the array of pointers is copied: the new app list
+ * borrows the strings from the old one, which is kept alive. */
+static void
+mct_app_filter_builder_unshare_app_list (MctAppFilterBuilderReal *_builder)
+{
+  MctAppFilterBuilderExtra *extra = _builder->extra;
+  GPtrArray *app_list;
+
+  if (extra == NULL || !extra->app_list_shared)
+    return;
+
+  app_list = g_ptr_array_sized_new (_builder->app_list->len);
+  for (gsize i = 0; i < _builder->app_list->len; i++)
+    g_ptr_array_add (app_list, g_ptr_array_index (_builder->app_list, i));
+
+  /* The keys in @app_list_set are the same strings, so it stays valid. */
+  mct_app_filter_builder_extra_borrow_list (extra, _builder->app_list);
+  g_ptr_array_unref (_builder->app_list);
+  _builder->app_list = app_list;
+  extra->app_list_shared = FALSE;
+  extra->app_list_borrowed = TRUE;
+}
+
+/* Once the app list in @_builder is empty, nothing in it is borrowed any more,
+ * so stop keeping the strings it was borrowing alive. */
+static void
+mct_app_filter_builder_maybe_unborrow_app_list (MctAppFilterBuilderReal *_builder)
+{
+  MctAppFilterBuilderExtra *extra = _builder->extra;
+
+  if (extra == NULL || !extra->app_list_borrowed ||
+      extra->app_list_shared || _builder->app_list->len > 0)
+    return;
+
+  g_ptr_array_unref (_builder->app_list);
+  _builder->app_list = g_ptr_array_new_with_free_func (g_free);
+  extra->app_list_borrowed = FALSE;
+
+  g_clear_pointer (&extra->entries, g_ptr_array_unref);
+  g_clear_pointer (&extra->borrowed_lists, g_ptr_array_unref);
+  g_clear_pointer (&extra->source_filter, mct_app_filter_unref);
+}
+
+/* Ensure the OARS table in @_builder is not shared with any other builder, so
+ * it can be modified. */
+static void
+mct_app_filter_builder_unshare_oars (MctAppFilterBuilderReal *_builder)
+{
+  GHashTable *oars;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  if (_builder->extra == NULL || !_builder->extra->oars_shared)
+    return;
+
+  oars = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  g_hash_table_iter_init (&iter, _builder->oars);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    g_hash_table_insert (oars, g_strdup (key), value);
+
+  g_hash_table_unref (_builder->oars);
+  _builder->oars = oars;
+  _builder->extra->oars_shared = FALSE;
+}
+
 /**
  * mct_app_filter_builder_init:
  * @builder: an uninitialised #MctAppFilterBuilder
@@ -827,7 +2302,7 @@ mct_app_filter_builder_init (MctAppFilterBuilder *builder)
   MctAppFilterBuilderReal *_builder = (MctAppFilterBuilderReal *) builder;
 
   g_return_if_fail (_builder != NULL);
-  g_return_if_fail (_builder->blocklist == NULL);
+  g_return_if_fail (_builder->app_list == NULL);
   g_return_if_fail (_builder->oars == NULL);
 
   memcpy (builder, &local_builder, sizeof (local_builder));
@@ -853,7 +2328,8 @@ mct_app_filter_builder_clear (MctAppFilterBuilder *builder)
 
   g_return_if_fail (_builder != NULL);
 
-  g_clear_pointer (&_builder->blocklist, g_ptr_array_unref);
+  g_clear_pointer (&_builder->extra, mct_app_filter_builder_extra_free);
+  g_clear_pointer (&_builder->app_list, g_ptr_array_unref);
   g_clear_pointer (&_builder->oars, g_hash_table_unref);
 }
 
@@ -879,6 +2355,55 @@ mct_app_filter_builder_new (void)
   return g_steal_pointer (&builder);
 }
 
+/**
+ * mct_app_filter_builder_new_from_filter:
+ * @filter: an #MctAppFilter
+ *
+ * Construct a new #MctAppFilterBuilder on the heap, with the same policy as
+ * @filter. Methods can then be called on it to make changes to the policy,
+ * followed by mct_app_filter_builder_end() to build a new #MctAppFilter.
+ *
+ * The builder borrows the strings in the app list from @filter, rather than
+ * copying them, so this is cheap regardless of the size of the app list, and
+ * subsequent changes only copy the array of pointers to them.
+ *
+ * Returns: (transfer full): a new heap-allocated #MctAppFilterBuilder
+ * Since: 0.11.0
+ */
+MctAppFilterBuilder *
+mct_app_filter_builder_new_from_filter (MctAppFilter *filter)
+{
+  g_autoptr(MctAppFilterBuilder) builder = NULL;
+  MctAppFilterBuilderReal *_builder;
+  MctAppFilterBuilderExtra *extra;
+
+  g_return_val_if_fail (filter != NULL, NULL);
+  g_return_val_if_fail (filter->ref_count >= 1, NULL);
+
+  builder = mct_app_filter_builder_new ();
+  _builder = (MctAppFilterBuilderReal *) builder;
+
+  /* Borrow the entries from @filter, rather than copying them. */
+  g_ptr_array_unref (_builder->app_list);
+  _builder->app_list = g_ptr_array_new ();
+  for (gsize i = 0; filter->app_list[i] != NULL; i++)
+    g_ptr_array_add (_builder->app_list, (gpointer) filter->app_list[i]);
+
+  extra = mct_app_filter_builder_ensure_extra (_builder);
+  extra->app_list_borrowed = TRUE;
+  extra->source_filter = mct_app_filter_ref (filter);
+
+  for (gsize i = 0; i < filter->n_oars_sections; i++)
+    g_hash_table_insert (_builder->oars, g_strdup (filter->oars_sections[i]),
+                         GINT_TO_POINTER (lookup_oars_value (filter, filter->oars_sections[i])));
+
+  _builder->is_allowlist = (filter->app_list_type == MCT_APP_FILTER_LIST_ALLOWLIST);
+  _builder->allow_user_installation = filter->allow_user_installation;
+  _builder->allow_system_installation = filter->allow_system_installation;
+
+  return g_steal_pointer (&builder);
+}
+
 /**
  * mct_app_filter_builder_copy:
  * @builder: an #MctAppFilterBuilder
@@ -887,6 +2412,10 @@ mct_app_filter_builder_new (void)
  * heap. This is safe to use with cleared, stack-allocated
  * #MctAppFilterBuilders.
  *
+ * Since 0.11.0, the copy shares its app list and OARS values with @builder
+ * until either of them is modified, so copying is cheap regardless of the
+ * size of the app list.
+ *
  * Returns: (transfer full): a copy of @builder
  * Since: 0.2.0
  */
@@ -903,12 +2432,36 @@ mct_app_filter_builder_copy (MctAppFilterBuilder *builder)
   _copy = (MctAppFilterBuilderReal *) copy;
 
   mct_app_filter_builder_clear (copy);
-  if (_builder->blocklist != NULL)
-    _copy->blocklist = g_ptr_array_ref (_builder->blocklist);
+
+  /* Share the app list and OARS values; both builders will copy them before
+   * modifying them. */
+  if (_builder->app_list != NULL)
+    {
+      MctAppFilterBuilderExtra *extra = mct_app_filter_builder_ensure_extra (_builder);
+      MctAppFilterBuilderExtra *copy_extra = mct_app_filter_builder_ensure_extra (_copy);
+
+      _copy->app_list = g_ptr_array_ref (_builder->app_list);
+      extra->app_list_shared = TRUE;
+      copy_extra->app_list_shared = TRUE;
+
+      /* Keep alive everything the app list borrows strings from. */
+      copy_extra->app_list_borrowed = extra->app_list_borrowed;
+      if (extra->entries != NULL)
+        mct_app_filter_builder_extra_borrow_list (copy_extra, extra->entries);
+      for (gsize i = 0; extra->borrowed_lists != NULL && i < extra->borrowed_lists->len; i++)
+        mct_app_filter_builder_extra_borrow_list (copy_extra, g_ptr_array_index (extra->borrowed_lists, i));
+      if (extra->source_filter != NULL)
+        copy_extra->source_filter = mct_app_filter_ref (extra->source_filter);
+    }
   if (_builder->oars != NULL)
-    _copy->oars = g_hash_table_ref (_builder->oars);
+    {
+      _copy->oars = g_hash_table_ref (_builder->oars);
+      mct_app_filter_builder_ensure_extra (_builder)->oars_shared = TRUE;
+      mct_app_filter_builder_ensure_extra (_copy)->oars_shared = TRUE;
+    }
   _copy->allow_user_installation = _builder->allow_user_installation;
   _copy->allow_system_installation = _builder->allow_system_installation;
+  _copy->is_allowlist = _builder->is_allowlist;
 
   return g_steal_pointer (&copy);
 }
@@ -954,12 +2507,9 @@ mct_app_filter_builder_end (MctAppFilterBuilder *builder)
   g_autoptr(GVariant) oars_variant = NULL;
 
   g_return_val_if_fail (_builder != NULL, NULL);
-  g_return_val_if_fail (_builder->blocklist != NULL, NULL);
+  g_return_val_if_fail (_builder->app_list != NULL, NULL);
   g_return_val_if_fail (_builder->oars != NULL, NULL);
 
-  /* Ensure the paths list is %NULL-terminated. */
-  g_ptr_array_add (_builder->blocklist, NULL);
-
   /* Build the OARS variant. */
   g_hash_table_iter_init (&iter, _builder->oars);
   while (g_hash_table_iter_next (&iter, &key, &value))
@@ -989,17 +2539,210 @@ mct_app_filter_builder_end (MctAppFilterBuilder *builder)
   app_filter = g_new0 (MctAppFilter, 1);
   app_filter->ref_count = 1;
   app_filter->user_id = -1;
-  app_filter->app_list = (gchar **) g_ptr_array_free (g_steal_pointer (&_builder->blocklist), FALSE);
-  app_filter->app_list_type = MCT_APP_FILTER_LIST_BLOCKLIST;
+  mct_app_filter_take_app_list (app_filter,
+                                g_variant_ref_sink (g_variant_new_strv ((const gchar * const *) _builder->app_list->pdata,
+                                                                        _builder->app_list->len)));
+  app_filter->app_list_type =
+    _builder->is_allowlist ? MCT_APP_FILTER_LIST_ALLOWLIST : MCT_APP_FILTER_LIST_BLOCKLIST;
   app_filter->oars_ratings = g_steal_pointer (&oars_variant);
   app_filter->allow_user_installation = _builder->allow_user_installation;
   app_filter->allow_system_installation = _builder->allow_system_installation;
 
+  mct_app_filter_build_app_list_index (app_filter);
+  mct_app_filter_decode_oars_ratings (app_filter);
+  mct_app_filter_calculate_derived_properties (app_filter);
+
   mct_app_filter_builder_clear (builder);
 
   return g_steal_pointer (&app_filter);
 }
 
+/* Switch the app list in @_builder to be an allowlist if @is_allowlist is
+ * %TRUE, or a blocklist otherwise. This can only be changed while the list is
+ * empty, as an entry’s meaning depends on the list type. */
+static gboolean
+mct_app_filter_builder_set_list_type (MctAppFilterBuilderReal *_builder,
+                                      gboolean                 is_allowlist)
+{
+  g_return_val_if_fail (_builder->is_allowlist == is_allowlist ||
+                        _builder->app_list->len == 0, FALSE);
+
+  _builder->is_allowlist = is_allowlist;
+
+  return TRUE;
+}
+
+/* Add a copy of @entry to the app list in @builder, unless it’s already in
+ * there. */
+static void
+mct_app_filter_builder_add_entry (MctAppFilterBuilderReal *_builder,
+                                  const gchar             *entry,
+                                  gboolean                 is_allowlist)
+{
+  gchar *entry_owned;
+
+  if (!mct_app_filter_builder_set_list_type (_builder, is_allowlist))
+    return;
+
+  /* Check for duplicates before unsharing the app list, as adding a duplicate
+   * doesn’t modify it. */
+  if (g_hash_table_contains (mct_app_filter_builder_ensure_app_list_set (_builder), entry))
+    return;
+
+  mct_app_filter_builder_unshare_app_list (_builder);
+
+  entry_owned = g_strdup (entry);
+  g_ptr_array_add (_builder->app_list, entry_owned);
+  g_hash_table_add (mct_app_filter_builder_ensure_app_list_set (_builder), entry_owned);
+
+  /* If the app list doesn’t own its strings, something else has to. */
+  if (_builder->extra != NULL && _builder->extra->app_list_borrowed)
+    {
+      if (_builder->extra->entries == NULL)
+        _builder->extra->entries = g_ptr_array_new_with_free_func (g_free);
+      g_ptr_array_add (_builder->extra->entries, entry_owned);
+    }
+}
+
+/* Remove @entry from the app list in @builder, if it’s in there. */
+static void
+mct_app_filter_builder_remove_entry (MctAppFilterBuilderReal *_builder,
+                                     const gchar             *entry)
+{
+  GHashTable *app_list_set = mct_app_filter_builder_ensure_app_list_set (_builder);
+  gpointer stored_entry;
+
+  if (!g_hash_table_lookup_extended (app_list_set, entry, &stored_entry, NULL))
+    return;
+
+  mct_app_filter_builder_unshare_app_list (_builder);
+
+  /* Remove it from the set first, as removing it from the app list may free
+   * it. The strings are unique, so they can be compared by pointer. */
+  g_hash_table_remove (app_list_set, entry);
+  g_ptr_array_remove (_builder->app_list, stored_entry);
+
+  mct_app_filter_builder_maybe_unborrow_app_list (_builder);
+}
+
+static void
+mct_app_filter_builder_add_path (MctAppFilterBuilder *builder,
+                                 const gchar         *path,
+                                 gboolean             is_allowlist)
+{
+  MctAppFilterBuilderReal *_builder = (MctAppFilterBuilderReal *) builder;
+
+  g_return_if_fail (_builder != NULL);
+  g_return_if_fail (_builder->app_list != NULL);
+  g_return_if_fail (path != NULL);
+  g_return_if_fail (g_path_is_absolute (path));
+
+  g_autofree gchar *canonical_path_owned = NULL;
+  const gchar *canonical_path = canonicalize_utf8_path (path, &canonical_path_owned);
+  g_return_if_fail (canonical_path != NULL);
+
+  mct_app_filter_builder_add_entry (_builder, canonical_path, is_allowlist);
+}
+
+static void
+mct_app_filter_builder_add_flatpak_ref (MctAppFilterBuilder *builder,
+                                        const gchar         *app_ref,
+                                        gboolean             is_allowlist)
+{
+  MctAppFilterBuilderReal *_builder = (MctAppFilterBuilderReal *) builder;
+
+  g_return_if_fail (_builder != NULL);
+  g_return_if_fail (_builder->app_list != NULL);
+  g_return_if_fail (app_ref != NULL);
+  g_return_if_fail (strchr (app_ref, '*') == NULL);
+  g_return_if_fail (is_valid_flatpak_ref (app_ref));
+
+  mct_app_filter_builder_add_entry (_builder, app_ref, is_allowlist);
+}
+
+static void
+mct_app_filter_builder_add_flatpak_refs (MctAppFilterBuilder *builder,
+                                         const gchar * const *app_refs,
+                                         gboolean             is_allowlist)
+{
+  MctAppFilterBuilderReal *_builder = (MctAppFilterBuilderReal *) builder;
+
+  g_return_if_fail (_builder != NULL);
+  g_return_if_fail (_builder->app_list != NULL);
+  g_return_if_fail (app_refs != NULL);
+
+  /* Check all the refs before adding any, so a bad ref doesn’t leave the
+   * builder half-updated. */
+  for (gsize i = 0; app_refs[i] != NULL; i++)
+    {
+      g_return_if_fail (strchr (app_refs[i], '*') == NULL);
+      g_return_if_fail (is_valid_flatpak_ref (app_refs[i]));
+    }
+
+  /* Set the list type explicitly, so that it’s set even if @app_refs is
+   * empty. */
+  if (!mct_app_filter_builder_set_list_type (_builder, is_allowlist))
+    return;
+
+  for (gsize i = 0; app_refs[i] != NULL; i++)
+    mct_app_filter_builder_add_entry (_builder, app_refs[i], is_allowlist);
+}
+
+static void
+mct_app_filter_builder_add_content_type (MctAppFilterBuilder *builder,
+                                         const gchar         *content_type,
+                                         gboolean             is_allowlist)
+{
+  MctAppFilterBuilderReal *_builder = (MctAppFilterBuilderReal *) builder;
+
+  g_return_if_fail (_builder != NULL);
+  g_return_if_fail (_builder->app_list != NULL);
+  g_return_if_fail (content_type != NULL);
+  g_return_if_fail (strchr (content_type, '*') == NULL);
+  g_return_if_fail (is_valid_content_type (content_type));
+
+  mct_app_filter_builder_add_entry (_builder, content_type, is_allowlist);
+}
+
+static void
+mct_app_filter_builder_add_flatpak_ref_prefix (MctAppFilterBuilder *builder,
+                                               const gchar         *ref_prefix,
+                                               gboolean             is_allowlist)
+{
+  MctAppFilterBuilderReal *_builder = (MctAppFilterBuilderReal *) builder;
+  g_autofree gchar *pattern = NULL;
+
+  g_return_if_fail (_builder != NULL);
+  g_return_if_fail (_builder->app_list != NULL);
+  g_return_if_fail (ref_prefix != NULL);
+  g_return_if_fail (strchr (ref_prefix, '*') == NULL);
+  g_return_if_fail (is_valid_flatpak_ref_prefix (ref_prefix, strlen (ref_prefix)));
+
+  pattern = g_strconcat (ref_prefix, "*", NULL);
+
+  mct_app_filter_builder_add_entry (_builder, pattern, is_allowlist);
+}
+
+static void
+mct_app_filter_builder_add_content_type_prefix (MctAppFilterBuilder *builder,
+                                                const gchar         *content_type_prefix,
+                                                gboolean             is_allowlist)
+{
+  MctAppFilterBuilderReal *_builder = (MctAppFilterBuilderReal *) builder;
+  g_autofree gchar *pattern = NULL;
+
+  g_return_if_fail (_builder != NULL);
+  g_return_if_fail (_builder->app_list != NULL);
+  g_return_if_fail (content_type_prefix != NULL);
+  g_return_if_fail (strchr (content_type_prefix, '*') == NULL);
+  g_return_if_fail (is_valid_content_type_prefix (content_type_prefix,
+                                                  strlen (content_type_prefix)));
+
+  pattern = g_strconcat (content_type_prefix, "*", NULL);
+
+  mct_app_filter_builder_add_entry (_builder, pattern, is_allowlist);
+}
+
 /**
  * mct_app_filter_builder_blocklist_path:
  * @builder: an initialised #MctAppFilterBuilder
@@ -1009,27 +2752,16 @@ mct_app_filter_builder_end (MctAppFilterBuilder *builder)
  * will be canonicalised (without doing any I/O) before being added.
  * The canonicalised @path will not be added again if it’s already been added.
  *
+ * This must not be called after any of the `allowlist` methods have added
+ * entries to @builder.
+ *
  * Since: 0.2.0
  */
 void
 mct_app_filter_builder_blocklist_path (MctAppFilterBuilder *builder,
                                        const gchar         *path)
 {
-  MctAppFilterBuilderReal *_builder = (MctAppFilterBuilderReal *) builder;
-
-  g_return_if_fail (_builder != NULL);
-  g_return_if_fail (_builder->blocklist != NULL);
-  g_return_if_fail (path != NULL);
-  g_return_if_fail (g_path_is_absolute (path));
-
-  g_autofree gchar *canonical_path = g_canonicalize_filename (path, "/");
-  g_autofree gchar *canonical_path_utf8 = g_filename_to_utf8 (canonical_path, -1,
-                                                              NULL, NULL, NULL);
-  g_return_if_fail (canonical_path_utf8 != NULL);
-
-  if (!g_ptr_array_find_with_equal_func (_builder->blocklist,
-                                         canonical_path_utf8, g_str_equal, NULL))
-    g_ptr_array_add (_builder->blocklist, g_steal_pointer (&canonical_path_utf8));
+  mct_app_filter_builder_add_path (builder, path, FALSE);
 }
 
 /**
@@ -1041,22 +2773,36 @@ mct_app_filter_builder_blocklist_path (MctAppFilterBuilder *builder,
  * construction. The @app_ref will not be added again if it’s already been
  * added.
  *
+ * @app_ref must not contain `*`, as a trailing `*` in the app list marks a
+ * prefix. Use mct_app_filter_builder_blocklist_flatpak_ref_prefix() to
+ * blocklist all the flatpak refs which start with a given prefix.
+ *
  * Since: 0.2.0
  */
 void
 mct_app_filter_builder_blocklist_flatpak_ref (MctAppFilterBuilder *builder,
                                               const gchar         *app_ref)
 {
-  MctAppFilterBuilderReal *_builder = (MctAppFilterBuilderReal *) builder;
-
-  g_return_if_fail (_builder != NULL);
-  g_return_if_fail (_builder->blocklist != NULL);
-  g_return_if_fail (app_ref != NULL);
-  g_return_if_fail (is_valid_flatpak_ref (app_ref));
+  mct_app_filter_builder_add_flatpak_ref (builder, app_ref, FALSE);
+}
 
-  if (!g_ptr_array_find_with_equal_func (_builder->blocklist,
-                                         app_ref, g_str_equal, NULL))
-    g_ptr_array_add (_builder->blocklist, g_strdup (app_ref));
+/**
+ * mct_app_filter_builder_blocklist_flatpak_refs:
+ * @builder: an initialised #MctAppFilterBuilder
+ * @app_refs: (array zero-terminated=1): flatpak app refs to blocklist
+ *
+ * Add all the @app_refs to the blocklist of flatpak refs in the filter under
+ * construction, as if mct_app_filter_builder_blocklist_flatpak_ref() had been
+ * called for each of them in order. If any of @app_refs is invalid, none of
+ * them are added.
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_builder_blocklist_flatpak_refs (MctAppFilterBuilder *builder,
+                                               const gchar * const *app_refs)
+{
+  mct_app_filter_builder_add_flatpak_refs (builder, app_refs, FALSE);
 }
 
 /**
@@ -1068,26 +2814,344 @@ mct_app_filter_builder_blocklist_flatpak_ref (MctAppFilterBuilder *builder,
  * construction. The @content_type will not be added again if it’s already been
  * added.
  *
+ * @content_type must not contain `*`, as a trailing `*` in the app list marks
+ * a prefix. Use mct_app_filter_builder_blocklist_content_type_prefix() to
+ * blocklist all the content types which start with a given prefix.
+ *
  * Note that this method doesn’t handle content subtypes. For example, if
  * `application/xml` is added to the blocklist but `application/xspf+xml` is not,
  * a check for whether `application/xspf+xml` is blocklisted would return false.
+ * See mct_app_filter_is_content_type_hierarchy_allowed() for a check which
+ * does take the blocklisted or allowlisted supertypes of a content type into
+ * account.
  *
  * Since: 0.4.0
  */
 void
 mct_app_filter_builder_blocklist_content_type (MctAppFilterBuilder *builder,
                                                const gchar         *content_type)
+{
+  mct_app_filter_builder_add_content_type (builder, content_type, FALSE);
+}
+
+/**
+ * mct_app_filter_builder_blocklist_flatpak_ref_prefix:
+ * @builder: an initialised #MctAppFilterBuilder
+ * @ref_prefix: the start of the flatpak refs to blocklist
+ *
+ * Add every flatpak ref which starts with @ref_prefix to the blocklist in the
+ * filter under construction. For example, `app/com.example.` blocklists all
+ * apps from `com.example`, and `app/org.gnome.Builder/x86_64/` blocklists all
+ * branches of GNOME Builder on x86_64.
+ *
+ * @ref_prefix must include the `app/` or `runtime/` kind of the refs. It is
+ * stored in the app list with a trailing `*`.
+ *
+ * If @ref_prefix ends within the app ID (as in the first example), the
+ * blocklist also applies to mct_app_filter_is_flatpak_app_allowed() for all
+ * app IDs which start with that part of @ref_prefix. Otherwise, it applies to
+ * the app ID in @ref_prefix, as with
+ * mct_app_filter_builder_blocklist_flatpak_ref().
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_builder_blocklist_flatpak_ref_prefix (MctAppFilterBuilder *builder,
+                                                     const gchar         *ref_prefix)
+{
+  mct_app_filter_builder_add_flatpak_ref_prefix (builder, ref_prefix, FALSE);
+}
+
+/**
+ * mct_app_filter_builder_blocklist_content_type_prefix:
+ * @builder: an initialised #MctAppFilterBuilder
+ * @content_type_prefix: the start of the content types to blocklist
+ *
+ * Add every content type which starts with @content_type_prefix to the
+ * blocklist in the filter under construction. For example, `x-scheme-handler/`
+ * blocklists apps which handle any URI scheme. It is stored in the app list
+ * with a trailing `*`.
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_builder_blocklist_content_type_prefix (MctAppFilterBuilder *builder,
+                                                      const gchar         *content_type_prefix)
+{
+  mct_app_filter_builder_add_content_type_prefix (builder, content_type_prefix, FALSE);
+}
+
+/**
+ * mct_app_filter_builder_allowlist_path:
+ * @builder: an initialised #MctAppFilterBuilder
+ * @path: (type filename): an absolute path to allowlist
+ *
+ * Add @path to the allowlist of app paths in the filter under construction.
+ * This is the allowlist equivalent of mct_app_filter_builder_blocklist_path().
+ *
+ * The first call to any of the `allowlist` methods turns the app list of the
+ * filter under construction into an allowlist: only the apps in it will be
+ * allowed to run. This must be done before any entries are added to the
+ * blocklist, and the blocklist methods must not be called afterwards.
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_builder_allowlist_path (MctAppFilterBuilder *builder,
+                                       const gchar         *path)
+{
+  mct_app_filter_builder_add_path (builder, path, TRUE);
+}
+
+/**
+ * mct_app_filter_builder_allowlist_flatpak_ref:
+ * @builder: an initialised #MctAppFilterBuilder
+ * @app_ref: a flatpak app ref to allowlist
+ *
+ * Add @app_ref to the allowlist of flatpak refs in the filter under
+ * construction. This is the allowlist equivalent of
+ * mct_app_filter_builder_blocklist_flatpak_ref(); see
+ * mct_app_filter_builder_allowlist_path() for details of allowlists.
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_builder_allowlist_flatpak_ref (MctAppFilterBuilder *builder,
+                                              const gchar         *app_ref)
+{
+  mct_app_filter_builder_add_flatpak_ref (builder, app_ref, TRUE);
+}
+
+/**
+ * mct_app_filter_builder_allowlist_flatpak_refs:
+ * @builder: an initialised #MctAppFilterBuilder
+ * @app_refs: (array zero-terminated=1): flatpak app refs to allowlist
+ *
+ * Add all the @app_refs to the allowlist of flatpak refs in the filter under
+ * construction, as if mct_app_filter_builder_allowlist_flatpak_ref() had been
+ * called for each of them in order. If any of @app_refs is invalid, none of
+ * them are added.
+ *
+ * This turns the app list into an allowlist even if @app_refs is empty, so it
+ * can be used to build a filter which allows no apps.
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_builder_allowlist_flatpak_refs (MctAppFilterBuilder *builder,
+                                               const gchar * const *app_refs)
+{
+  mct_app_filter_builder_add_flatpak_refs (builder, app_refs, TRUE);
+}
+
+/**
+ * mct_app_filter_builder_allowlist_content_type:
+ * @builder: an initialised #MctAppFilterBuilder
+ * @content_type: a content type to allowlist
+ *
+ * Add @content_type to the allowlist of content types in the filter under
+ * construction. This is the allowlist equivalent of
+ * mct_app_filter_builder_blocklist_content_type(); see
+ * mct_app_filter_builder_allowlist_path() for details of allowlists.
+ * Subtypes are handled in the same way; see
+ * mct_app_filter_is_content_type_hierarchy_allowed() for a check which takes
+ * them into account.
+ *
+ * As with mct_app_filter_builder_blocklist_content_type(), @content_type must
+ * not contain `*`; use mct_app_filter_builder_allowlist_content_type_prefix()
+ * to allowlist all the content types which start with a given prefix.
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_builder_allowlist_content_type (MctAppFilterBuilder *builder,
+                                               const gchar         *content_type)
+{
+  mct_app_filter_builder_add_content_type (builder, content_type, TRUE);
+}
+
+/**
+ * mct_app_filter_builder_allowlist_flatpak_ref_prefix:
+ * @builder: an initialised #MctAppFilterBuilder
+ * @ref_prefix: the start of the flatpak refs to allowlist
+ *
+ * Add every flatpak ref which starts with @ref_prefix to the allowlist in the
+ * filter under construction. This is the allowlist equivalent of
+ * mct_app_filter_builder_blocklist_flatpak_ref_prefix(); see
+ * mct_app_filter_builder_allowlist_path() for details of allowlists.
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_builder_allowlist_flatpak_ref_prefix (MctAppFilterBuilder *builder,
+                                                     const gchar         *ref_prefix)
+{
+  mct_app_filter_builder_add_flatpak_ref_prefix (builder, ref_prefix, TRUE);
+}
+
+/**
+ * mct_app_filter_builder_allowlist_content_type_prefix:
+ * @builder: an initialised #MctAppFilterBuilder
+ * @content_type_prefix: the start of the content types to allowlist
+ *
+ * Add every content type which starts with @content_type_prefix to the
+ * allowlist in the filter under construction. This is the allowlist
+ * equivalent of mct_app_filter_builder_blocklist_content_type_prefix(); see
+ * mct_app_filter_builder_allowlist_path() for details of allowlists.
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_builder_allowlist_content_type_prefix (MctAppFilterBuilder *builder,
+                                                      const gchar         *content_type_prefix)
+{
+  mct_app_filter_builder_add_content_type_prefix (builder, content_type_prefix, TRUE);
+}
+
+/**
+ * mct_app_filter_builder_remove_path:
+ * @builder: an initialised #MctAppFilterBuilder
+ * @path: an absolute path to remove
+ *
+ * Remove @path from the app list in the filter under construction, if it’s
+ * in there. This works for both blocklists and allowlists, and is typically
+ * used on a builder from mct_app_filter_builder_new_from_filter() to undo a
+ * call to mct_app_filter_builder_blocklist_path() or
+ * mct_app_filter_builder_allowlist_path().
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_builder_remove_path (MctAppFilterBuilder *builder,
+                                    const gchar         *path)
+{
+  MctAppFilterBuilderReal *_builder = (MctAppFilterBuilderReal *) builder;
+  g_autofree gchar *canonical_path_owned = NULL;
+  const gchar *canonical_path;
+
+  g_return_if_fail (_builder != NULL);
+  g_return_if_fail (_builder->app_list != NULL);
+  g_return_if_fail (path != NULL);
+  g_return_if_fail (g_path_is_absolute (path));
+
+  canonical_path = canonicalize_utf8_path (path, &canonical_path_owned);
+  g_return_if_fail (canonical_path != NULL);
+
+  mct_app_filter_builder_remove_entry (_builder, canonical_path);
+}
+
+/**
+ * mct_app_filter_builder_remove_flatpak_ref:
+ * @builder: an initialised #MctAppFilterBuilder
+ * @app_ref: a flatpak app ref to remove
+ *
+ * Remove @app_ref from the app list in the filter under construction, if
+ * it’s in there. See mct_app_filter_builder_remove_path().
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_builder_remove_flatpak_ref (MctAppFilterBuilder *builder,
+                                           const gchar         *app_ref)
+{
+  MctAppFilterBuilderReal *_builder = (MctAppFilterBuilderReal *) builder;
+
+  g_return_if_fail (_builder != NULL);
+  g_return_if_fail (_builder->app_list != NULL);
+  g_return_if_fail (app_ref != NULL);
+  g_return_if_fail (strchr (app_ref, '*') == NULL);
+  g_return_if_fail (is_valid_flatpak_ref (app_ref));
+
+  mct_app_filter_builder_remove_entry (_builder, app_ref);
+}
+
+/**
+ * mct_app_filter_builder_remove_content_type:
+ * @builder: an initialised #MctAppFilterBuilder
+ * @content_type: a content type to remove
+ *
+ * Remove @content_type from the app list in the filter under construction,
+ * if it’s in there. See mct_app_filter_builder_remove_path().
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_builder_remove_content_type (MctAppFilterBuilder *builder,
+                                            const gchar         *content_type)
 {
   MctAppFilterBuilderReal *_builder = (MctAppFilterBuilderReal *) builder;
 
   g_return_if_fail (_builder != NULL);
-  g_return_if_fail (_builder->blocklist != NULL);
+  g_return_if_fail (_builder->app_list != NULL);
   g_return_if_fail (content_type != NULL);
+  g_return_if_fail (strchr (content_type, '*') == NULL);
   g_return_if_fail (is_valid_content_type (content_type));
 
-  if (!g_ptr_array_find_with_equal_func (_builder->blocklist,
-                                         content_type, g_str_equal, NULL))
-    g_ptr_array_add (_builder->blocklist, g_strdup (content_type));
+  mct_app_filter_builder_remove_entry (_builder, content_type);
+}
+
+/**
+ * mct_app_filter_builder_remove_flatpak_ref_prefix:
+ * @builder: an initialised #MctAppFilterBuilder
+ * @ref_prefix: the start of the flatpak refs to remove
+ *
+ * Remove the pattern added by
+ * mct_app_filter_builder_blocklist_flatpak_ref_prefix() or
+ * mct_app_filter_builder_allowlist_flatpak_ref_prefix() for @ref_prefix from
+ * the app list in the filter under construction, if it’s in there. Flatpak
+ * refs which start with @ref_prefix but were added individually are not
+ * removed.
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_builder_remove_flatpak_ref_prefix (MctAppFilterBuilder *builder,
+                                                  const gchar         *ref_prefix)
+{
+  MctAppFilterBuilderReal *_builder = (MctAppFilterBuilderReal *) builder;
+  g_autofree gchar *pattern = NULL;
+
+  g_return_if_fail (_builder != NULL);
+  g_return_if_fail (_builder->app_list != NULL);
+  g_return_if_fail (ref_prefix != NULL);
+  g_return_if_fail (strchr (ref_prefix, '*') == NULL);
+  g_return_if_fail (is_valid_flatpak_ref_prefix (ref_prefix, strlen (ref_prefix)));
+
+  pattern = g_strconcat (ref_prefix, "*", NULL);
+
+  mct_app_filter_builder_remove_entry (_builder, pattern);
+}
+
+/**
+ * mct_app_filter_builder_remove_content_type_prefix:
+ * @builder: an initialised #MctAppFilterBuilder
+ * @content_type_prefix: the start of the content types to remove
+ *
+ * Remove the pattern added by
+ * mct_app_filter_builder_blocklist_content_type_prefix() or
+ * mct_app_filter_builder_allowlist_content_type_prefix() for
+ * @content_type_prefix from the app list in the filter under construction, if
+ * it’s in there. See mct_app_filter_builder_remove_flatpak_ref_prefix().
+ *
+ * Since: 0.11.0
+ */
+void
+mct_app_filter_builder_remove_content_type_prefix (MctAppFilterBuilder *builder,
+                                                   const gchar         *content_type_prefix)
+{
+  MctAppFilterBuilderReal *_builder = (MctAppFilterBuilderReal *) builder;
+  g_autofree gchar *pattern = NULL;
+
+  g_return_if_fail (_builder != NULL);
+  g_return_if_fail (_builder->app_list != NULL);
+  g_return_if_fail (content_type_prefix != NULL);
+  g_return_if_fail (strchr (content_type_prefix, '*') == NULL);
+  g_return_if_fail (is_valid_content_type_prefix (content_type_prefix,
+                                                  strlen (content_type_prefix)));
+
+  pattern = g_strconcat (content_type_prefix, "*", NULL);
+
+  mct_app_filter_builder_remove_entry (_builder, pattern);
 }
 
 /**
@@ -1114,6 +3178,7 @@ mct_app_filter_builder_set_oars_value (MctAppFilterBuilder   *builder,
   g_return_if_fail (_builder->oars != NULL);
   g_return_if_fail (oars_section != NULL && *oars_section != '\0');
 
+  mct_app_filter_builder_unshare_oars (_builder);
   g_hash_table_insert (_builder->oars, g_strdup (oars_section),
                        GUINT_TO_POINTER (value));
 }
@@ -66,6 +66,11 @@ typedef enum
  * are read-only for non-administrative users. The precise policy is set using
  * polkit.
  *
+ * As an #MctAppFilter is immutable, it may be shared between threads. Since
+ * 0.11.0, mct_app_filter_ref() and mct_app_filter_unref() are atomic, and all
+ * the methods which query the filter are safe to call concurrently from
+ * multiple threads. #MctAppFilterBuilder is not thread-safe.
+ *
  * Since: 0.2.0
  */
 typedef struct _MctAppFilter MctAppFilter;
@@ -77,12 +82,16 @@ void          mct_app_filter_unref (MctAppFilter *filter);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (MctAppFilter, mct_app_filter_unref)
 
+void     mct_app_filter_set_intern_strings     (gboolean      enabled);
+
 uid_t    mct_app_filter_get_user_id            (MctAppFilter *filter);
 
 gboolean mct_app_filter_is_enabled             (MctAppFilter *filter);
 
 gboolean mct_app_filter_is_path_allowed        (MctAppFilter *filter,
                                                 const gchar  *path);
+gboolean mct_app_filter_is_canonical_path_allowed (MctAppFilter *filter,
+                                                   const gchar  *path);
 gboolean mct_app_filter_is_flatpak_ref_allowed (MctAppFilter *filter,
                                                 const gchar  *app_ref);
 gboolean mct_app_filter_is_flatpak_app_allowed (MctAppFilter *filter,
@@ -91,10 +100,19 @@ gboolean mct_app_filter_is_appinfo_allowed     (MctAppFilter *filter,
                                                 GAppInfo     *app_info);
 gboolean mct_app_filter_is_content_type_allowed (MctAppFilter *filter,
                                                  const gchar  *content_type);
+gboolean mct_app_filter_is_content_type_hierarchy_allowed (MctAppFilter *filter,
+                                                           const gchar  *content_type);
+
+gboolean *mct_app_filter_check_app_infos (MctAppFilter     *filter,
+                                          GAppInfo * const *app_infos,
+                                          gsize             n_app_infos);
 
 const gchar           **mct_app_filter_get_oars_sections (MctAppFilter *filter);
 MctAppFilterOarsValue   mct_app_filter_get_oars_value    (MctAppFilter *filter,
                                                           const gchar  *oars_section);
+gboolean                mct_app_filter_is_content_rating_allowed (MctAppFilter  *filter,
+                                                                  GVariant      *content_rating,
+                                                                  const gchar  **offending_section_out);
 
 gboolean                mct_app_filter_is_user_installation_allowed   (MctAppFilter *filter);
 gboolean                mct_app_filter_is_system_installation_allowed (MctAppFilter *filter);
@@ -104,8 +122,46 @@ MctAppFilter *mct_app_filter_deserialize (GVariant      *variant,
                                           uid_t          user_id,
                                           GError       **error);
 
-gboolean mct_app_filter_equal (MctAppFilter *a,
-                               MctAppFilter *b);
+gboolean mct_app_filter_equal        (MctAppFilter *a,
+                                      MctAppFilter *b);
+gboolean mct_app_filter_policy_equal (MctAppFilter *a,
+                                      MctAppFilter *b);
+
+const gchar *mct_app_filter_get_digest (MctAppFilter *filter);
+
+/**
+ * MctAppFilterDiffFlags:
+ * @MCT_APP_FILTER_DIFF_FLAGS_NONE: The policies are the same.
+ * @MCT_APP_FILTER_DIFF_FLAGS_APP_LIST_TYPE: The app list changed between being
+ *    an allowlist and a blocklist.
+ * @MCT_APP_FILTER_DIFF_FLAGS_APP_LIST: Entries were added to or removed from
+ *    the app list.
+ * @MCT_APP_FILTER_DIFF_FLAGS_OARS: One or more OARS values changed.
+ * @MCT_APP_FILTER_DIFF_FLAGS_USER_INSTALLATION: Whether user installation is
+ *    allowed changed.
+ * @MCT_APP_FILTER_DIFF_FLAGS_SYSTEM_INSTALLATION: Whether system installation
+ *    is allowed changed.
+ *
+ * Flags returned by mct_app_filter_diff() to indicate which parts of the
+ * policy differ between two app filters.
+ *
+ * Since: 0.11.0
+ */
+typedef enum
+{
+  MCT_APP_FILTER_DIFF_FLAGS_NONE = 0,
+  MCT_APP_FILTER_DIFF_FLAGS_APP_LIST_TYPE = (1 << 0),
+  MCT_APP_FILTER_DIFF_FLAGS_APP_LIST = (1 << 1),
+  MCT_APP_FILTER_DIFF_FLAGS_OARS = (1 << 2),
+  MCT_APP_FILTER_DIFF_FLAGS_USER_INSTALLATION = (1 << 3),
+  MCT_APP_FILTER_DIFF_FLAGS_SYSTEM_INSTALLATION = (1 << 4),
+} MctAppFilterDiffFlags;
+
+MctAppFilterDiffFlags mct_app_filter_diff (MctAppFilter   *old_filter,
+                                           MctAppFilter   *new_filter,
+                                           gchar        ***added_entries_out,
+                                           gchar        ***removed_entries_out,
+                                           gchar        ***changed_oars_sections_out);
 
 /**
  * MctAppFilterBuilder:
@@ -161,6 +217,7 @@ G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (MctAppFilterBuilder,
                                   mct_app_filter_builder_clear)
 
 MctAppFilterBuilder *mct_app_filter_builder_new  (void);
+MctAppFilterBuilder *mct_app_filter_builder_new_from_filter (MctAppFilter *filter);
 MctAppFilterBuilder *mct_app_filter_builder_copy (MctAppFilterBuilder *builder);
 void                 mct_app_filter_builder_free (MctAppFilterBuilder *builder);
 
@@ -172,8 +229,38 @@ void mct_app_filter_builder_blocklist_path        (MctAppFilterBuilder   *builde
                                                    const gchar           *path);
 void mct_app_filter_builder_blocklist_flatpak_ref (MctAppFilterBuilder *builder,
                                                    const gchar         *app_ref);
+void mct_app_filter_builder_blocklist_flatpak_refs (MctAppFilterBuilder *builder,
+                                                    const gchar * const *app_refs);
 void mct_app_filter_builder_blocklist_content_type (MctAppFilterBuilder *builder,
                                                     const gchar         *content_type);
+void mct_app_filter_builder_blocklist_flatpak_ref_prefix (MctAppFilterBuilder *builder,
+                                                          const gchar         *ref_prefix);
+void mct_app_filter_builder_blocklist_content_type_prefix (MctAppFilterBuilder *builder,
+                                                           const gchar         *content_type_prefix);
+
+void mct_app_filter_builder_allowlist_path         (MctAppFilterBuilder *builder,
+                                                    const gchar         *path);
+void mct_app_filter_builder_allowlist_flatpak_ref  (MctAppFilterBuilder *builder,
+                                                    const gchar         *app_ref);
+void mct_app_filter_builder_allowlist_flatpak_refs (MctAppFilterBuilder *builder,
+                                                    const gchar * const *app_refs);
+void mct_app_filter_builder_allowlist_content_type (MctAppFilterBuilder *builder,
+                                                    const gchar         *content_type);
+void mct_app_filter_builder_allowlist_flatpak_ref_prefix (MctAppFilterBuilder *builder,
+                                                          const gchar         *ref_prefix);
+void mct_app_filter_builder_allowlist_content_type_prefix (MctAppFilterBuilder *builder,
+                                                           const gchar         *content_type_prefix);
+
+void mct_app_filter_builder_remove_path         (MctAppFilterBuilder *builder,
+                                                 const gchar         *path);
+void mct_app_filter_builder_remove_flatpak_ref  (MctAppFilterBuilder *builder,
+                                                 const gchar         *app_ref);
+void mct_app_filter_builder_remove_content_type (MctAppFilterBuilder *builder,
+                                                 const gchar         *content_type);
+void mct_app_filter_builder_remove_flatpak_ref_prefix (MctAppFilterBuilder *builder,
+                                                       const gchar         *ref_prefix);
+void mct_app_filter_builder_remove_content_type_prefix (MctAppFilterBuilder *builder,
+                                                        const gchar         *content_type_prefix);
 
 void mct_app_filter_builder_set_oars_value        (MctAppFilterBuilder   *builder,
                                                    const gchar           *oars_section,
@@ -23,6 +23,8 @@
 #pragma once
 
 #include <libmalcontent/app-filter.h>
+#include <libmalcontent/app-filter-cache.h>
 #include <libmalcontent/enums.h>
 #include <libmalcontent/manager.h>
 #include <libmalcontent/session-limits.h>
+#include <libmalcontent/usage-ledger.h>
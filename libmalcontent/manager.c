@@ -769,41 +769,20 @@ mct_manager_set_app_filter_finish (MctManager    *self,
   return g_task_propagate_boolean (G_TASK (result), error);
 }
 
-/**
- * mct_manager_get_session_limits:
- * @self: a #MctManager
- * @user_id: ID of the user to query, typically coming from getuid()
- * @flags: flags to affect the behaviour of the call
- * @cancellable: (nullable): a #GCancellable, or %NULL
- * @error: return location for a #GError, or %NULL
- *
- * Synchronous version of mct_manager_get_session_limits_async().
- *
- * Returns: (transfer full): session limits for the queried user
- * Since: 0.5.0
- */
-MctSessionLimits *
-mct_manager_get_session_limits (MctManager                *self,
-                                uid_t                      user_id,
-                                MctManagerGetValueFlags    flags,
-                                GCancellable              *cancellable,
-                                GError                   **error)
+/* Get the session limits for the user with ID @user_id, whose accountsservice
+ * object is at @object_path. */
+static MctSessionLimits *
+get_session_limits_for_object_path (MctManager    *self,
+                                    const gchar   *object_path,
+                                    uid_t          user_id,
+                                    gboolean       interactive,
+                                    GCancellable  *cancellable,
+                                    GError       **error)
 {
-  g_autofree gchar *object_path = NULL;
   g_autoptr(GVariant) result_variant = NULL;
   g_autoptr(GVariant) properties = NULL;
   g_autoptr(GError) local_error = NULL;
 
-  g_return_val_if_fail (MCT_IS_MANAGER (self), NULL);
-  g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
-  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
-
-  object_path = accounts_find_user_by_id (self->connection, user_id,
-                                          (flags & MCT_MANAGER_GET_VALUE_FLAGS_INTERACTIVE),
-                                          cancellable, error);
-  if (object_path == NULL)
-    return NULL;
-
   result_variant =
       g_dbus_connection_call_sync (self->connection,
                                    "org.freedesktop.Accounts",
@@ -812,7 +791,7 @@ mct_manager_get_session_limits (MctManager                *self,
                                    "GetAll",
                                    g_variant_new ("(s)", "com.endlessm.ParentalControls.SessionLimits"),
                                    G_VARIANT_TYPE ("(a{sv})"),
-                                   (flags & MCT_MANAGER_GET_VALUE_FLAGS_INTERACTIVE)
+                                   interactive
                                      ? G_DBUS_CALL_FLAGS_ALLOW_INTERACTIVE_AUTHORIZATION
                                      : G_DBUS_CALL_FLAGS_NONE,
                                    -1,  /* timeout, ms */
@@ -855,6 +834,43 @@ mct_manager_get_session_limits (MctManager                *self,
   return mct_session_limits_deserialize (properties, user_id, error);
 }
 
+/**
+ * mct_manager_get_session_limits:
+ * @self: a #MctManager
+ * @user_id: ID of the user to query, typically coming from getuid()
+ * @flags: flags to affect the behaviour of the call
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Synchronous version of mct_manager_get_session_limits_async().
+ *
+ * Returns: (transfer full): session limits for the queried user
+ * Since: 0.5.0
+ */
+MctSessionLimits *
+mct_manager_get_session_limits (MctManager                *self,
+                                uid_t                      user_id,
+                                MctManagerGetValueFlags    flags,
+                                GCancellable              *cancellable,
+                                GError                   **error)
+{
+  g_autofree gchar *object_path = NULL;
+
+  g_return_val_if_fail (MCT_IS_MANAGER (self), NULL);
+  g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  object_path = accounts_find_user_by_id (self->connection, user_id,
+                                          (flags & MCT_MANAGER_GET_VALUE_FLAGS_INTERACTIVE),
+                                          cancellable, error);
+  if (object_path == NULL)
+    return NULL;
+
+  return get_session_limits_for_object_path (self, object_path, user_id,
+                                             (flags & MCT_MANAGER_GET_VALUE_FLAGS_INTERACTIVE),
+                                             cancellable, error);
+}
+
 static void get_session_limits_thread_cb (GTask        *task,
                                           gpointer      source_object,
                                           gpointer      task_data,
@@ -986,6 +1002,7 @@ mct_manager_set_session_limits (MctManager                *self,
                                 GError                   **error)
 {
   g_autofree gchar *object_path = NULL;
+  g_autoptr(MctSessionLimits) current_limits = NULL;
   g_autoptr(GVariant) limit_type_variant = NULL;
   g_autoptr(GVariant) limit_type_result_variant = NULL;
   g_autoptr(GVariant) properties_variant = NULL;
@@ -1006,7 +1023,34 @@ mct_manager_set_session_limits (MctManager                *self,
   if (object_path == NULL)
     return FALSE;
 
-  properties_variant = mct_session_limits_serialize (session_limits);
+  properties_variant = g_variant_ref_sink (mct_session_limits_serialize (session_limits));
+
+  /* Don’t bother saving the limits (which could result in asking the user for
+   * admin permission) if they’re the same as the current ones. Compare the
+   * serialised forms, as they contain exactly the properties which would be
+   * set. The current limits are queried without interactive authorisation; if
+   * that fails, save the limits anyway. */
+  current_limits = get_session_limits_for_object_path (self, object_path, user_id,
+                                                       FALSE, cancellable, &local_error);
+  if (current_limits == NULL)
+    {
+      g_debug ("Error getting current session limits for user %u: %s",
+               (guint) user_id, local_error->message);
+      g_clear_error (&local_error);
+    }
+  else
+    {
+      g_autoptr(GVariant) current_properties_variant = NULL;
+
+      current_properties_variant = g_variant_ref_sink (mct_session_limits_serialize (current_limits));
+
+      if (g_variant_equal (current_properties_variant, properties_variant))
+        {
+          g_debug ("Not saving session limits for user %u as they haven’t changed",
+                   (guint) user_id);
+          return TRUE;
+        }
+    }
 
   g_variant_iter_init (&iter, properties_variant);
   while (g_variant_iter_loop (&iter, "{&sv}", &properties_key, &properties_value))
@@ -1109,6 +1153,11 @@ G_DEFINE_AUTOPTR_CLEANUP_FUNC (SetSessionLimitsData, set_session_limits_data_fre
  * returned via mct_manager_set_session_limits_finish(). The user’s session
  * limits settings will be left in an undefined state.
  *
+ * Since 0.11.0, the user’s current session limits are queried first, and if
+ * they serialise to the same properties as @session_limits (see
+ * mct_session_limits_serialize()), nothing is saved. This avoids asking for
+ * authorisation to make a change which does nothing.
+ *
  * Since: 0.5.0
  */
 void
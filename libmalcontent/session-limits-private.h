@@ -34,6 +34,10 @@ G_BEGIN_DECLS
  * @MCT_SESSION_LIMITS_TYPE_NONE: No session limits are imposed.
  * @MCT_SESSION_LIMITS_TYPE_DAILY_SCHEDULE: Sessions are limited to between a
  *     pair of given times each day.
+ * @MCT_SESSION_LIMITS_TYPE_WEEKLY_SCHEDULE: Sessions are limited to a set of
+ *     intervals within each week. (Since: 0.11.0)
+ * @MCT_SESSION_LIMITS_TYPE_DAILY_QUOTA: The total time spent in sessions is
+ *     limited to a given amount each day. (Since: 0.11.0)
  *
  * Types of session limit which can be imposed on an account. Additional types
  * may be added in future.
@@ -46,17 +50,42 @@ typedef enum
    * D-Bus interface, so must not be changed */
   MCT_SESSION_LIMITS_TYPE_NONE = 0,
   MCT_SESSION_LIMITS_TYPE_DAILY_SCHEDULE = 1,
+  MCT_SESSION_LIMITS_TYPE_WEEKLY_SCHEDULE = 2,
+  MCT_SESSION_LIMITS_TYPE_DAILY_QUOTA = 3,
 } MctSessionLimitsType;
 
+/* Number of seconds in a week, which is the length of a weekly schedule. */
+#define MCT_SESSION_LIMITS_WEEK_SECS (7 * 24 * 60 * 60)
+
+/* An interval of a schedule in which sessions are allowed, from @start
+ * (inclusive) to @end (exclusive), in seconds since the start of the schedule
+ * (midnight at the start of the day, or of Monday, in local time). */
+typedef struct
+{
+  guint start;
+  guint end;
+} MctSessionLimitsInterval;
+
 struct _MctSessionLimits
 {
-  gint ref_count;
+  gint ref_count;  /* (atomic) */
 
   uid_t user_id;
 
   MctSessionLimitsType limit_type;
   guint daily_start_time;  /* seconds since midnight */
   guint daily_end_time;  /* seconds since midnight */
+
+  /* Sorted by start time, with overlapping and adjacent intervals merged, so
+   * that a time can be looked up with a binary search. */
+  MctSessionLimitsInterval *weekly_schedule;  /* (owned) (nullable) (array length=n_weekly_schedule) */
+  gsize n_weekly_schedule;
+
+  guint daily_quota_secs;  /* seconds per day */
+
+  /* Calculated on first use. As the limits may be used from multiple threads,
+   * it is set atomically, once. */
+  gchar *digest;  /* (nullable) (owned) (atomic) */
 };
 
 G_END_DECLS
@@ -28,6 +28,7 @@
 #include <gio/gio.h>
 #include <libmalcontent/manager.h>
 #include <libmalcontent/session-limits.h>
+#include <libmalcontent/usage-ledger.h>
 
 #include "libmalcontent/session-limits-private.h"
 
@@ -42,6 +43,7 @@ G_DEFINE_BOXED_TYPE (MctSessionLimits, mct_session_limits,
  * @limits: (transfer none): an #MctSessionLimits
  *
  * Increment the reference count of @limits, and return the same pointer to it.
+ * This is atomic, so is safe to call from multiple threads.
  *
  * Returns: (transfer full): the same pointer as @limits
  * Since: 0.5.0
@@ -50,10 +52,10 @@ MctSessionLimits *
 mct_session_limits_ref (MctSessionLimits *limits)
 {
   g_return_val_if_fail (limits != NULL, NULL);
-  g_return_val_if_fail (limits->ref_count >= 1, NULL);
-  g_return_val_if_fail (limits->ref_count <= G_MAXINT - 1, NULL);
+  g_return_val_if_fail (g_atomic_int_get (&limits->ref_count) >= 1, NULL);
+  g_return_val_if_fail (g_atomic_int_get (&limits->ref_count) <= G_MAXINT - 1, NULL);
 
-  limits->ref_count++;
+  g_atomic_int_inc (&limits->ref_count);
   return limits;
 }
 
@@ -62,7 +64,8 @@ mct_session_limits_ref (MctSessionLimits *limits)
  * @limits: (transfer full): an #MctSessionLimits
  *
  * Decrement the reference count of @limits. If the reference count reaches
- * zero, free the @limits and all its resources.
+ * zero, free the @limits and all its resources. This is atomic, so is safe to
+ * call from multiple threads.
  *
  * Since: 0.5.0
  */
@@ -70,12 +73,12 @@ void
 mct_session_limits_unref (MctSessionLimits *limits)
 {
   g_return_if_fail (limits != NULL);
-  g_return_if_fail (limits->ref_count >= 1);
-
-  limits->ref_count--;
+  g_return_if_fail (g_atomic_int_get (&limits->ref_count) >= 1);
 
-  if (limits->ref_count <= 0)
+  if (g_atomic_int_dec_and_test (&limits->ref_count))
     {
+      g_free (limits->digest);
+      g_free (limits->weekly_schedule);
       g_free (limits);
     }
 }
@@ -123,6 +126,295 @@ mct_session_limits_is_enabled (MctSessionLimits *limits)
   return (limits->limit_type != MCT_SESSION_LIMITS_TYPE_NONE);
 }
 
+/* The latest time which can be evaluated, in seconds since the Unix epoch: the
+ * end of the year 9999, which is the latest time a #GDateTime can represent.
+ * Later times are treated as invalid. */
+#define MAX_UNIX_TIME_SECS G_GINT64_CONSTANT (253402300799)
+
+#define DAY_SECS (24 * 60 * 60)
+
+/* How far either side of a given time to look for changes in the offset of the
+ * local time zone from UTC. Time zones change offset at most a few times a
+ * year. */
+#define TIME_ZONE_SEARCH_WINDOW_SECS ((gint64) 366 * DAY_SECS)
+
+/* How often to re-query the local time zone, in case the system time zone has
+ * changed, in microseconds of monotonic time. */
+#define TIME_ZONE_REFRESH_INTERVAL_USECS ((gint64) 60 * G_USEC_PER_SEC)
+
+/* The offset of local time from UTC up to @change_secs, and the offset from
+ * then onwards. Times are in seconds since the Unix epoch. As offsets don’t
+ * change more than once in a few weeks, @next_offset_secs can be assumed to
+ * hold until the next boundary of any schedule, which is at most two weeks
+ * away. */
+typedef struct
+{
+  gint64 change_secs;
+  gint32 offset_secs;
+  gint32 next_offset_secs;
+} LocalTimeOffsets;
+
+/* Cache of the #LocalTimeOffsets of the local time zone around the time most
+ * recently evaluated, so that session limits can be evaluated repeatedly
+ * without querying the time zone. It’s valid for times in
+ * [@span_start_secs, @offsets.change_secs), and is rebuilt when the `TZ`
+ * environment variable changes, or every %TIME_ZONE_REFRESH_INTERVAL_USECS to
+ * pick up changes to the system time zone. */
+typedef struct
+{
+  gboolean valid;
+  gchar *tz_env;  /* (nullable) (owned) */
+  gint64 refresh_after_usecs;  /* monotonic time */
+  gint64 span_start_secs;
+  LocalTimeOffsets offsets;
+} LocalTimeZoneCache;
+
+G_LOCK_DEFINE_STATIC (local_time_zone_cache);
+static LocalTimeZoneCache local_time_zone_cache = { FALSE, NULL, 0, 0, { 0, 0, 0 } };
+
+static gint
+find_utc_interval (GTimeZone *tz,
+                   gint64     time_secs)
+{
+  return g_time_zone_find_interval (tz, G_TIME_TYPE_UNIVERSAL, time_secs);
+}
+
+/* Rebuild @cache around @now_secs from the current local time zone. The
+ * intervals of a #GTimeZone are numbered chronologically, so the bounds of the
+ * interval containing @now_secs can be found by bisection. */
+static void
+local_time_zone_cache_update (LocalTimeZoneCache *cache,
+                              const gchar        *tz_env,
+                              gint64              now_secs)
+{
+  g_autoptr(GTimeZone) tz = g_time_zone_new_local ();
+  gint interval, next_interval;
+  gint64 lo, hi;
+
+  interval = find_utc_interval (tz, now_secs);
+
+  /* Find the earliest time in the search window which is in @interval. */
+  lo = now_secs - TIME_ZONE_SEARCH_WINDOW_SECS;
+  hi = now_secs;
+
+  if (find_utc_interval (tz, lo) == interval)
+    hi = lo;
+
+  while (hi - lo > 1)
+    {
+      gint64 mid = lo + (hi - lo) / 2;
+
+      if (find_utc_interval (tz, mid) == interval)
+        hi = mid;
+      else
+        lo = mid;
+    }
+
+  cache->span_start_secs = hi;
+
+  /* Find the earliest time in the search window which is after @interval. If
+   * there is none, the offset doesn’t change within the window. */
+  lo = now_secs;
+  hi = now_secs + TIME_ZONE_SEARCH_WINDOW_SECS;
+
+  if (find_utc_interval (tz, hi) == interval)
+    lo = hi;
+
+  while (hi - lo > 1)
+    {
+      gint64 mid = lo + (hi - lo) / 2;
+
+      if (find_utc_interval (tz, mid) == interval)
+        lo = mid;
+      else
+        hi = mid;
+    }
+
+  next_interval = find_utc_interval (tz, hi);
+
+  cache->offsets.change_secs = hi;
+  cache->offsets.offset_secs = g_time_zone_get_offset (tz, interval);
+  cache->offsets.next_offset_secs = g_time_zone_get_offset (tz, next_interval);
+
+  if (g_strcmp0 (cache->tz_env, tz_env) != 0)
+    {
+      g_free (cache->tz_env);
+      cache->tz_env = g_strdup (tz_env);
+    }
+
+  cache->valid = TRUE;
+}
+
+/* Get the offsets of the local time zone from UTC around @now_secs. This is
+ * cheap and doesn’t allocate, unless the cache needs to be rebuilt. */
+static void
+get_local_time_offsets (gint64            now_secs,
+                        LocalTimeOffsets *offsets_out)
+{
+  LocalTimeZoneCache *cache = &local_time_zone_cache;
+  const gchar *tz_env = g_getenv ("TZ");
+  gint64 now_monotonic_usecs = g_get_monotonic_time ();
+
+  G_LOCK (local_time_zone_cache);
+
+  if (!cache->valid ||
+      now_secs < cache->span_start_secs ||
+      now_secs >= cache->offsets.change_secs ||
+      now_monotonic_usecs >= cache->refresh_after_usecs ||
+      g_strcmp0 (cache->tz_env, tz_env) != 0)
+    {
+      local_time_zone_cache_update (cache, tz_env, now_secs);
+      cache->refresh_after_usecs = now_monotonic_usecs + TIME_ZONE_REFRESH_INTERVAL_USECS;
+    }
+
+  *offsets_out = cache->offsets;
+
+  G_UNLOCK (local_time_zone_cache);
+}
+
+/* A schedule of intervals in which sessions are allowed, which repeats every
+ * @cycle_secs in local time. The first cycle started at @origin_secs, in
+ * seconds since the Unix epoch in local time. If @wraps is true, an interval
+ * which ends at the end of a cycle continues into one which starts at the
+ * start of the next cycle. */
+typedef struct
+{
+  const MctSessionLimitsInterval *intervals;  /* (array length=n_intervals) */
+  gsize n_intervals;
+  guint cycle_secs;
+  gint64 origin_secs;
+  gboolean wraps;
+} Schedule;
+
+/* Get the #Schedule for @limits, which must have a schedule limit type. The
+ * interval of a daily schedule is stored in @daily_interval, which must live
+ * as long as @schedule_out. */
+static void
+session_limits_get_schedule (MctSessionLimits         *limits,
+                             MctSessionLimitsInterval *daily_interval,
+                             Schedule                 *schedule_out)
+{
+  switch (limits->limit_type)
+    {
+    case MCT_SESSION_LIMITS_TYPE_DAILY_SCHEDULE:
+      daily_interval->start = limits->daily_start_time;
+      daily_interval->end = limits->daily_end_time;
+      schedule_out->intervals = daily_interval;
+      schedule_out->n_intervals = 1;
+      schedule_out->cycle_secs = DAY_SECS;
+      schedule_out->origin_secs = 0;
+      schedule_out->wraps = FALSE;
+      break;
+    case MCT_SESSION_LIMITS_TYPE_WEEKLY_SCHEDULE:
+      schedule_out->intervals = limits->weekly_schedule;
+      schedule_out->n_intervals = limits->n_weekly_schedule;
+      schedule_out->cycle_secs = MCT_SESSION_LIMITS_WEEK_SECS;
+      /* The Unix epoch was a Thursday; weeks start on Monday. */
+      schedule_out->origin_secs = 4 * DAY_SECS;
+      schedule_out->wraps = TRUE;
+      break;
+    case MCT_SESSION_LIMITS_TYPE_DAILY_QUOTA:
+    case MCT_SESSION_LIMITS_TYPE_NONE:
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+/* Split @time_secs into the start of the cycle of @schedule containing it (in
+ * seconds since the Unix epoch in local time) and the position within that
+ * cycle (in seconds). */
+static void
+local_time_split (const LocalTimeOffsets *offsets,
+                  const Schedule         *schedule,
+                  gint64                  time_secs,
+                  gint64                 *cycle_start_local_secs_out,
+                  guint                  *position_secs_out)
+{
+  gint64 local_secs, position_secs;
+
+  local_secs = time_secs + ((time_secs < offsets->change_secs) ? offsets->offset_secs
+                                                               : offsets->next_offset_secs);
+
+  /* Times just after the epoch may be before the origin in local time. */
+  position_secs = (local_secs - schedule->origin_secs) % schedule->cycle_secs;
+  if (position_secs < 0)
+    position_secs += schedule->cycle_secs;
+
+  *cycle_start_local_secs_out = local_secs - position_secs;
+  *position_secs_out = (guint) position_secs;
+}
+
+/* Convert @local_secs (seconds since the Unix epoch in local time, which must
+ * be later than @after_secs in local time) to the first UTC time after
+ * @after_secs at which the local time is @local_secs. If the change in
+ * offset skips over @local_secs, the time of the change is returned. */
+static gint64
+local_time_to_utc (const LocalTimeOffsets *offsets,
+                   gint64                  local_secs,
+                   gint64                  after_secs)
+{
+  if (after_secs < offsets->change_secs &&
+      local_secs - offsets->offset_secs < offsets->change_secs)
+    return local_secs - offsets->offset_secs;
+
+  return MAX (local_secs - offsets->next_offset_secs, offsets->change_secs);
+}
+
+/* Look up @position_secs in @schedule, returning whether sessions are allowed
+ * then. The position of the next change between being allowed and not is
+ * returned in @next_boundary_secs_out; it is relative to the start of the
+ * same cycle, so may be in the next cycle. If sessions are never allowed, it
+ * is %G_MAXUINT.
+ *
+ * The intervals are sorted and merged, so this is a binary search. */
+static gboolean
+schedule_lookup (const Schedule *schedule,
+                 guint           position_secs,
+                 guint          *next_boundary_secs_out)
+{
+  const MctSessionLimitsInterval *intervals = schedule->intervals;
+  gsize n_intervals = schedule->n_intervals;
+  gsize lo = 0, hi = n_intervals;
+
+  /* Find the first interval which ends after @position_secs. */
+  while (lo < hi)
+    {
+      gsize mid = lo + (hi - lo) / 2;
+
+      if (intervals[mid].end <= position_secs)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  if (lo < n_intervals && intervals[lo].start <= position_secs)
+    {
+      *next_boundary_secs_out = intervals[lo].end;
+
+      if (schedule->wraps &&
+          intervals[lo].end == schedule->cycle_secs &&
+          intervals[0].start == 0)
+        *next_boundary_secs_out = schedule->cycle_secs + intervals[0].end;
+
+      return TRUE;
+    }
+  else if (lo < n_intervals)
+    {
+      *next_boundary_secs_out = intervals[lo].start;
+      return FALSE;
+    }
+  else if (n_intervals > 0)
+    {
+      *next_boundary_secs_out = schedule->cycle_secs + intervals[0].start;
+      return FALSE;
+    }
+  else
+    {
+      *next_boundary_secs_out = G_MAXUINT;
+      return FALSE;
+    }
+}
+
 /**
  * mct_session_limits_check_time_remaining:
  * @limits: an #MctSessionLimits
@@ -142,6 +434,24 @@ mct_session_limits_is_enabled (MctSessionLimits *limits)
  * information about the policy and remaining time is provided in
  * @time_remaining_secs_out and @time_limit_enabled_out.
  *
+ * Since 0.11.0, times of day in @limits are interpreted in the local time zone
+ * (as given by g_time_zone_new_local()), and the time remaining accounts for
+ * any daylight saving change before the end of the session. Previously they
+ * were interpreted in UTC. The local time zone is cached, so this is cheap to
+ * call repeatedly; the cache is refreshed when the `TZ` environment variable
+ * changes, and otherwise at least once a minute. Weekly schedules start at
+ * midnight at the start of Monday, local time, and are looked up with a binary
+ * search, so are cheap to evaluate however many intervals they have.
+ *
+ * This function does no I/O, so it is suitable for calling from a main loop.
+ * That means it doesn’t know how long the user has spent in sessions today: if
+ * @limits is a daily quota (since 0.11.0), the whole quota is returned as the
+ * time remaining. To enforce a daily quota, use
+ * mct_session_limits_check_time_remaining_with_ledger(), which reads the
+ * user’s usage from their #MctUsageLedger, or
+ * mct_session_limits_check_time_remaining_with_usage() to provide the usage
+ * explicitly.
+ *
  * Returns: %TRUE if the user this @limits corresponds to is allowed to be in
  *     an active session at the given time; %FALSE otherwise
  * Since: 0.5.0
@@ -151,19 +461,121 @@ mct_session_limits_check_time_remaining (MctSessionLimits *limits,
                                          guint64           now_usecs,
                                          guint64          *time_remaining_secs_out,
                                          gboolean         *time_limit_enabled_out)
+{
+  g_return_val_if_fail (limits != NULL, FALSE);
+  g_return_val_if_fail (limits->ref_count >= 1, FALSE);
+
+  return mct_session_limits_check_time_remaining_with_usage (limits, now_usecs, 0,
+                                                             time_remaining_secs_out,
+                                                             time_limit_enabled_out);
+}
+
+/**
+ * mct_session_limits_check_time_remaining_with_ledger:
+ * @limits: an #MctSessionLimits
+ * @now_usecs: current time as microseconds since the Unix epoch (UTC),
+ *     typically queried using g_get_real_time()
+ * @ledger: usage ledger to read the user’s usage from
+ * @time_remaining_secs_out: (out) (optional): return location for the number
+ *     of seconds remaining before the user’s session has to end, if limits are
+ *     in force
+ * @time_limit_enabled_out: (out) (optional): return location for whether time
+ *     limits are enabled for this user
+ *
+ * Check whether the user has time remaining in which they are allowed to use
+ * the computer, as mct_session_limits_check_time_remaining() does, but reading
+ * the time they have spent in sessions today from @ledger, so that daily
+ * quotas are enforced. This is typically the user’s ledger from
+ * mct_usage_ledger_new_for_user(). @ledger is only read if @limits is a daily
+ * quota; only its last record is read, so this is cheap regardless of the
+ * user’s history, but it does block on file I/O.
+ *
+ * If @ledger can’t be read, a warning is logged and %FALSE is returned, with
+ * no time remaining.
+ *
+ * Returns: %TRUE if the user this @limits corresponds to is allowed to be in
+ *     an active session at the given time; %FALSE otherwise
+ * Since: 0.11.0
+ */
+gboolean
+mct_session_limits_check_time_remaining_with_ledger (MctSessionLimits *limits,
+                                                     guint64           now_usecs,
+                                                     MctUsageLedger   *ledger,
+                                                     guint64          *time_remaining_secs_out,
+                                                     gboolean         *time_limit_enabled_out)
+{
+  guint64 usage_secs = 0;
+  g_autoptr(GError) local_error = NULL;
+
+  g_return_val_if_fail (limits != NULL, FALSE);
+  g_return_val_if_fail (limits->ref_count >= 1, FALSE);
+  g_return_val_if_fail (MCT_IS_USAGE_LEDGER (ledger), FALSE);
+
+  if (limits->limit_type == MCT_SESSION_LIMITS_TYPE_DAILY_QUOTA &&
+      !mct_usage_ledger_get_usage (ledger, now_usecs, &usage_secs, &local_error))
+    {
+      /* Fail closed, rather than giving the user a full quota. */
+      g_warning ("Error getting usage for user %u; not allowing session: %s",
+                 (guint) limits->user_id, local_error->message);
+
+      if (time_remaining_secs_out != NULL)
+        *time_remaining_secs_out = 0;
+      if (time_limit_enabled_out != NULL)
+        *time_limit_enabled_out = TRUE;
+
+      return FALSE;
+    }
+
+  return mct_session_limits_check_time_remaining_with_usage (limits, now_usecs, usage_secs,
+                                                             time_remaining_secs_out,
+                                                             time_limit_enabled_out);
+}
+
+/**
+ * mct_session_limits_check_time_remaining_with_usage:
+ * @limits: an #MctSessionLimits
+ * @now_usecs: current time as microseconds since the Unix epoch (UTC),
+ *     typically queried using g_get_real_time()
+ * @usage_secs: number of seconds the user has spent in sessions so far on the
+ *     local day containing @now_usecs
+ * @time_remaining_secs_out: (out) (optional): return location for the number
+ *     of seconds remaining before the user’s session has to end, if limits are
+ *     in force
+ * @time_limit_enabled_out: (out) (optional): return location for whether time
+ *     limits are enabled for this user
+ *
+ * Check whether the user has time remaining in which they are allowed to use
+ * the computer, as mct_session_limits_check_time_remaining() does, but using
+ * @usage_secs as the time they have spent in sessions today, so that daily
+ * quotas are enforced. @usage_secs is ignored unless @limits is a daily
+ * quota.
+ *
+ * Returns: %TRUE if the user this @limits corresponds to is allowed to be in
+ *     an active session at the given time; %FALSE otherwise
+ * Since: 0.11.0
+ */
+gboolean
+mct_session_limits_check_time_remaining_with_usage (MctSessionLimits *limits,
+                                                    guint64           now_usecs,
+                                                    guint64           usage_secs,
+                                                    guint64          *time_remaining_secs_out,
+                                                    gboolean         *time_limit_enabled_out)
 {
   guint64 time_remaining_secs;
   gboolean time_limit_enabled;
   gboolean user_allowed_now;
-  g_autoptr(GDateTime) now_dt = NULL;
-  guint64 now_time_of_day_secs;
+  gint64 now_secs;
+  LocalTimeOffsets offsets;
+  MctSessionLimitsInterval daily_interval;
+  Schedule schedule;
+  gint64 cycle_start_local_secs;
+  guint now_position_secs, next_boundary_secs;
 
   g_return_val_if_fail (limits != NULL, FALSE);
   g_return_val_if_fail (limits->ref_count >= 1, FALSE);
 
   /* Helper calculations. */
-  now_dt = g_date_time_new_from_unix_utc (now_usecs / G_USEC_PER_SEC);
-  if (now_dt == NULL)
+  if (now_usecs / G_USEC_PER_SEC > (guint64) MAX_UNIX_TIME_SECS)
     {
       time_remaining_secs = 0;
       time_limit_enabled = TRUE;
@@ -171,23 +583,49 @@ mct_session_limits_check_time_remaining (MctSessionLimits *limits,
       goto out;
     }
 
-  now_time_of_day_secs = ((g_date_time_get_hour (now_dt) * 60 +
-                           g_date_time_get_minute (now_dt)) * 60 +
-                          g_date_time_get_second (now_dt));
+  now_secs = (gint64) (now_usecs / G_USEC_PER_SEC);
 
   /* Work out the limits. */
   switch (limits->limit_type)
     {
     case MCT_SESSION_LIMITS_TYPE_DAILY_SCHEDULE:
-      user_allowed_now = (now_time_of_day_secs >= limits->daily_start_time &&
-                          now_time_of_day_secs < limits->daily_end_time);
-      time_remaining_secs = user_allowed_now ? (limits->daily_end_time - now_time_of_day_secs) : 0;
+    case MCT_SESSION_LIMITS_TYPE_WEEKLY_SCHEDULE:
+      session_limits_get_schedule (limits, &daily_interval, &schedule);
+      get_local_time_offsets (now_secs, &offsets);
+      local_time_split (&offsets, &schedule, now_secs,
+                        &cycle_start_local_secs, &now_position_secs);
+
+      user_allowed_now = schedule_lookup (&schedule, now_position_secs, &next_boundary_secs);
+
+      if (user_allowed_now)
+        {
+          gint64 end_secs = local_time_to_utc (&offsets,
+                                               cycle_start_local_secs + next_boundary_secs,
+                                               now_secs);
+          time_remaining_secs = (guint64) (end_secs - now_secs);
+        }
+      else
+        {
+          time_remaining_secs = 0;
+        }
+
       time_limit_enabled = TRUE;
 
-      g_debug ("%s: Daily schedule limit allowed in %u–%u (now is %"
-               G_GUINT64_FORMAT "); %" G_GUINT64_FORMAT " seconds remaining",
-               G_STRFUNC, limits->daily_start_time, limits->daily_end_time,
-               now_time_of_day_secs, time_remaining_secs);
+      g_debug ("%s: Schedule limit of type %u with %" G_GSIZE_FORMAT
+               " intervals (now is %u of %u); %" G_GUINT64_FORMAT
+               " seconds remaining",
+               G_STRFUNC, (guint) limits->limit_type, schedule.n_intervals,
+               now_position_secs, schedule.cycle_secs, time_remaining_secs);
+
+      break;
+    case MCT_SESSION_LIMITS_TYPE_DAILY_QUOTA:
+      user_allowed_now = (usage_secs < limits->daily_quota_secs);
+      time_remaining_secs = user_allowed_now ? limits->daily_quota_secs - usage_secs : 0;
+      time_limit_enabled = TRUE;
+
+      g_debug ("%s: Daily quota of %u seconds, with %" G_GUINT64_FORMAT
+               " seconds used; %" G_GUINT64_FORMAT " seconds remaining",
+               G_STRFUNC, limits->daily_quota_secs, usage_secs, time_remaining_secs);
 
       break;
     case MCT_SESSION_LIMITS_TYPE_NONE:
@@ -216,6 +654,173 @@ out:
   return user_allowed_now;
 }
 
+/**
+ * mct_session_limits_get_next_transition:
+ * @limits: an #MctSessionLimits
+ * @now_usecs: current time as microseconds since the Unix epoch (UTC),
+ *     typically queried using g_get_real_time()
+ * @next_transition_usecs_out: (out) (optional): return location for the time
+ *     of the next transition, as microseconds since the Unix epoch (UTC)
+ * @allowed_after_out: (out) (optional): return location for whether the user
+ *     is allowed to be in an active session after the next transition
+ *
+ * Work out when the user next changes between being allowed and not being
+ * allowed to use the computer, after @now_usecs, according to the session
+ * limit policy from @limits. This may be on a later day than @now_usecs.
+ *
+ * This allows a single timer to be set for the next transition, rather than
+ * polling mct_session_limits_check_time_remaining(). Times of day are
+ * interpreted in the same way as by mct_session_limits_check_time_remaining(),
+ * so a transition may be caused by a daylight saving change, if it moves the
+ * local time into or out of the allowed times.
+ *
+ * If the user is always allowed (or never allowed) to use the computer from
+ * @now_usecs onwards, %FALSE is returned and the out arguments are not set.
+ *
+ * Daily quotas depend on how long the user spends in sessions rather than on
+ * the time, so they have no transitions; use
+ * mct_session_limits_check_time_remaining() to find how much of the quota is
+ * left.
+ *
+ * Returns: %TRUE if there is a next transition; %FALSE otherwise
+ * Since: 0.11.0
+ */
+gboolean
+mct_session_limits_get_next_transition (MctSessionLimits *limits,
+                                        guint64           now_usecs,
+                                        guint64          *next_transition_usecs_out,
+                                        gboolean         *allowed_after_out)
+{
+  gint64 now_secs, time_secs, next_transition_secs = 0;
+  LocalTimeOffsets offsets;
+  MctSessionLimitsInterval daily_interval;
+  Schedule schedule;
+  gint64 cycle_start_local_secs;
+  guint position_secs, next_boundary_secs;
+  gboolean allowed_now, allowed_after = FALSE;
+
+  g_return_val_if_fail (limits != NULL, FALSE);
+  g_return_val_if_fail (limits->ref_count >= 1, FALSE);
+
+  /* Times which mct_session_limits_check_time_remaining() can’t handle are
+   * never allowed, so there are no transitions. */
+  if (now_usecs / G_USEC_PER_SEC > (guint64) MAX_UNIX_TIME_SECS)
+    return FALSE;
+
+  now_secs = (gint64) (now_usecs / G_USEC_PER_SEC);
+
+  switch (limits->limit_type)
+    {
+    case MCT_SESSION_LIMITS_TYPE_DAILY_SCHEDULE:
+    case MCT_SESSION_LIMITS_TYPE_WEEKLY_SCHEDULE:
+      session_limits_get_schedule (limits, &daily_interval, &schedule);
+
+      /* Empty schedules, and schedules covering the whole cycle, have no
+       * transitions. */
+      if (schedule.n_intervals == 0 ||
+          (schedule.n_intervals == 1 &&
+           schedule.intervals[0].start == 0 &&
+           schedule.intervals[0].end == schedule.cycle_secs))
+        return FALSE;
+
+      get_local_time_offsets (now_secs, &offsets);
+      local_time_split (&offsets, &schedule, now_secs,
+                        &cycle_start_local_secs, &position_secs);
+      allowed_now = schedule_lookup (&schedule, position_secs, &next_boundary_secs);
+
+      /* Step through the boundaries of the schedule, and the next change of
+       * offset, until the result changes. This normally takes one step, but
+       * may take more if a change of offset skips a boundary. */
+      time_secs = now_secs;
+
+      for (guint i = 0; i < 3; i++)
+        {
+          next_transition_secs = local_time_to_utc (&offsets,
+                                                    cycle_start_local_secs + next_boundary_secs,
+                                                    time_secs);
+          if (time_secs < offsets.change_secs &&
+              offsets.change_secs < next_transition_secs)
+            next_transition_secs = offsets.change_secs;
+
+          local_time_split (&offsets, &schedule, next_transition_secs,
+                            &cycle_start_local_secs, &position_secs);
+          allowed_after = schedule_lookup (&schedule, position_secs, &next_boundary_secs);
+          time_secs = next_transition_secs;
+
+          if (allowed_after != allowed_now)
+            break;
+        }
+
+      if (allowed_after == allowed_now)
+        return FALSE;
+
+      g_debug ("%s: Schedule limit of type %u with %" G_GSIZE_FORMAT
+               " intervals; next transition at %" G_GINT64_FORMAT " to %s",
+               G_STRFUNC, (guint) limits->limit_type, schedule.n_intervals,
+               next_transition_secs, allowed_after ? "allowed" : "not allowed");
+
+      break;
+    case MCT_SESSION_LIMITS_TYPE_DAILY_QUOTA:
+    case MCT_SESSION_LIMITS_TYPE_NONE:
+    default:
+      return FALSE;
+    }
+
+  /* Postconditions. */
+  g_assert (next_transition_secs > now_secs);
+
+  /* Output. */
+  if (next_transition_usecs_out != NULL)
+    *next_transition_usecs_out = (guint64) next_transition_secs * G_USEC_PER_SEC;
+  if (allowed_after_out != NULL)
+    *allowed_after_out = allowed_after;
+
+  return TRUE;
+}
+
+static gint
+interval_compare_cb (gconstpointer a,
+                     gconstpointer b)
+{
+  const MctSessionLimitsInterval *interval_a = a;
+  const MctSessionLimitsInterval *interval_b = b;
+
+  if (interval_a->start != interval_b->start)
+    return (interval_a->start < interval_b->start) ? -1 : 1;
+  if (interval_a->end != interval_b->end)
+    return (interval_a->end < interval_b->end) ? -1 : 1;
+  return 0;
+}
+
+/* Sort @intervals (in place) and merge any which overlap or are adjacent, so
+ * the result can be binary searched by schedule_lookup(). The merged intervals
+ * are returned as a newly allocated array (or %NULL if there are none), with
+ * its length in @n_merged_out. */
+static MctSessionLimitsInterval *
+merge_intervals (GArray *intervals,
+                 gsize  *n_merged_out)
+{
+  MctSessionLimitsInterval *merged;
+  gsize n_merged = 0;
+
+  g_array_sort (intervals, interval_compare_cb);
+  merged = g_new (MctSessionLimitsInterval, intervals->len);
+
+  for (guint i = 0; i < intervals->len; i++)
+    {
+      const MctSessionLimitsInterval *interval = &g_array_index (intervals, MctSessionLimitsInterval, i);
+
+      if (n_merged > 0 && interval->start <= merged[n_merged - 1].end)
+        merged[n_merged - 1].end = MAX (merged[n_merged - 1].end, interval->end);
+      else
+        merged[n_merged++] = *interval;
+    }
+
+  *n_merged_out = n_merged;
+
+  return merged;
+}
+
 /**
  * mct_session_limits_serialize:
  * @limits: an #MctSessionLimits
@@ -250,6 +855,23 @@ mct_session_limits_serialize (MctSessionLimits *limits)
                                      limits->daily_end_time);
       limit_property_name = "DailySchedule";
       break;
+    case MCT_SESSION_LIMITS_TYPE_WEEKLY_SCHEDULE:
+      {
+        g_auto(GVariantBuilder) schedule_builder = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("a(uu)"));
+
+        for (gsize i = 0; i < limits->n_weekly_schedule; i++)
+          g_variant_builder_add (&schedule_builder, "(uu)",
+                                 limits->weekly_schedule[i].start,
+                                 limits->weekly_schedule[i].end);
+
+        limit_variant = g_variant_builder_end (&schedule_builder);
+        limit_property_name = "WeeklySchedule";
+        break;
+      }
+    case MCT_SESSION_LIMITS_TYPE_DAILY_QUOTA:
+      limit_variant = g_variant_new_uint32 (limits->daily_quota_secs);
+      limit_property_name = "DailyQuota";
+      break;
     case MCT_SESSION_LIMITS_TYPE_NONE:
       limit_variant = NULL;
       limit_property_name = NULL;
@@ -294,6 +916,9 @@ mct_session_limits_deserialize (GVariant  *variant,
   g_autoptr(MctSessionLimits) session_limits = NULL;
   guint32 limit_type;
   guint32 daily_start_time, daily_end_time;
+  guint32 daily_quota_secs;
+  g_autoptr(GVariant) weekly_schedule_variant = NULL;
+  g_autoptr(GArray) weekly_intervals = NULL;
 
   g_return_val_if_fail (variant != NULL, NULL);
   g_return_val_if_fail (error == NULL || *error == NULL, NULL);
@@ -321,7 +946,7 @@ mct_session_limits_deserialize (GVariant  *variant,
   /* Check that the limit type is something we support. */
   G_STATIC_ASSERT (sizeof (limit_type) >= sizeof (MctSessionLimitsType));
 
-  if ((guint) limit_type > MCT_SESSION_LIMITS_TYPE_DAILY_SCHEDULE)
+  if ((guint) limit_type > MCT_SESSION_LIMITS_TYPE_DAILY_QUOTA)
     {
       g_set_error (error, MCT_MANAGER_ERROR,
                    MCT_MANAGER_ERROR_INVALID_DATA,
@@ -348,6 +973,48 @@ mct_session_limits_deserialize (GVariant  *variant,
       return NULL;
     }
 
+  /* The default value is an empty array. */
+  weekly_intervals = g_array_new (FALSE, FALSE, sizeof (MctSessionLimitsInterval));
+
+  if (g_variant_lookup (variant, "WeeklySchedule", "@a(uu)",
+                        &weekly_schedule_variant))
+    {
+      GVariantIter iter;
+      MctSessionLimitsInterval interval;
+
+      g_variant_iter_init (&iter, weekly_schedule_variant);
+
+      while (g_variant_iter_next (&iter, "(uu)", &interval.start, &interval.end))
+        {
+          if (interval.start >= interval.end ||
+              interval.end > MCT_SESSION_LIMITS_WEEK_SECS)
+            {
+              g_set_error (error, MCT_MANAGER_ERROR,
+                           MCT_MANAGER_ERROR_INVALID_DATA,
+                           _("Session limit for user %u has invalid weekly schedule interval %u–%u"),
+                           (guint) user_id, interval.start, interval.end);
+              return NULL;
+            }
+
+          g_array_append_val (weekly_intervals, interval);
+        }
+    }
+
+  if (!g_variant_lookup (variant, "DailyQuota", "u", &daily_quota_secs))
+    {
+      /* Default value. */
+      daily_quota_secs = 24 * 60 * 60;
+    }
+
+  if (daily_quota_secs > 24 * 60 * 60)
+    {
+      g_set_error (error, MCT_MANAGER_ERROR,
+                   MCT_MANAGER_ERROR_INVALID_DATA,
+                   _("Session limit for user %u has invalid daily quota %u"),
+                   (guint) user_id, daily_quota_secs);
+      return NULL;
+    }
+
   /* Success. Create an #MctSessionLimits object to contain the results. */
   session_limits = g_new0 (MctSessionLimits, 1);
   session_limits->ref_count = 1;
@@ -355,10 +1022,138 @@ mct_session_limits_deserialize (GVariant  *variant,
   session_limits->limit_type = limit_type;
   session_limits->daily_start_time = daily_start_time;
   session_limits->daily_end_time = daily_end_time;
+  session_limits->daily_quota_secs = daily_quota_secs;
+
+  if (limit_type == MCT_SESSION_LIMITS_TYPE_WEEKLY_SCHEDULE)
+    session_limits->weekly_schedule = merge_intervals (weekly_intervals,
+                                                       &session_limits->n_weekly_schedule);
 
   return g_steal_pointer (&session_limits);
 }
 
+/* Build a variant which describes the policy in @limits, for calculating its
+ * digest. Unlike the serialised form, this only includes the details of the
+ * limit type in use, so it doesn’t depend on the values left in the other
+ * properties. Weekly schedules are sorted and merged, so don’t depend on the
+ * order their intervals were added in. The leading version number must be
+ * incremented if the format changes. */
+static GVariant *
+mct_session_limits_build_digest_variant (MctSessionLimits *limits)
+{
+  GVariant *limit_variant;
+
+  switch (limits->limit_type)
+    {
+    case MCT_SESSION_LIMITS_TYPE_DAILY_SCHEDULE:
+      limit_variant = g_variant_new ("(uu)",
+                                     limits->daily_start_time,
+                                     limits->daily_end_time);
+      break;
+    case MCT_SESSION_LIMITS_TYPE_WEEKLY_SCHEDULE:
+      {
+        g_auto(GVariantBuilder) schedule_builder = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("a(uu)"));
+
+        for (gsize i = 0; i < limits->n_weekly_schedule; i++)
+          g_variant_builder_add (&schedule_builder, "(uu)",
+                                 limits->weekly_schedule[i].start,
+                                 limits->weekly_schedule[i].end);
+
+        limit_variant = g_variant_builder_end (&schedule_builder);
+        break;
+      }
+    case MCT_SESSION_LIMITS_TYPE_DAILY_QUOTA:
+      limit_variant = g_variant_new_uint32 (limits->daily_quota_secs);
+      break;
+    case MCT_SESSION_LIMITS_TYPE_NONE:
+      limit_variant = g_variant_new ("()");
+      break;
+    default:
+      g_assert_not_reached ();
+    }
+
+  return g_variant_new ("(uuv)",
+                        (guint32) 1,
+                        (guint32) limits->limit_type,
+                        limit_variant);
+}
+
+/**
+ * mct_session_limits_get_digest:
+ * @limits: an #MctSessionLimits
+ *
+ * Get a digest of the policy in @limits. Session limits which apply the same
+ * policy have the same digest, regardless of which user they are for, or
+ * whether they were built or deserialised. This makes the digest suitable for
+ * cheaply checking whether session limits have changed, for example before
+ * saving them.
+ *
+ * The digest is a SHA-256 checksum in lowercase hexadecimal. It is calculated
+ * the first time it is needed, and then cached.
+ *
+ * Returns: (transfer none): digest of the policy in @limits
+ * Since: 0.11.0
+ */
+const gchar *
+mct_session_limits_get_digest (MctSessionLimits *limits)
+{
+  gchar *digest;
+
+  g_return_val_if_fail (limits != NULL, NULL);
+  g_return_val_if_fail (limits->ref_count >= 1, NULL);
+
+  digest = g_atomic_pointer_get (&limits->digest);
+
+  if (digest == NULL)
+    {
+      g_autoptr(GVariant) variant = g_variant_ref_sink (mct_session_limits_build_digest_variant (limits));
+      gchar *new_digest = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+                                                       g_variant_get_data (variant),
+                                                       g_variant_get_size (variant));
+
+      /* Another thread may have got here first. */
+      if (g_atomic_pointer_compare_and_exchange (&limits->digest, NULL, new_digest))
+        {
+          digest = new_digest;
+        }
+      else
+        {
+          g_free (new_digest);
+          digest = g_atomic_pointer_get (&limits->digest);
+        }
+    }
+
+  return digest;
+}
+
+/**
+ * mct_session_limits_equal:
+ * @a: (not nullable): an #MctSessionLimits
+ * @b: (not nullable): an #MctSessionLimits
+ *
+ * Check whether session limits @a and @b are equal: they are for the same
+ * user, and have the same policy. This compares the limits’ digests (see
+ * mct_session_limits_get_digest()), so is cheap once the digests have been
+ * calculated. To compare only the policies, compare the digests directly.
+ *
+ * Returns: %TRUE if @a and @b are equal, %FALSE otherwise
+ * Since: 0.11.0
+ */
+gboolean
+mct_session_limits_equal (MctSessionLimits *a,
+                          MctSessionLimits *b)
+{
+  g_return_val_if_fail (a != NULL, FALSE);
+  g_return_val_if_fail (a->ref_count >= 1, FALSE);
+  g_return_val_if_fail (b != NULL, FALSE);
+  g_return_val_if_fail (b->ref_count >= 1, FALSE);
+
+  if (a == b)
+    return TRUE;
+
+  return (a->user_id == b->user_id &&
+          g_str_equal (mct_session_limits_get_digest (a), mct_session_limits_get_digest (b)));
+}
+
 /*
  * Actual implementation of #MctSessionLimitsBuilder.
  *
@@ -376,10 +1171,18 @@ typedef struct
           guint start_time;  /* seconds since midnight */
           guint end_time;  /* seconds since midnight */
         } daily_schedule;
+      struct
+        {
+          guint quota_secs;
+        } daily_quota;
     };
 
+  /* Used if @limit_type is %MCT_SESSION_LIMITS_TYPE_WEEKLY_SCHEDULE. This is
+   * outside the union so as not to change the layout of the public struct. */
+  GArray *weekly_schedule;  /* (owned) (nullable) (element-type MctSessionLimitsInterval) */
+
   /*< private >*/
-  gpointer padding[10];
+  gpointer padding[9];
 } MctSessionLimitsBuilderReal;
 
 G_STATIC_ASSERT (sizeof (MctSessionLimitsBuilderReal) ==
@@ -436,7 +1239,7 @@ mct_session_limits_builder_clear (MctSessionLimitsBuilder *builder)
 
   g_return_if_fail (_builder != NULL);
 
-  /* Nothing to free here for now. */
+  g_clear_pointer (&_builder->weekly_schedule, g_array_unref);
   _builder->limit_type = MCT_SESSION_LIMITS_TYPE_NONE;
 }
 
@@ -494,6 +1297,15 @@ mct_session_limits_builder_copy (MctSessionLimitsBuilder *builder)
       _copy->daily_schedule.start_time = _builder->daily_schedule.start_time;
       _copy->daily_schedule.end_time = _builder->daily_schedule.end_time;
       break;
+    case MCT_SESSION_LIMITS_TYPE_WEEKLY_SCHEDULE:
+      _copy->weekly_schedule = g_array_sized_new (FALSE, FALSE, sizeof (MctSessionLimitsInterval),
+                                                  _builder->weekly_schedule->len);
+      g_array_append_vals (_copy->weekly_schedule, _builder->weekly_schedule->data,
+                           _builder->weekly_schedule->len);
+      break;
+    case MCT_SESSION_LIMITS_TYPE_DAILY_QUOTA:
+      _copy->daily_quota.quota_secs = _builder->daily_quota.quota_secs;
+      break;
     case MCT_SESSION_LIMITS_TYPE_NONE:
     default:
       break;
@@ -545,6 +1357,7 @@ mct_session_limits_builder_end (MctSessionLimitsBuilder *builder)
   session_limits->ref_count = 1;
   session_limits->user_id = -1;
   session_limits->limit_type = _builder->limit_type;
+  session_limits->daily_quota_secs = 24 * 60 * 60;
 
   switch (_builder->limit_type)
     {
@@ -552,6 +1365,21 @@ mct_session_limits_builder_end (MctSessionLimitsBuilder *builder)
       session_limits->daily_start_time = _builder->daily_schedule.start_time;
       session_limits->daily_end_time = _builder->daily_schedule.end_time;
       break;
+    case MCT_SESSION_LIMITS_TYPE_WEEKLY_SCHEDULE:
+      session_limits->weekly_schedule = merge_intervals (_builder->weekly_schedule,
+                                                         &session_limits->n_weekly_schedule);
+
+      /* Defaults: */
+      session_limits->daily_start_time = 0;
+      session_limits->daily_end_time = 24 * 60 * 60;
+      break;
+    case MCT_SESSION_LIMITS_TYPE_DAILY_QUOTA:
+      session_limits->daily_quota_secs = _builder->daily_quota.quota_secs;
+
+      /* Defaults: */
+      session_limits->daily_start_time = 0;
+      session_limits->daily_end_time = 24 * 60 * 60;
+      break;
     case MCT_SESSION_LIMITS_TYPE_NONE:
     default:
       /* Defaults: */
@@ -580,7 +1408,7 @@ mct_session_limits_builder_set_none (MctSessionLimitsBuilder *builder)
 
   g_return_if_fail (_builder != NULL);
 
-  /* This will need to free other limit types’ data first in future. */
+  g_clear_pointer (&_builder->weekly_schedule, g_array_unref);
   _builder->limit_type = MCT_SESSION_LIMITS_TYPE_NONE;
 }
 
@@ -613,8 +1441,110 @@ mct_session_limits_builder_set_daily_schedule (MctSessionLimitsBuilder *builder,
   g_return_if_fail (start_time_secs < end_time_secs);
   g_return_if_fail (end_time_secs <= 24 * 60 * 60);
 
-  /* This will need to free other limit types’ data first in future. */
+  g_clear_pointer (&_builder->weekly_schedule, g_array_unref);
   _builder->limit_type = MCT_SESSION_LIMITS_TYPE_DAILY_SCHEDULE;
   _builder->daily_schedule.start_time = start_time_secs;
   _builder->daily_schedule.end_time = end_time_secs;
 }
+
+/**
+ * mct_session_limits_builder_set_weekly_schedule:
+ * @builder: an initialised #MctSessionLimitsBuilder
+ *
+ * Set the session limits in @builder to be a weekly schedule, where sessions
+ * are only allowed in the intervals added with
+ * mct_session_limits_builder_add_weekly_interval(). Initially there are no
+ * intervals, so sessions are never allowed.
+ *
+ * Weekly schedules allow several intervals a day, and different intervals on
+ * different days of the week, unlike
+ * mct_session_limits_builder_set_daily_schedule().
+ *
+ * This will overwrite any other session limits, including any intervals
+ * already added to a weekly schedule.
+ *
+ * Since: 0.11.0
+ */
+void
+mct_session_limits_builder_set_weekly_schedule (MctSessionLimitsBuilder *builder)
+{
+  MctSessionLimitsBuilderReal *_builder = (MctSessionLimitsBuilderReal *) builder;
+
+  g_return_if_fail (_builder != NULL);
+
+  g_clear_pointer (&_builder->weekly_schedule, g_array_unref);
+  _builder->limit_type = MCT_SESSION_LIMITS_TYPE_WEEKLY_SCHEDULE;
+  _builder->weekly_schedule = g_array_new (FALSE, FALSE, sizeof (MctSessionLimitsInterval));
+}
+
+/**
+ * mct_session_limits_builder_add_weekly_interval:
+ * @builder: an initialised #MctSessionLimitsBuilder
+ * @weekday: day of the week the interval is on
+ * @start_time_secs: number of seconds since midnight when the user’s session
+ *     can first start
+ * @end_time_secs: number of seconds since midnight when the user’s session can
+ *     last end
+ *
+ * Add an interval to the weekly schedule in @builder, in which sessions are
+ * allowed between @start_time_secs and @end_time_secs on @weekday every week.
+ * @end_time_secs must be greater than @start_time_secs, and must be at most
+ * `24 * 60 * 60`. To allow sessions across midnight, add an interval ending at
+ * `24 * 60 * 60` and one starting at `0` on the following day.
+ *
+ * Intervals may overlap; overlapping and adjacent intervals are merged.
+ *
+ * mct_session_limits_builder_set_weekly_schedule() must have been called on
+ * @builder first.
+ *
+ * Since: 0.11.0
+ */
+void
+mct_session_limits_builder_add_weekly_interval (MctSessionLimitsBuilder *builder,
+                                                GDateWeekday             weekday,
+                                                guint                    start_time_secs,
+                                                guint                    end_time_secs)
+{
+  MctSessionLimitsBuilderReal *_builder = (MctSessionLimitsBuilderReal *) builder;
+  MctSessionLimitsInterval interval;
+
+  g_return_if_fail (_builder != NULL);
+  g_return_if_fail (_builder->limit_type == MCT_SESSION_LIMITS_TYPE_WEEKLY_SCHEDULE);
+  g_return_if_fail (g_date_valid_weekday (weekday));
+  g_return_if_fail (start_time_secs < end_time_secs);
+  g_return_if_fail (end_time_secs <= 24 * 60 * 60);
+
+  /* Weeks start on Monday. */
+  interval.start = (weekday - G_DATE_MONDAY) * 24 * 60 * 60 + start_time_secs;
+  interval.end = (weekday - G_DATE_MONDAY) * 24 * 60 * 60 + end_time_secs;
+
+  g_array_append_val (_builder->weekly_schedule, interval);
+}
+
+/**
+ * mct_session_limits_builder_set_daily_quota:
+ * @builder: an initialised #MctSessionLimitsBuilder
+ * @quota_secs: number of seconds the user may spend in sessions each day
+ *
+ * Set the session limits in @builder to be a daily quota, where sessions are
+ * allowed at any time, but only for a total of @quota_secs each day. Time spent
+ * in sessions is recorded in the user’s #MctUsageLedger, and the total is reset
+ * at midnight, local time. @quota_secs must be at most `24 * 60 * 60`.
+ *
+ * This will overwrite any other session limits.
+ *
+ * Since: 0.11.0
+ */
+void
+mct_session_limits_builder_set_daily_quota (MctSessionLimitsBuilder *builder,
+                                            guint                    quota_secs)
+{
+  MctSessionLimitsBuilderReal *_builder = (MctSessionLimitsBuilderReal *) builder;
+
+  g_return_if_fail (_builder != NULL);
+  g_return_if_fail (quota_secs <= 24 * 60 * 60);
+
+  g_clear_pointer (&_builder->weekly_schedule, g_array_unref);
+  _builder->limit_type = MCT_SESSION_LIMITS_TYPE_DAILY_QUOTA;
+  _builder->daily_quota.quota_secs = quota_secs;
+}
@@ -25,6 +25,7 @@
 #include <gio/gio.h>
 #include <glib.h>
 #include <glib-object.h>
+#include <libmalcontent/usage-ledger.h>
 
 G_BEGIN_DECLS
 
@@ -40,6 +41,12 @@ G_BEGIN_DECLS
  * and are read-only for non-administrative users. The precise policy is set
  * using polkit.
  *
+ * As an #MctSessionLimits is immutable, it may be shared between threads.
+ * Since 0.11.0, mct_session_limits_ref() and mct_session_limits_unref() are
+ * atomic, and all the methods which query the limits are safe to call
+ * concurrently from multiple threads. #MctSessionLimitsBuilder is not
+ * thread-safe.
+ *
  * Since: 0.5.0
  */
 typedef struct _MctSessionLimits MctSessionLimits;
@@ -59,12 +66,31 @@ gboolean mct_session_limits_check_time_remaining (MctSessionLimits *limits,
                                                   guint64           now_usecs,
                                                   guint64          *time_remaining_secs_out,
                                                   gboolean         *time_limit_enabled_out);
+gboolean mct_session_limits_check_time_remaining_with_usage (MctSessionLimits *limits,
+                                                             guint64           now_usecs,
+                                                             guint64           usage_secs,
+                                                             guint64          *time_remaining_secs_out,
+                                                             gboolean         *time_limit_enabled_out);
+gboolean mct_session_limits_check_time_remaining_with_ledger (MctSessionLimits *limits,
+                                                              guint64           now_usecs,
+                                                              MctUsageLedger   *ledger,
+                                                              guint64          *time_remaining_secs_out,
+                                                              gboolean         *time_limit_enabled_out);
+gboolean mct_session_limits_get_next_transition  (MctSessionLimits *limits,
+                                                  guint64           now_usecs,
+                                                  guint64          *next_transition_usecs_out,
+                                                  gboolean         *allowed_after_out);
 
 GVariant         *mct_session_limits_serialize   (MctSessionLimits  *limits);
 MctSessionLimits *mct_session_limits_deserialize (GVariant          *variant,
                                                   uid_t              user_id,
                                                   GError           **error);
 
+gboolean     mct_session_limits_equal      (MctSessionLimits *a,
+                                            MctSessionLimits *b);
+
+const gchar *mct_session_limits_get_digest (MctSessionLimits *limits);
+
 /**
  * MctSessionLimitsBuilder:
  *
@@ -128,4 +154,13 @@ void mct_session_limits_builder_set_daily_schedule (MctSessionLimitsBuilder *bui
                                                     guint                    start_time_secs,
                                                     guint                    end_time_secs);
 
+void mct_session_limits_builder_set_weekly_schedule (MctSessionLimitsBuilder *builder);
+void mct_session_limits_builder_add_weekly_interval (MctSessionLimitsBuilder *builder,
+                                                     GDateWeekday             weekday,
+                                                     guint                    start_time_secs,
+                                                     guint                    end_time_secs);
+
+void mct_session_limits_builder_set_daily_quota (MctSessionLimitsBuilder *builder,
+                                                 guint                    quota_secs);
+
 G_END_DECLS
@@ -0,0 +1,389 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2020 Endless Mobile, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gdesktopappinfo.h>
+#include <gio/gio.h>
+#include <libmalcontent/app-filter.h>
+#include <libmalcontent/app-filter-cache.h>
+#include <locale.h>
+#include <utime.h>
+
+#include "libmalcontent/app-filter-cache-private.h"
+
+
+static const gchar *true_desktop_file_data =
+  "[Desktop Entry]\n"
+  "Name=Some Name\n"
+  "Exec=/bin/true\n"
+  "Type=Application\n";
+static const gchar *false_desktop_file_data =
+  "[Desktop Entry]\n"
+  "Name=Some Name\n"
+  "Exec=/bin/false\n"
+  "Type=Application\n";
+
+/* Data directory which desktop files are looked up in, set as
+ * `$XDG_DATA_DIRS` for the whole test program, as GLib only reads it once. */
+static gchar *data_dir = NULL;
+static gchar *applications_dir = NULL;
+
+/* Fixture for tests which need desktop files on disk. The desktop files for
+ * both IDs are deleted after each test. */
+typedef struct
+{
+  gchar *app_desktop_file_path;  /* (owned) */
+  gchar *other_desktop_file_path;  /* (owned) */
+} CacheFixture;
+
+#define APP_ID "org.example.App.desktop"
+#define OTHER_APP_ID "org.example.OtherApp.desktop"
+
+static void
+setup (CacheFixture  *fixture,
+       gconstpointer  test_data)
+{
+  fixture->app_desktop_file_path = g_build_filename (applications_dir, APP_ID, NULL);
+  fixture->other_desktop_file_path = g_build_filename (applications_dir, OTHER_APP_ID, NULL);
+}
+
+static void
+teardown (CacheFixture  *fixture,
+          gconstpointer  test_data)
+{
+  g_unlink (fixture->app_desktop_file_path);
+  g_unlink (fixture->other_desktop_file_path);
+
+  g_clear_pointer (&fixture->app_desktop_file_path, g_free);
+  g_clear_pointer (&fixture->other_desktop_file_path, g_free);
+}
+
+/* Write @data to the desktop file for @desktop_id, setting its modification
+ * time to @mtime, and load it by its ID. */
+static GAppInfo *
+write_desktop_file (const gchar *desktop_id,
+                    const gchar *data,
+                    time_t       mtime)
+{
+  g_autoptr(GError) local_error = NULL;
+  g_autoptr(GDesktopAppInfo) appinfo = NULL;
+  g_autofree gchar *path = g_build_filename (applications_dir, desktop_id, NULL);
+  struct utimbuf times = { mtime, mtime };
+
+  g_file_set_contents (path, data, -1, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_cmpint (g_utime (path, &times), ==, 0);
+
+  appinfo = g_desktop_app_info_new (desktop_id);
+  g_assert_nonnull (appinfo);
+  g_assert_cmpstr (g_app_info_get_id (G_APP_INFO (appinfo)), ==, desktop_id);
+  g_assert_cmpstr (g_desktop_app_info_get_filename (appinfo), ==, path);
+
+  return G_APP_INFO (g_steal_pointer (&appinfo));
+}
+
+/* Emit #GAppInfoMonitor::changed, as if GLib had noticed that desktop files
+ * have changed. */
+static void
+emit_app_info_monitor_changed (void)
+{
+  g_autoptr(GAppInfoMonitor) monitor = g_app_info_monitor_get ();
+
+  g_signal_emit_by_name (monitor, "changed");
+}
+
+/* Build a filter which blocks @path, or which is empty if @path is %NULL. */
+static MctAppFilter *
+build_filter (const gchar *path)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+
+  if (path != NULL)
+    mct_app_filter_builder_blocklist_path (&builder, path);
+
+  return mct_app_filter_builder_end (&builder);
+}
+
+/* Test that the #GType definitions for various types work. */
+static void
+test_app_filter_cache_types (void)
+{
+  g_type_ensure (mct_app_filter_cache_get_type ());
+}
+
+/* Test that the properties of an #MctAppFilterCache work. */
+static void
+test_app_filter_cache_properties (void)
+{
+  g_autoptr(MctAppFilter) filter = build_filter (NULL);
+  g_autoptr(MctAppFilter) filter2 = build_filter ("/bin/false");
+  g_autoptr(MctAppFilter) filter_prop = NULL;
+  g_autoptr(MctAppFilterCache) cache = NULL;
+
+  cache = mct_app_filter_cache_new (filter);
+  g_assert_true (mct_app_filter_cache_get_filter (cache) == filter);
+
+  g_object_get (cache, "filter", &filter_prop, NULL);
+  g_assert_true (filter_prop == filter);
+
+  mct_app_filter_cache_set_filter (cache, filter2);
+  g_assert_true (mct_app_filter_cache_get_filter (cache) == filter2);
+}
+
+/* Test that verdicts from the cache match those from
+ * mct_app_filter_is_appinfo_allowed(), that repeated checks are answered from
+ * the cache, and that verdicts are recalculated when the filter changes. */
+static void
+test_app_filter_cache_verdicts (CacheFixture  *fixture,
+                                gconstpointer  test_data)
+{
+  g_autoptr(MctAppFilter) empty_filter = build_filter (NULL);
+  g_autoptr(MctAppFilter) empty_filter2 = build_filter (NULL);
+  g_autoptr(MctAppFilter) blocking_filter = build_filter ("/bin/true");
+  g_autoptr(MctAppFilterCache) cache = NULL;
+  g_autoptr(GAppInfo) appinfo = NULL;
+
+  appinfo = write_desktop_file (APP_ID, true_desktop_file_data, 1000);
+  cache = mct_app_filter_cache_new (empty_filter);
+
+  /* Check twice, so the second check hits the cache. */
+  g_assert_true (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo));
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 0);
+  g_assert_true (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo));
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 1);
+
+  /* Changing to an equal filter keeps the verdicts. */
+  mct_app_filter_cache_set_filter (cache, empty_filter2);
+  g_assert_true (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo));
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 2);
+
+  /* Changing to a different filter invalidates them. */
+  mct_app_filter_cache_set_filter (cache, blocking_filter);
+  g_assert_false (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo));
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 2);
+  g_assert_false (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo));
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 3);
+
+  mct_app_filter_cache_set_filter (cache, empty_filter);
+  g_assert_true (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo));
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 3);
+
+  /* Explicit invalidation shouldn’t change the result. */
+  mct_app_filter_cache_invalidate (cache);
+  g_assert_true (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo));
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 3);
+}
+
+/* Test that when #GAppInfoMonitor reports that apps have changed, the verdicts
+ * for desktop files which have been modified (even within the same second) or
+ * removed are dropped, and the others are kept. */
+static void
+test_app_filter_cache_modified (CacheFixture  *fixture,
+                                gconstpointer  test_data)
+{
+  g_autoptr(MctAppFilter) filter = build_filter ("/bin/false");
+  g_autoptr(MctAppFilterCache) cache = NULL;
+  g_autoptr(GAppInfo) appinfo1 = NULL;
+  g_autoptr(GAppInfo) appinfo2 = NULL;
+  g_autoptr(GAppInfo) other_appinfo = NULL;
+
+  cache = mct_app_filter_cache_new (filter);
+
+  appinfo1 = write_desktop_file (APP_ID, true_desktop_file_data, 1000);
+  other_appinfo = write_desktop_file (OTHER_APP_ID, true_desktop_file_data, 1000);
+  g_assert_true (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo1));
+  g_assert_true (mct_app_filter_cache_is_appinfo_allowed (cache, other_appinfo));
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 0);
+
+  /* Rewrite one of the files to run a blocked program, keeping the same
+   * modification time. */
+  appinfo2 = write_desktop_file (APP_ID, false_desktop_file_data, 1000);
+  emit_app_info_monitor_changed ();
+
+  g_assert_false (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo2));
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 0);
+  g_assert_false (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo2));
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 1);
+
+  /* The other app’s verdict is kept. */
+  g_assert_true (mct_app_filter_cache_is_appinfo_allowed (cache, other_appinfo));
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 2);
+
+  /* Removing a desktop file drops its verdict. */
+  g_assert_cmpint (g_unlink (fixture->other_desktop_file_path), ==, 0);
+  emit_app_info_monitor_changed ();
+
+  g_assert_true (mct_app_filter_cache_is_appinfo_allowed (cache, other_appinfo));
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 2);
+}
+
+/* Test that verdicts are recalculated when `$PATH` changes, as programs are
+ * looked up in it. */
+static void
+test_app_filter_cache_path (CacheFixture  *fixture,
+                            gconstpointer  test_data)
+{
+  g_autoptr(MctAppFilter) filter = build_filter ("/bin/false");
+  g_autoptr(MctAppFilterCache) cache = NULL;
+  g_autoptr(GAppInfo) appinfo = NULL;
+  g_autofree gchar *old_path = g_strdup (g_getenv ("PATH"));
+  g_autofree gchar *new_path = g_strconcat ("/nonexistent:", (old_path != NULL) ? old_path : "", NULL);
+
+  cache = mct_app_filter_cache_new (filter);
+  appinfo = write_desktop_file (APP_ID, true_desktop_file_data, 1000);
+
+  g_assert_true (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo));
+  g_assert_true (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo));
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 1);
+
+  g_setenv ("PATH", new_path, TRUE);
+  g_assert_true (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo));
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 1);
+  g_assert_true (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo));
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 2);
+
+  if (old_path != NULL)
+    g_setenv ("PATH", old_path, TRUE);
+  else
+    g_unsetenv ("PATH");
+}
+
+/* Test that app infos which don’t have a desktop ID are checked correctly,
+ * without being cached. */
+static void
+test_app_filter_cache_no_file (void)
+{
+  g_autoptr(MctAppFilter) filter = build_filter ("/bin/false");
+  g_autoptr(MctAppFilterCache) cache = NULL;
+  const gchar *data[] = { true_desktop_file_data, false_desktop_file_data };
+  const gboolean expected_allowed[] = { TRUE, FALSE };
+
+  cache = mct_app_filter_cache_new (filter);
+
+  for (gsize i = 0; i < G_N_ELEMENTS (data); i++)
+    {
+      g_autoptr(GKeyFile) key_file = NULL;
+      g_autoptr(GError) local_error = NULL;
+      g_autoptr(GAppInfo) appinfo = NULL;
+
+      key_file = g_key_file_new ();
+      g_key_file_load_from_data (key_file, data[i], -1,
+                                 G_KEY_FILE_NONE, &local_error);
+      g_assert_no_error (local_error);
+
+      appinfo = G_APP_INFO (g_desktop_app_info_new_from_keyfile (key_file));
+      g_assert_nonnull (appinfo);
+
+      g_assert_cmpint (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo), ==,
+                       expected_allowed[i]);
+      g_assert_cmpint (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo), ==,
+                       expected_allowed[i]);
+    }
+
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, 0);
+}
+
+/* Test the performance of checking the same app repeatedly, with and without
+ * the cache. */
+static void
+test_app_filter_cache_perf_is_appinfo_allowed (CacheFixture  *fixture,
+                                               gconstpointer  test_data)
+{
+  g_autoptr(MctAppFilter) filter = build_filter ("/bin/false");
+  g_autoptr(MctAppFilterCache) cache = NULL;
+  g_autoptr(GAppInfo) appinfo = NULL;
+  g_autoptr(GTimer) timer = NULL;
+  const guint n_iterations = 100000;
+  gdouble uncached_secs, cached_secs;
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Performance tests not enabled");
+      return;
+    }
+
+  cache = mct_app_filter_cache_new (filter);
+  appinfo = write_desktop_file (APP_ID, true_desktop_file_data, 1000);
+  timer = g_timer_new ();
+
+  for (guint i = 0; i < n_iterations; i++)
+    g_assert_true (mct_app_filter_is_appinfo_allowed (filter, appinfo));
+
+  uncached_secs = g_timer_elapsed (timer, NULL);
+  g_timer_start (timer);
+
+  for (guint i = 0; i < n_iterations; i++)
+    g_assert_true (mct_app_filter_cache_is_appinfo_allowed (cache, appinfo));
+
+  cached_secs = g_timer_elapsed (timer, NULL);
+
+  g_assert_cmpuint (_mct_app_filter_cache_get_n_hits (cache), ==, n_iterations - 1);
+
+  g_test_minimized_result (uncached_secs * 1e9 / n_iterations,
+                           "mct_app_filter_is_appinfo_allowed(): %.1f ns per call",
+                           uncached_secs * 1e9 / n_iterations);
+  g_test_minimized_result (cached_secs * 1e9 / n_iterations,
+                           "mct_app_filter_cache_is_appinfo_allowed(): %.1f ns per call",
+                           cached_secs * 1e9 / n_iterations);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_autoptr(GError) local_error = NULL;
+  int retval;
+
+  setlocale (LC_ALL, "");
+
+  /* Look up desktop files in a temporary directory. */
+  data_dir = g_dir_make_tmp ("malcontent-app-filter-cache-XXXXXX", &local_error);
+  g_assert_no_error (local_error);
+  applications_dir = g_build_filename (data_dir, "applications", NULL);
+  g_assert_cmpint (g_mkdir (applications_dir, 0755), ==, 0);
+
+  g_setenv ("XDG_DATA_HOME", data_dir, TRUE);
+  g_setenv ("XDG_DATA_DIRS", data_dir, TRUE);
+
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/app-filter-cache/types", test_app_filter_cache_types);
+  g_test_add_func ("/app-filter-cache/properties", test_app_filter_cache_properties);
+  g_test_add ("/app-filter-cache/verdicts", CacheFixture, NULL,
+              setup, test_app_filter_cache_verdicts, teardown);
+  g_test_add ("/app-filter-cache/modified", CacheFixture, NULL,
+              setup, test_app_filter_cache_modified, teardown);
+  g_test_add ("/app-filter-cache/path", CacheFixture, NULL,
+              setup, test_app_filter_cache_path, teardown);
+  g_test_add_func ("/app-filter-cache/no-file", test_app_filter_cache_no_file);
+  g_test_add ("/app-filter-cache/perf/is-appinfo-allowed", CacheFixture, NULL,
+              setup, test_app_filter_cache_perf_is_appinfo_allowed, teardown);
+
+  retval = g_test_run ();
+
+  g_rmdir (applications_dir);
+  g_rmdir (data_dir);
+  g_clear_pointer (&applications_dir, g_free);
+  g_clear_pointer (&data_dir, g_free);
+
+  return retval;
+}
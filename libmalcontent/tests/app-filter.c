@@ -29,6 +29,9 @@
 #include <libmalcontent/manager.h>
 #include <libglib-testing/dbus-queue.h>
 #include <locale.h>
+#ifdef HAVE_MALLINFO2
+#include <malloc.h>
+#endif
 #include <string.h>
 #include "accounts-service-iface.h"
 #include "accounts-service-extension-iface.h"
@@ -85,6 +88,57 @@ test_app_filter_refs (void)
   /* Final ref is dropped by g_autoptr(). */
 }
 
+#define N_THREADS 8
+#define N_ITERATIONS 10000
+
+static gpointer
+refs_threads_thread_cb (gpointer user_data)
+{
+  g_autoptr(MctAppFilter) filter = user_data;
+
+  for (gsize i = 0; i < N_ITERATIONS; i++)
+    {
+      g_autoptr(MctAppFilter) filter_ref = mct_app_filter_ref (filter);
+
+      g_assert_true (mct_app_filter_is_enabled (filter_ref));
+      g_assert_false (mct_app_filter_is_path_allowed (filter_ref, "/bin/false"));
+      g_assert_true (mct_app_filter_is_path_allowed (filter_ref, "/bin/true"));
+      g_assert_false (mct_app_filter_is_flatpak_app_allowed (filter_ref, "org.gnome.Builder"));
+      g_assert_cmpint (mct_app_filter_get_oars_value (filter_ref, "drugs-alcohol"), ==,
+                       MCT_APP_FILTER_OARS_VALUE_MILD);
+    }
+
+  /* The last thread to finish frees the filter. */
+  return NULL;
+}
+
+/* Test that ref(), unref() and the query methods can be called on a single
+ * #MctAppFilter from several threads at once. */
+static void
+test_app_filter_refs_threads (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) filter = NULL;
+  GThread *threads[N_THREADS];
+
+  mct_app_filter_builder_blocklist_path (&builder, "/bin/false");
+  mct_app_filter_builder_blocklist_flatpak_ref (&builder, "app/org.gnome.Builder/x86_64/stable");
+  mct_app_filter_builder_set_oars_value (&builder, "drugs-alcohol",
+                                         MCT_APP_FILTER_OARS_VALUE_MILD);
+  filter = mct_app_filter_builder_end (&builder);
+
+  /* Give each thread its own reference, and drop ours before joining them, so
+   * that the filter is freed from one of the threads. */
+  for (gsize i = 0; i < G_N_ELEMENTS (threads); i++)
+    threads[i] = g_thread_new ("refs-threads", refs_threads_thread_cb,
+                               mct_app_filter_ref (filter));
+
+  g_clear_pointer (&filter, mct_app_filter_unref);
+
+  for (gsize i = 0; i < G_N_ELEMENTS (threads); i++)
+    g_thread_join (threads[i]);
+}
+
 /* Basic test of mct_app_filter_serialize() on an app filter. */
 static void
 test_app_filter_serialize (void)
@@ -134,6 +188,79 @@ test_app_filter_deserialize (void)
     }
 }
 
+/* Test how mct_app_filter_deserialize() handles entries containing `*` which
+ * may have been saved by versions of libmalcontent before prefix patterns
+ * were supported. Those which end in a single `*` after a valid prefix are
+ * prefix patterns; all others are matched literally. */
+static void
+test_app_filter_deserialize_wildcards (void)
+{
+  g_autoptr(GVariant) serialized = NULL;
+  g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(GError) local_error = NULL;
+
+  serialized = g_variant_ref_sink (g_variant_new_parsed (
+    "{ 'AppFilter': <(false, ['app/org.foo/*', 'app/org.bar/x86_64/stable/*', 'text/**'])> }"));
+  filter = mct_app_filter_deserialize (serialized, 1, &local_error);
+  g_assert_no_error (local_error);
+
+  /* `app/org.foo/` is a valid flatpak ref prefix. */
+  g_assert_false (mct_app_filter_is_flatpak_ref_allowed (filter, "app/org.foo/x86_64/stable"));
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (filter, "org.foo"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (filter, "org.foobar"));
+
+  /* `app/org.bar/x86_64/stable/` can’t be the start of a flatpak ref, so the
+   * entry is literal and matches nothing. */
+  g_assert_true (mct_app_filter_is_flatpak_ref_allowed (filter, "app/org.bar/x86_64/stable"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (filter, "org.bar"));
+
+  /* `text/**` has more than one `*`, so is literal. */
+  g_assert_false (mct_app_filter_is_content_type_allowed (filter, "text/**"));
+  g_assert_true (mct_app_filter_is_content_type_allowed (filter, "text/plain"));
+}
+
+/* Test that an app filter deserialised from a serialised variant, as it would
+ * be when loaded from D-Bus, remains valid after the variant is freed, as it
+ * borrows its app list from the variant. */
+static void
+test_app_filter_deserialize_borrowed (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(MctAppFilter) deserialized_filter = NULL;
+  g_autoptr(GVariant) serialized = NULL;
+  g_autoptr(GVariant) reserialized = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  GVariant *loaded;
+  g_autoptr(GError) local_error = NULL;
+
+  mct_app_filter_builder_blocklist_path (&builder, "/bin/true");
+  mct_app_filter_builder_blocklist_flatpak_ref (&builder, "app/org.gnome.Builder/x86_64/stable");
+  mct_app_filter_builder_blocklist_content_type (&builder, "x-scheme-handler/http");
+  filter = mct_app_filter_builder_end (&builder);
+
+  serialized = g_variant_ref_sink (mct_app_filter_serialize (filter));
+
+  /* Copy the serialised form into a new variant, and free it after
+   * deserialising. */
+  bytes = g_variant_get_data_as_bytes (serialized);
+  loaded = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE_VARDICT,
+                                                         bytes, FALSE));
+  g_clear_pointer (&bytes, g_bytes_unref);
+
+  deserialized_filter = mct_app_filter_deserialize (loaded, 1, &local_error);
+  g_assert_no_error (local_error);
+  g_variant_unref (loaded);
+
+  g_assert_false (mct_app_filter_is_path_allowed (deserialized_filter, "/bin/true"));
+  g_assert_true (mct_app_filter_is_path_allowed (deserialized_filter, "/bin/false"));
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (deserialized_filter, "org.gnome.Builder"));
+  g_assert_false (mct_app_filter_is_content_type_allowed (deserialized_filter, "x-scheme-handler/http"));
+
+  reserialized = g_variant_ref_sink (mct_app_filter_serialize (deserialized_filter));
+  g_assert_cmpvariant (reserialized, serialized);
+}
+
 /* Test of mct_app_filter_deserialize() on various invalid variants. */
 static void
 test_app_filter_deserialize_invalid (void)
@@ -221,6 +348,240 @@ test_app_filter_equal (void)
     mct_app_filter_unref (unequal_filters[i]);
 }
 
+/* Test that mct_app_filter_get_digest() and mct_app_filter_policy_equal()
+ * depend only on the policy in a filter, and not on how the filter was
+ * constructed or who it is for. */
+static void
+test_app_filter_digest (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) filter1 = NULL;
+  g_autoptr(MctAppFilter) filter2 = NULL;
+  g_autoptr(MctAppFilter) filter3 = NULL;
+  g_autoptr(MctAppFilter) filter4 = NULL;
+  g_autoptr(MctAppFilter) list_filter1 = NULL;
+  g_autoptr(MctAppFilter) list_filter2 = NULL;
+  g_autoptr(MctAppFilter) list_filter3 = NULL;
+  g_autoptr(GVariant) serialized = NULL;
+  g_autoptr(GVariant) list_serialized = NULL;
+  const gchar *digest1;
+  g_autoptr(GError) local_error = NULL;
+
+  /* Build the same policy with the OARS values set in different orders. */
+  mct_app_filter_builder_blocklist_path (&builder, "/bin/true");
+  mct_app_filter_builder_set_oars_value (&builder, "drugs-alcohol", MCT_APP_FILTER_OARS_VALUE_MILD);
+  mct_app_filter_builder_set_oars_value (&builder, "violence-cartoon", MCT_APP_FILTER_OARS_VALUE_NONE);
+  filter1 = mct_app_filter_builder_end (&builder);
+
+  mct_app_filter_builder_init (&builder);
+  mct_app_filter_builder_set_oars_value (&builder, "violence-cartoon", MCT_APP_FILTER_OARS_VALUE_NONE);
+  mct_app_filter_builder_set_oars_value (&builder, "drugs-alcohol", MCT_APP_FILTER_OARS_VALUE_MILD);
+  mct_app_filter_builder_blocklist_path (&builder, "/bin/true");
+  filter2 = mct_app_filter_builder_end (&builder);
+
+  digest1 = mct_app_filter_get_digest (filter1);
+  g_assert_cmpuint (strlen (digest1), ==, 64);
+  g_assert_true (mct_app_filter_get_digest (filter1) == digest1);
+  g_assert_cmpstr (mct_app_filter_get_digest (filter2), ==, digest1);
+  g_assert_true (mct_app_filter_policy_equal (filter1, filter2));
+
+  /* The same policy for a different user has the same digest, but isn’t
+   * equal. */
+  serialized = g_variant_ref_sink (mct_app_filter_serialize (filter1));
+  filter3 = mct_app_filter_deserialize (serialized, 1, &local_error);
+  g_assert_no_error (local_error);
+
+  g_assert_cmpstr (mct_app_filter_get_digest (filter3), ==, digest1);
+  g_assert_true (mct_app_filter_policy_equal (filter1, filter3));
+  g_assert_false (mct_app_filter_equal (filter1, filter3));
+
+  /* A different policy has a different digest. */
+  mct_app_filter_builder_init (&builder);
+  mct_app_filter_builder_blocklist_path (&builder, "/bin/true");
+  mct_app_filter_builder_set_oars_value (&builder, "drugs-alcohol", MCT_APP_FILTER_OARS_VALUE_MILD);
+  filter4 = mct_app_filter_builder_end (&builder);
+
+  g_assert_cmpstr (mct_app_filter_get_digest (filter4), !=, digest1);
+  g_assert_false (mct_app_filter_policy_equal (filter1, filter4));
+  g_assert_false (mct_app_filter_equal (filter1, filter4));
+
+  /* The order of the app list, and duplicates in it, don’t matter to the
+   * policy, but do to exact equality. */
+  mct_app_filter_builder_init (&builder);
+  mct_app_filter_builder_blocklist_path (&builder, "/bin/true");
+  mct_app_filter_builder_blocklist_content_type (&builder, "x-scheme-handler/http");
+  list_filter1 = mct_app_filter_builder_end (&builder);
+
+  mct_app_filter_builder_init (&builder);
+  mct_app_filter_builder_blocklist_content_type (&builder, "x-scheme-handler/http");
+  mct_app_filter_builder_blocklist_path (&builder, "/bin/true");
+  list_filter2 = mct_app_filter_builder_end (&builder);
+
+  list_serialized = g_variant_ref_sink (g_variant_parse (NULL,
+      "{ 'AppFilter': <(false, @as ['/bin/true', 'x-scheme-handler/http', '/bin/true'])> }",
+      NULL, NULL, NULL));
+  list_filter3 = mct_app_filter_deserialize (list_serialized, (uid_t) -1, &local_error);
+  g_assert_no_error (local_error);
+
+  /* Check exact equality first, so that the digests aren’t cached yet. */
+  g_assert_false (mct_app_filter_equal (list_filter1, list_filter2));
+  g_assert_false (mct_app_filter_equal (list_filter1, list_filter3));
+
+  g_assert_cmpstr (mct_app_filter_get_digest (list_filter2), ==,
+                   mct_app_filter_get_digest (list_filter1));
+  g_assert_cmpstr (mct_app_filter_get_digest (list_filter3), ==,
+                   mct_app_filter_get_digest (list_filter1));
+  g_assert_true (mct_app_filter_policy_equal (list_filter1, list_filter2));
+  g_assert_true (mct_app_filter_policy_equal (list_filter1, list_filter3));
+
+  /* And again, now that the digests are cached. */
+  g_assert_false (mct_app_filter_equal (list_filter1, list_filter2));
+  g_assert_false (mct_app_filter_equal (list_filter1, list_filter3));
+  g_assert_true (mct_app_filter_equal (list_filter1, list_filter1));
+}
+
+/* Test that mct_app_filter_diff() reports the changes between two filters. */
+static void
+test_app_filter_diff (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) old_filter = NULL;
+  g_autoptr(MctAppFilter) new_filter = NULL;
+  g_autoptr(MctAppFilter) allowlist_filter = NULL;
+  g_autoptr(MctAppFilter) duplicates_filter = NULL;
+  g_autoptr(GVariant) serialized = NULL;
+  g_auto(GStrv) added = NULL;
+  g_auto(GStrv) removed = NULL;
+  g_auto(GStrv) changed_oars = NULL;
+  const gchar * const expected_added[] = { "/bin/false", "text/html", NULL };
+  const gchar * const expected_removed[] = { "/bin/true", NULL };
+  const gchar * const expected_changed_oars[] = { "drugs-alcohol", "sex-nudity", "violence-cartoon", NULL };
+  const gchar * const expected_none[] = { NULL };
+
+  mct_app_filter_builder_blocklist_path (&builder, "/bin/true");
+  mct_app_filter_builder_blocklist_content_type (&builder, "x-scheme-handler/http");
+  mct_app_filter_builder_set_oars_value (&builder, "drugs-alcohol", MCT_APP_FILTER_OARS_VALUE_MILD);
+  mct_app_filter_builder_set_oars_value (&builder, "language-humor", MCT_APP_FILTER_OARS_VALUE_MILD);
+  mct_app_filter_builder_set_oars_value (&builder, "violence-cartoon", MCT_APP_FILTER_OARS_VALUE_NONE);
+  old_filter = mct_app_filter_builder_end (&builder);
+
+  mct_app_filter_builder_init (&builder);
+  mct_app_filter_builder_blocklist_path (&builder, "/bin/false");
+  mct_app_filter_builder_blocklist_content_type (&builder, "text/html");
+  mct_app_filter_builder_blocklist_content_type (&builder, "x-scheme-handler/http");
+  mct_app_filter_builder_set_oars_value (&builder, "language-humor", MCT_APP_FILTER_OARS_VALUE_MILD);
+  mct_app_filter_builder_set_oars_value (&builder, "sex-nudity", MCT_APP_FILTER_OARS_VALUE_NONE);
+  mct_app_filter_builder_set_oars_value (&builder, "violence-cartoon", MCT_APP_FILTER_OARS_VALUE_MILD);
+  mct_app_filter_builder_set_allow_user_installation (&builder, FALSE);
+  new_filter = mct_app_filter_builder_end (&builder);
+
+  g_assert_cmpint (mct_app_filter_diff (old_filter, new_filter,
+                                        &added, &removed, &changed_oars), ==,
+                   MCT_APP_FILTER_DIFF_FLAGS_APP_LIST |
+                   MCT_APP_FILTER_DIFF_FLAGS_OARS |
+                   MCT_APP_FILTER_DIFF_FLAGS_USER_INSTALLATION);
+  g_assert_true (g_strv_equal ((const gchar * const *) added, expected_added));
+  g_assert_true (g_strv_equal ((const gchar * const *) removed, expected_removed));
+  g_assert_true (g_strv_equal ((const gchar * const *) changed_oars, expected_changed_oars));
+
+  g_clear_pointer (&added, g_strfreev);
+  g_clear_pointer (&removed, g_strfreev);
+  g_clear_pointer (&changed_oars, g_strfreev);
+
+  /* Swapping the filters swaps the added and removed entries. */
+  g_assert_cmpint (mct_app_filter_diff (new_filter, old_filter,
+                                        &added, &removed, NULL), ==,
+                   MCT_APP_FILTER_DIFF_FLAGS_APP_LIST |
+                   MCT_APP_FILTER_DIFF_FLAGS_OARS |
+                   MCT_APP_FILTER_DIFF_FLAGS_USER_INSTALLATION);
+  g_assert_true (g_strv_equal ((const gchar * const *) added, expected_removed));
+  g_assert_true (g_strv_equal ((const gchar * const *) removed, expected_added));
+
+  g_clear_pointer (&added, g_strfreev);
+  g_clear_pointer (&removed, g_strfreev);
+
+  /* A filter has no differences from itself, or from a copy for another
+   * user. */
+  g_assert_cmpint (mct_app_filter_diff (old_filter, old_filter,
+                                        &added, &removed, &changed_oars), ==,
+                   MCT_APP_FILTER_DIFF_FLAGS_NONE);
+  g_assert_true (g_strv_equal ((const gchar * const *) added, expected_none));
+  g_assert_true (g_strv_equal ((const gchar * const *) removed, expected_none));
+  g_assert_true (g_strv_equal ((const gchar * const *) changed_oars, expected_none));
+
+  serialized = g_variant_ref_sink (mct_app_filter_serialize (old_filter));
+  duplicates_filter = mct_app_filter_deserialize (serialized, 1, NULL);
+  g_assert_nonnull (duplicates_filter);
+  g_assert_cmpint (mct_app_filter_diff (old_filter, duplicates_filter, NULL, NULL, NULL), ==,
+                   MCT_APP_FILTER_DIFF_FLAGS_NONE);
+  g_assert_cmpstr (mct_app_filter_get_digest (old_filter), ==,
+                   mct_app_filter_get_digest (duplicates_filter));
+  g_clear_pointer (&duplicates_filter, mct_app_filter_unref);
+  g_clear_pointer (&serialized, g_variant_unref);
+
+  /* Duplicate entries in a deserialised app list don’t count as changes. */
+  serialized = g_variant_ref_sink (g_variant_parse (NULL,
+      "{ 'AppFilter': <(false, @as ['/bin/true', 'x-scheme-handler/http', '/bin/true'])>,"
+      "  'OarsFilter': <('oars-1.1', { 'drugs-alcohol': 'mild', 'language-humor': 'mild', 'violence-cartoon': 'none' })> }",
+      NULL, NULL, NULL));
+  duplicates_filter = mct_app_filter_deserialize (serialized, 1, NULL);
+  g_assert_nonnull (duplicates_filter);
+  g_assert_cmpint (mct_app_filter_diff (old_filter, duplicates_filter, NULL, NULL, NULL), ==,
+                   MCT_APP_FILTER_DIFF_FLAGS_NONE);
+  g_assert_cmpstr (mct_app_filter_get_digest (old_filter), ==,
+                   mct_app_filter_get_digest (duplicates_filter));
+
+  /* Changing the list type is reported, even if the entries are the same. */
+  mct_app_filter_builder_init (&builder);
+  mct_app_filter_builder_allowlist_path (&builder, "/bin/true");
+  mct_app_filter_builder_allowlist_content_type (&builder, "x-scheme-handler/http");
+  mct_app_filter_builder_set_oars_value (&builder, "drugs-alcohol", MCT_APP_FILTER_OARS_VALUE_MILD);
+  mct_app_filter_builder_set_oars_value (&builder, "language-humor", MCT_APP_FILTER_OARS_VALUE_MILD);
+  mct_app_filter_builder_set_oars_value (&builder, "violence-cartoon", MCT_APP_FILTER_OARS_VALUE_NONE);
+  mct_app_filter_builder_set_allow_system_installation (&builder, TRUE);
+  allowlist_filter = mct_app_filter_builder_end (&builder);
+
+  g_assert_cmpint (mct_app_filter_diff (old_filter, allowlist_filter, NULL, NULL, NULL), ==,
+                   MCT_APP_FILTER_DIFF_FLAGS_APP_LIST_TYPE |
+                   MCT_APP_FILTER_DIFF_FLAGS_SYSTEM_INSTALLATION);
+  g_assert_cmpstr (mct_app_filter_get_digest (old_filter), !=,
+                   mct_app_filter_get_digest (allowlist_filter));
+}
+
+/* Test that the serialised form of a filter is the same each time it’s
+ * requested, and can be loaded again. */
+static void
+test_app_filter_serialize_cached (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(MctAppFilter) deserialized_filter = NULL;
+  g_autoptr(GVariant) serialized1 = NULL;
+  g_autoptr(GVariant) serialized2 = NULL;
+  g_autoptr(GError) local_error = NULL;
+
+  mct_app_filter_builder_blocklist_flatpak_ref (&builder, "app/org.gnome.Builder/x86_64/stable");
+  mct_app_filter_builder_set_oars_value (&builder, "violence-cartoon", MCT_APP_FILTER_OARS_VALUE_MILD);
+  mct_app_filter_builder_set_allow_user_installation (&builder, FALSE);
+  filter = mct_app_filter_builder_end (&builder);
+
+  serialized1 = g_variant_ref_sink (mct_app_filter_serialize (filter));
+  serialized2 = g_variant_ref_sink (mct_app_filter_serialize (filter));
+
+  g_assert_true (g_variant_is_of_type (serialized1, G_VARIANT_TYPE_VARDICT));
+  g_assert_cmpvariant (serialized1, serialized2);
+
+  deserialized_filter = mct_app_filter_deserialize (serialized2, 1, &local_error);
+  g_assert_no_error (local_error);
+
+  g_assert_cmpstr (mct_app_filter_get_digest (deserialized_filter), ==,
+                   mct_app_filter_get_digest (filter));
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (deserialized_filter, "org.gnome.Builder"));
+  g_assert_cmpint (mct_app_filter_get_oars_value (deserialized_filter, "violence-cartoon"), ==,
+                   MCT_APP_FILTER_OARS_VALUE_MILD);
+  g_assert_false (mct_app_filter_is_user_installation_allowed (deserialized_filter));
+}
+
 /* Test that mct_app_filter_is_enabled() returns the correct results on various
  * app filters. */
 static void
@@ -270,6 +631,118 @@ test_app_filter_is_enabled (void)
     }
 }
 
+/* Test that mct_app_filter_get_oars_value() and
+ * mct_app_filter_get_oars_sections() handle both sections defined by OARS and
+ * ones which aren’t. */
+static void
+test_app_filter_oars_sections (void)
+{
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(MctAppFilter) filter = NULL;
+  g_autofree const gchar **sections = NULL;
+  const gchar * const expected_sections[] =
+    {
+      "drugs-alcohol",
+      "made-up",
+      "violence-cartoon",
+      "violence-worship",
+      "x-unknown",
+      NULL
+    };
+
+  variant = g_variant_parse (NULL,
+                             "{ 'OarsFilter': <('oars-1.1', {"
+                             "  'x-unknown': 'intense',"
+                             "  'violence-cartoon': 'mild',"
+                             "  'made-up': 'moderate',"
+                             "  'violence-worship': '',"
+                             "  'drugs-alcohol': 'none'"
+                             "})> }", NULL, NULL, NULL);
+  g_assert (variant != NULL);
+
+  filter = mct_app_filter_deserialize (variant, 1, NULL);
+  g_assert (filter != NULL);
+
+  g_assert_cmpint (mct_app_filter_get_oars_value (filter, "violence-cartoon"), ==,
+                   MCT_APP_FILTER_OARS_VALUE_MILD);
+  g_assert_cmpint (mct_app_filter_get_oars_value (filter, "drugs-alcohol"), ==,
+                   MCT_APP_FILTER_OARS_VALUE_NONE);
+  g_assert_cmpint (mct_app_filter_get_oars_value (filter, "violence-worship"), ==,
+                   MCT_APP_FILTER_OARS_VALUE_UNKNOWN);
+  g_assert_cmpint (mct_app_filter_get_oars_value (filter, "violence-fantasy"), ==,
+                   MCT_APP_FILTER_OARS_VALUE_UNKNOWN);
+  g_assert_cmpint (mct_app_filter_get_oars_value (filter, "made-up"), ==,
+                   MCT_APP_FILTER_OARS_VALUE_MODERATE);
+  g_assert_cmpint (mct_app_filter_get_oars_value (filter, "x-unknown"), ==,
+                   MCT_APP_FILTER_OARS_VALUE_INTENSE);
+  g_assert_cmpint (mct_app_filter_get_oars_value (filter, "not-present"), ==,
+                   MCT_APP_FILTER_OARS_VALUE_UNKNOWN);
+
+  sections = mct_app_filter_get_oars_sections (filter);
+  assert_strv_equal ((const gchar * const *) sections, expected_sections);
+
+  g_assert_true (mct_app_filter_is_enabled (filter));
+}
+
+/* Test that mct_app_filter_is_content_rating_allowed() compares each section of
+ * an app’s content rating against the filter correctly. */
+static void
+test_app_filter_content_rating (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) filter = NULL;
+  const struct
+    {
+      const gchar *content_rating;
+      const gchar *expected_offending_section;  /* NULL if allowed */
+    }
+  vectors[] =
+    {
+      { "@a{ss} {}", NULL },
+      { "{ 'violence-cartoon': 'mild' }", NULL },
+      { "{ 'violence-cartoon': 'moderate' }", "violence-cartoon" },
+      { "{ 'violence-cartoon': 'none', 'drugs-alcohol': 'none' }", NULL },
+      { "{ 'violence-cartoon': 'none', 'drugs-alcohol': 'mild' }", "drugs-alcohol" },
+      { "{ 'drugs-alcohol': 'mild', 'violence-cartoon': 'intense' }", "drugs-alcohol" },
+      { "{ 'drugs-alcohol': 'invalid' }", NULL },
+      { "{ 'violence-fantasy': 'intense' }", NULL },
+      { "{ 'made-up': 'mild' }", NULL },
+      { "{ 'made-up': 'moderate' }", "made-up" },
+    };
+
+  mct_app_filter_builder_set_oars_value (&builder, "violence-cartoon",
+                                         MCT_APP_FILTER_OARS_VALUE_MILD);
+  mct_app_filter_builder_set_oars_value (&builder, "drugs-alcohol",
+                                         MCT_APP_FILTER_OARS_VALUE_NONE);
+  mct_app_filter_builder_set_oars_value (&builder, "made-up",
+                                         MCT_APP_FILTER_OARS_VALUE_MILD);
+
+  filter = mct_app_filter_builder_end (&builder);
+
+  for (gsize i = 0; i < G_N_ELEMENTS (vectors); i++)
+    {
+      g_autoptr(GVariant) content_rating = NULL;
+      const gchar *offending_section = NULL;
+      gboolean allowed;
+
+      g_test_message ("%" G_GSIZE_FORMAT ": %s", i, vectors[i].content_rating);
+
+      content_rating = g_variant_parse (G_VARIANT_TYPE ("a{ss}"),
+                                        vectors[i].content_rating,
+                                        NULL, NULL, NULL);
+      g_assert (content_rating != NULL);
+
+      allowed = mct_app_filter_is_content_rating_allowed (filter, content_rating,
+                                                          &offending_section);
+      g_assert_cmpint (allowed, ==, (vectors[i].expected_offending_section == NULL));
+      g_assert_cmpstr (offending_section, ==, vectors[i].expected_offending_section);
+
+      /* Also check that the out argument is optional. */
+      allowed = mct_app_filter_is_content_rating_allowed (filter, content_rating, NULL);
+      g_assert_cmpint (allowed, ==, (vectors[i].expected_offending_section == NULL));
+    }
+}
+
 /* Fixture for tests which use an #MctAppFilterBuilder. The builder can either
  * be heap- or stack-allocated. @builder will always be a valid pointer to it.
  */
@@ -455,32 +928,603 @@ test_app_filter_builder_copy_empty (void)
   g_assert_false (mct_app_filter_is_system_installation_allowed (filter));
 }
 
-/* Check that copying a filled #MctAppFilterBuilder works, and the copy can be
- * used to build a filter. */
+/* Check that copying a filled #MctAppFilterBuilder works, and the copy can be
+ * used to build a filter. */
+static void
+test_app_filter_builder_copy_full (void)
+{
+  g_autoptr(MctAppFilterBuilder) builder = mct_app_filter_builder_new ();
+  g_autoptr(MctAppFilterBuilder) builder_copy = NULL;
+  g_autoptr(MctAppFilter) filter = NULL;
+
+  mct_app_filter_builder_blocklist_path (builder, "/bin/true");
+  mct_app_filter_builder_blocklist_content_type (builder,
+                                                 "x-scheme-handler/http");
+  mct_app_filter_builder_set_allow_user_installation (builder, FALSE);
+  mct_app_filter_builder_set_allow_system_installation (builder, TRUE);
+  builder_copy = mct_app_filter_builder_copy (builder);
+  filter = mct_app_filter_builder_end (builder_copy);
+
+  g_assert_true (mct_app_filter_is_enabled (filter));
+  g_assert_true (mct_app_filter_is_path_allowed (filter, "/bin/false"));
+  g_assert_false (mct_app_filter_is_path_allowed (filter, "/bin/true"));
+  g_assert_true (mct_app_filter_is_content_type_allowed (filter,
+                                                         "text/plain"));
+  g_assert_false (mct_app_filter_is_content_type_allowed (filter,
+                                                          "x-scheme-handler/http"));
+  g_assert_false (mct_app_filter_is_user_installation_allowed (filter));
+  g_assert_true (mct_app_filter_is_system_installation_allowed (filter));
+}
+
+/* Check that copies of an #MctAppFilterBuilder, which share their state until
+ * modified, have independent OARS values. */
+static void
+test_app_filter_builder_copy_oars (void)
+{
+  g_autoptr(MctAppFilterBuilder) builder = mct_app_filter_builder_new ();
+  g_autoptr(MctAppFilterBuilder) builder_copy = NULL;
+  g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(MctAppFilter) filter_copy = NULL;
+
+  mct_app_filter_builder_set_oars_value (builder, "drugs-alcohol", MCT_APP_FILTER_OARS_VALUE_MILD);
+  builder_copy = mct_app_filter_builder_copy (builder);
+
+  mct_app_filter_builder_set_oars_value (builder_copy, "drugs-alcohol", MCT_APP_FILTER_OARS_VALUE_INTENSE);
+  mct_app_filter_builder_set_oars_value (builder, "violence-cartoon", MCT_APP_FILTER_OARS_VALUE_NONE);
+
+  filter = mct_app_filter_builder_end (builder);
+  filter_copy = mct_app_filter_builder_end (builder_copy);
+
+  g_assert_cmpint (mct_app_filter_get_oars_value (filter, "drugs-alcohol"), ==,
+                   MCT_APP_FILTER_OARS_VALUE_MILD);
+  g_assert_cmpint (mct_app_filter_get_oars_value (filter, "violence-cartoon"), ==,
+                   MCT_APP_FILTER_OARS_VALUE_NONE);
+  g_assert_cmpint (mct_app_filter_get_oars_value (filter_copy, "drugs-alcohol"), ==,
+                   MCT_APP_FILTER_OARS_VALUE_INTENSE);
+  g_assert_cmpint (mct_app_filter_get_oars_value (filter_copy, "violence-cartoon"), ==,
+                   MCT_APP_FILTER_OARS_VALUE_UNKNOWN);
+}
+
+/* Check that mct_app_filter_builder_new_from_filter() creates a builder with
+ * the same policy as the filter, which can be modified without affecting the
+ * filter or other builders created from it. */
+static void
+test_app_filter_builder_new_from_filter (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(MctAppFilter) unchanged_filter = NULL;
+  g_autoptr(MctAppFilter) changed_filter = NULL;
+  g_autoptr(MctAppFilter) copy_filter = NULL;
+  g_autoptr(MctAppFilter) allowlist_filter = NULL;
+  g_autoptr(MctAppFilterBuilder) new_builder = NULL;
+  g_autoptr(MctAppFilterBuilder) new_builder_copy = NULL;
+  g_autoptr(GVariant) serialized = NULL;
+  g_autoptr(GVariant) unchanged_serialized = NULL;
+
+  mct_app_filter_builder_blocklist_path (&builder, "/bin/true");
+  mct_app_filter_builder_blocklist_flatpak_ref (&builder, "app/org.gnome.Builder/x86_64/stable");
+  mct_app_filter_builder_blocklist_content_type_prefix (&builder, "x-scheme-handler/");
+  mct_app_filter_builder_set_oars_value (&builder, "drugs-alcohol", MCT_APP_FILTER_OARS_VALUE_MILD);
+  mct_app_filter_builder_set_allow_user_installation (&builder, FALSE);
+  mct_app_filter_builder_set_allow_system_installation (&builder, TRUE);
+  filter = mct_app_filter_builder_end (&builder);
+
+  /* An unmodified builder gives the same filter, including the order of its
+   * app list. */
+  new_builder = mct_app_filter_builder_new_from_filter (filter);
+  unchanged_filter = mct_app_filter_builder_end (new_builder);
+
+  g_assert_true (mct_app_filter_equal (filter, unchanged_filter));
+  serialized = g_variant_ref_sink (mct_app_filter_serialize (filter));
+  unchanged_serialized = g_variant_ref_sink (mct_app_filter_serialize (unchanged_filter));
+  g_assert_cmpvariant (serialized, unchanged_serialized);
+  g_clear_pointer (&new_builder, mct_app_filter_builder_free);
+
+  /* Modify a builder and a copy of it differently. */
+  new_builder = mct_app_filter_builder_new_from_filter (filter);
+  new_builder_copy = mct_app_filter_builder_copy (new_builder);
+
+  mct_app_filter_builder_blocklist_path (new_builder, "/bin/true");
+  mct_app_filter_builder_blocklist_path (new_builder, "/bin/false");
+  mct_app_filter_builder_set_oars_value (new_builder, "drugs-alcohol", MCT_APP_FILTER_OARS_VALUE_NONE);
+  changed_filter = mct_app_filter_builder_end (new_builder);
+
+  mct_app_filter_builder_blocklist_content_type (new_builder_copy, "text/html");
+  copy_filter = mct_app_filter_builder_end (new_builder_copy);
+
+  /* The original filter is unchanged. */
+  g_assert_true (mct_app_filter_is_path_allowed (filter, "/bin/false"));
+  g_assert_true (mct_app_filter_is_content_type_allowed (filter, "text/html"));
+  g_assert_cmpint (mct_app_filter_get_oars_value (filter, "drugs-alcohol"), ==,
+                   MCT_APP_FILTER_OARS_VALUE_MILD);
+
+  g_assert_cmpint (mct_app_filter_diff (filter, changed_filter, NULL, NULL, NULL), ==,
+                   MCT_APP_FILTER_DIFF_FLAGS_APP_LIST | MCT_APP_FILTER_DIFF_FLAGS_OARS);
+  g_assert_false (mct_app_filter_is_path_allowed (changed_filter, "/bin/false"));
+  g_assert_false (mct_app_filter_is_path_allowed (changed_filter, "/bin/true"));
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (changed_filter, "org.gnome.Builder"));
+  g_assert_false (mct_app_filter_is_content_type_allowed (changed_filter, "x-scheme-handler/http"));
+  g_assert_true (mct_app_filter_is_content_type_allowed (changed_filter, "text/html"));
+  g_assert_false (mct_app_filter_is_user_installation_allowed (changed_filter));
+  g_assert_true (mct_app_filter_is_system_installation_allowed (changed_filter));
+
+  g_assert_cmpint (mct_app_filter_diff (filter, copy_filter, NULL, NULL, NULL), ==,
+                   MCT_APP_FILTER_DIFF_FLAGS_APP_LIST);
+  g_assert_true (mct_app_filter_is_path_allowed (copy_filter, "/bin/false"));
+  g_assert_false (mct_app_filter_is_content_type_allowed (copy_filter, "text/html"));
+
+  /* The list type is kept too. */
+  mct_app_filter_builder_init (&builder);
+  mct_app_filter_builder_allowlist_path (&builder, "/bin/true");
+  allowlist_filter = mct_app_filter_builder_end (&builder);
+  g_clear_pointer (&new_builder, mct_app_filter_builder_free);
+  g_clear_pointer (&changed_filter, mct_app_filter_unref);
+
+  new_builder = mct_app_filter_builder_new_from_filter (allowlist_filter);
+  mct_app_filter_builder_allowlist_path (new_builder, "/bin/false");
+  changed_filter = mct_app_filter_builder_end (new_builder);
+
+  g_assert_true (mct_app_filter_is_path_allowed (changed_filter, "/bin/true"));
+  g_assert_true (mct_app_filter_is_path_allowed (changed_filter, "/bin/false"));
+  g_assert_false (mct_app_filter_is_path_allowed (changed_filter, "/bin/sh"));
+}
+
+/* Check that entries can be removed from an #MctAppFilterBuilder, including
+ * one created from an existing filter and copies of it, keeping the order of
+ * the other entries, and that the builders stay valid after the filter they
+ * were created from is freed. */
+static void
+test_app_filter_builder_remove (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(MctAppFilter) changed_filter = NULL;
+  g_autoptr(MctAppFilter) copy_filter = NULL;
+  g_autoptr(MctAppFilter) stack_filter = NULL;
+  g_autoptr(MctAppFilterBuilder) new_builder = NULL;
+  g_autoptr(MctAppFilterBuilder) new_builder_copy = NULL;
+  g_autoptr(GVariant) serialized = NULL;
+  g_autoptr(GError) local_error = NULL;
+  g_autofree const gchar **app_list = NULL;
+  gboolean is_allowlist;
+  const gchar *expected_app_list[] =
+    {
+      "/bin/true",
+      "x-scheme-handler/http",
+      "app/org.gnome.Calculator/x86_64/stable",
+      NULL
+    };
+  const gchar *expected_stack_app_list[] =
+    {
+      "/bin/false",
+      NULL
+    };
+
+  /* Deserialise the filter, so its app list is borrowed from the variant. */
+  serialized = g_variant_ref_sink (g_variant_new_parsed (
+    "{ 'AppFilter': <(false, ['/bin/true', 'app/org.gnome.Builder/x86_64/stable', "
+    "'x-scheme-handler/http', 'app/org.example.*', '/bin/sh', 'image/*'])> }"));
+  filter = mct_app_filter_deserialize (serialized, 1, &local_error);
+  g_assert_no_error (local_error);
+  g_clear_pointer (&serialized, g_variant_unref);
+
+  new_builder = mct_app_filter_builder_new_from_filter (filter);
+  new_builder_copy = mct_app_filter_builder_copy (new_builder);
+  g_clear_pointer (&filter, mct_app_filter_unref);
+
+  /* Toggle some entries off. Removing entries which aren’t there does
+   * nothing. */
+  mct_app_filter_builder_remove_flatpak_ref (new_builder, "app/org.gnome.Builder/x86_64/stable");
+  mct_app_filter_builder_remove_path (new_builder, "/bin/../bin/sh");
+  mct_app_filter_builder_remove_flatpak_ref_prefix (new_builder, "app/org.example.");
+  mct_app_filter_builder_remove_content_type_prefix (new_builder, "image/");
+  mct_app_filter_builder_remove_content_type (new_builder, "text/plain");
+  mct_app_filter_builder_remove_path (new_builder, "/bin/false");
+  mct_app_filter_builder_blocklist_flatpak_ref (new_builder, "app/org.gnome.Calculator/x86_64/stable");
+
+  /* Remove everything from the copy, and turn it into an allowlist. */
+  mct_app_filter_builder_remove_path (new_builder_copy, "/bin/true");
+  mct_app_filter_builder_remove_flatpak_ref (new_builder_copy, "app/org.gnome.Builder/x86_64/stable");
+  mct_app_filter_builder_remove_content_type (new_builder_copy, "x-scheme-handler/http");
+  mct_app_filter_builder_remove_flatpak_ref_prefix (new_builder_copy, "app/org.example.");
+  mct_app_filter_builder_remove_path (new_builder_copy, "/bin/sh");
+  mct_app_filter_builder_remove_content_type_prefix (new_builder_copy, "image/");
+  mct_app_filter_builder_allowlist_path (new_builder_copy, "/bin/false");
+
+  changed_filter = mct_app_filter_builder_end (new_builder);
+  copy_filter = mct_app_filter_builder_end (new_builder_copy);
+
+  serialized = g_variant_ref_sink (mct_app_filter_serialize (changed_filter));
+  g_assert_true (g_variant_lookup (serialized, "AppFilter", "(b^a&s)",
+                                   &is_allowlist, &app_list));
+  g_assert_false (is_allowlist);
+  assert_strv_equal (app_list, expected_app_list);
+  g_clear_pointer (&serialized, g_variant_unref);
+  g_clear_pointer (&app_list, g_free);
+
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (changed_filter, "org.gnome.Builder"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (changed_filter, "org.example.Game"));
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (changed_filter, "org.gnome.Calculator"));
+  g_assert_true (mct_app_filter_is_path_allowed (changed_filter, "/bin/sh"));
+  g_assert_false (mct_app_filter_is_path_allowed (changed_filter, "/bin/true"));
+  g_assert_true (mct_app_filter_is_content_type_allowed (changed_filter, "image/png"));
+
+  g_assert_true (mct_app_filter_is_path_allowed (copy_filter, "/bin/false"));
+  g_assert_false (mct_app_filter_is_path_allowed (copy_filter, "/bin/true"));
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (copy_filter, "org.gnome.Builder"));
+
+  /* Removing works on stack-allocated builders too. */
+  mct_app_filter_builder_blocklist_path (&builder, "/bin/true");
+  mct_app_filter_builder_blocklist_path (&builder, "/bin/false");
+  mct_app_filter_builder_remove_path (&builder, "/bin/true");
+  stack_filter = mct_app_filter_builder_end (&builder);
+
+  serialized = g_variant_ref_sink (mct_app_filter_serialize (stack_filter));
+  g_assert_true (g_variant_lookup (serialized, "AppFilter", "(b^a&s)",
+                                   &is_allowlist, &app_list));
+  assert_strv_equal (app_list, expected_stack_app_list);
+}
+
+/* Check that entries added to an #MctAppFilterBuilder more than once only
+ * appear once in the filter, in the order they were first added, and that
+ * copies of a builder are independent. */
+static void
+test_app_filter_builder_duplicates (void)
+{
+  g_autoptr(MctAppFilterBuilder) builder = mct_app_filter_builder_new ();
+  g_autoptr(MctAppFilterBuilder) builder_copy = NULL;
+  g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(MctAppFilter) filter_copy = NULL;
+  g_autoptr(GVariant) serialized = NULL;
+  g_autoptr(GVariant) serialized_copy = NULL;
+  g_autofree const gchar **app_list = NULL;
+  g_autofree const gchar **app_list_copy = NULL;
+  gboolean is_allowlist;
+  const gchar *expected_app_list[] =
+    {
+      "/bin/true",
+      "x-scheme-handler/http",
+      "app/org.gnome.Builder/x86_64/stable",
+      NULL
+    };
+  const gchar *expected_app_list_copy[] =
+    {
+      "/bin/true",
+      "x-scheme-handler/http",
+      "/bin/false",
+      NULL
+    };
+
+  mct_app_filter_builder_blocklist_path (builder, "/bin/true");
+  mct_app_filter_builder_blocklist_content_type (builder, "x-scheme-handler/http");
+  mct_app_filter_builder_blocklist_path (builder, "/bin/../bin/true");
+
+  builder_copy = mct_app_filter_builder_copy (builder);
+  mct_app_filter_builder_blocklist_path (builder_copy, "/bin/true");
+  mct_app_filter_builder_blocklist_path (builder_copy, "/bin/false");
+
+  mct_app_filter_builder_blocklist_flatpak_ref (builder, "app/org.gnome.Builder/x86_64/stable");
+  mct_app_filter_builder_blocklist_content_type (builder, "x-scheme-handler/http");
+  mct_app_filter_builder_blocklist_flatpak_ref (builder, "app/org.gnome.Builder/x86_64/stable");
+
+  filter = mct_app_filter_builder_end (builder);
+  filter_copy = mct_app_filter_builder_end (builder_copy);
+
+  serialized = g_variant_ref_sink (mct_app_filter_serialize (filter));
+  g_assert_true (g_variant_lookup (serialized, "AppFilter", "(b^a&s)",
+                                   &is_allowlist, &app_list));
+  assert_strv_equal (app_list, expected_app_list);
+
+  serialized_copy = g_variant_ref_sink (mct_app_filter_serialize (filter_copy));
+  g_assert_true (g_variant_lookup (serialized_copy, "AppFilter", "(b^a&s)",
+                                   &is_allowlist, &app_list_copy));
+  assert_strv_equal (app_list_copy, expected_app_list_copy);
+}
+
+/* Check that an #MctAppFilterBuilder can build allowlists, including empty
+ * ones, and that the bulk methods add all their entries. */
+static void
+test_app_filter_builder_allowlist (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(MctAppFilter) empty_filter = NULL;
+  g_autoptr(MctAppFilter) blocklist_filter = NULL;
+  g_autoptr(GVariant) serialized = NULL;
+  gboolean is_allowlist;
+  const gchar *allowed_refs[] =
+    {
+      "app/org.gnome.Calculator/x86_64/stable",
+      "app/org.gnome.Calendar/x86_64/stable",
+      "app/org.gnome.Calculator/x86_64/stable",
+      NULL
+    };
+  const gchar *no_refs[] = { NULL };
+
+  mct_app_filter_builder_allowlist_flatpak_refs (&builder, allowed_refs);
+  mct_app_filter_builder_allowlist_path (&builder, "/usr/bin/gnome-calculator");
+  mct_app_filter_builder_allowlist_content_type (&builder, "text/plain");
+  mct_app_filter_builder_allowlist_flatpak_ref_prefix (&builder, "app/org.example.");
+  filter = mct_app_filter_builder_end (&builder);
+
+  g_assert_true (mct_app_filter_is_enabled (filter));
+  g_assert_true (mct_app_filter_is_flatpak_ref_allowed (filter, "app/org.gnome.Calculator/x86_64/stable"));
+  g_assert_true (mct_app_filter_is_flatpak_ref_allowed (filter, "app/org.gnome.Calendar/x86_64/stable"));
+  g_assert_false (mct_app_filter_is_flatpak_ref_allowed (filter, "app/org.gnome.Builder/x86_64/stable"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (filter, "org.gnome.Calculator"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (filter, "org.example.Game"));
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (filter, "org.gnome.Builder"));
+  g_assert_true (mct_app_filter_is_path_allowed (filter, "/usr/bin/gnome-calculator"));
+  g_assert_false (mct_app_filter_is_path_allowed (filter, "/bin/true"));
+  g_assert_true (mct_app_filter_is_content_type_allowed (filter, "text/plain"));
+  g_assert_false (mct_app_filter_is_content_type_allowed (filter, "text/html"));
+
+  serialized = g_variant_ref_sink (mct_app_filter_serialize (filter));
+  g_assert_true (g_variant_lookup (serialized, "AppFilter", "(bas)", &is_allowlist, NULL));
+  g_assert_true (is_allowlist);
+
+  /* An empty allowlist allows nothing. */
+  mct_app_filter_builder_init (&builder);
+  mct_app_filter_builder_allowlist_flatpak_refs (&builder, no_refs);
+  empty_filter = mct_app_filter_builder_end (&builder);
+
+  g_assert_true (mct_app_filter_is_enabled (empty_filter));
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (empty_filter, "org.gnome.Calculator"));
+  g_assert_false (mct_app_filter_is_path_allowed (empty_filter, "/bin/true"));
+
+  /* The bulk blocklist method works too. */
+  mct_app_filter_builder_init (&builder);
+  mct_app_filter_builder_blocklist_flatpak_refs (&builder, allowed_refs);
+  blocklist_filter = mct_app_filter_builder_end (&builder);
+
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (blocklist_filter, "org.gnome.Calculator"));
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (blocklist_filter, "org.gnome.Calendar"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (blocklist_filter, "org.gnome.Builder"));
+  g_assert_true (mct_app_filter_is_path_allowed (blocklist_filter, "/bin/true"));
+}
+
+/* Check that the builder methods for exact flatpak refs and content types
+ * reject entries containing `*`, which would otherwise be stored as prefix
+ * patterns, without adding anything. */
+static void
+test_app_filter_builder_wildcards (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) filter = NULL;
+  const gchar *app_refs[] =
+    {
+      "app/org.gnome.Calculator/x86_64/stable",
+      "app/org.example.Foo/x86_64/*",
+      NULL
+    };
+
+  g_test_expect_message (NULL, G_LOG_LEVEL_CRITICAL,
+                         "*assertion*strchr (app_ref, '*') == NULL*failed*");
+  mct_app_filter_builder_blocklist_flatpak_ref (&builder, "app/org.example.Foo/x86_64/*");
+  g_test_assert_expected_messages ();
+
+  g_test_expect_message (NULL, G_LOG_LEVEL_CRITICAL,
+                         "*assertion*strchr (app_ref, '*') == NULL*failed*");
+  mct_app_filter_builder_allowlist_flatpak_ref (&builder, "app/org.example.Foo/x86_64/*");
+  g_test_assert_expected_messages ();
+
+  g_test_expect_message (NULL, G_LOG_LEVEL_CRITICAL,
+                         "*assertion*strchr (app_refs[i], '*') == NULL*failed*");
+  mct_app_filter_builder_blocklist_flatpak_refs (&builder, app_refs);
+  g_test_assert_expected_messages ();
+
+  g_test_expect_message (NULL, G_LOG_LEVEL_CRITICAL,
+                         "*assertion*strchr (content_type, '*') == NULL*failed*");
+  mct_app_filter_builder_blocklist_content_type (&builder, "text/*");
+  g_test_assert_expected_messages ();
+
+  g_test_expect_message (NULL, G_LOG_LEVEL_CRITICAL,
+                         "*assertion*strchr (content_type, '*') == NULL*failed*");
+  mct_app_filter_builder_allowlist_content_type (&builder, "text/*");
+  g_test_assert_expected_messages ();
+
+  /* Nothing should have been added. */
+  filter = mct_app_filter_builder_end (&builder);
+
+  g_assert_false (mct_app_filter_is_enabled (filter));
+  g_assert_true (mct_app_filter_is_flatpak_ref_allowed (filter, "app/org.gnome.Calculator/x86_64/stable"));
+  g_assert_true (mct_app_filter_is_flatpak_ref_allowed (filter, "app/org.example.Foo/x86_64/stable"));
+  g_assert_true (mct_app_filter_is_content_type_allowed (filter, "text/plain"));
+}
+
+/* Check that mct_app_filter_is_path_allowed() canonicalises paths before
+ * matching them, whether or not they are already canonical, and that
+ * mct_app_filter_is_canonical_path_allowed() matches canonical paths. */
+static void
+test_app_filter_paths (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) filter = NULL;
+  const gchar *blocked_paths[] =
+    {
+      "/usr/bin/gnome-software",
+      "/usr/bin/../bin/gnome-software",
+      "/usr/bin/./gnome-software",
+      "/usr///bin/gnome-software",
+      "/usr/bin/gnome-software/",
+      "/usr/bin/gnome-software/.",
+      "/opt/extra",
+    };
+  const gchar *allowed_paths[] =
+    {
+      "/",
+      "/usr/bin/gnome-softwar",
+      "/usr/bin/gnome-software-extra",
+      "/usr/bin/gnome-software/..",
+      "/usr/gnome-software",
+      "/opt",
+    };
+
+  mct_app_filter_builder_blocklist_path (&builder, "/usr/bin/gnome-software");
+  mct_app_filter_builder_blocklist_path (&builder, "/opt/./extra/");
+
+  filter = mct_app_filter_builder_end (&builder);
+
+  for (gsize i = 0; i < G_N_ELEMENTS (blocked_paths); i++)
+    {
+      g_test_message ("Blocked path %" G_GSIZE_FORMAT ": %s", i, blocked_paths[i]);
+      g_assert_false (mct_app_filter_is_path_allowed (filter, blocked_paths[i]));
+    }
+
+  for (gsize i = 0; i < G_N_ELEMENTS (allowed_paths); i++)
+    {
+      g_test_message ("Allowed path %" G_GSIZE_FORMAT ": %s", i, allowed_paths[i]);
+      g_assert_true (mct_app_filter_is_path_allowed (filter, allowed_paths[i]));
+    }
+
+  g_assert_false (mct_app_filter_is_canonical_path_allowed (filter, "/usr/bin/gnome-software"));
+  g_assert_false (mct_app_filter_is_canonical_path_allowed (filter, "/opt/extra"));
+  g_assert_true (mct_app_filter_is_canonical_path_allowed (filter, "/usr/bin/true"));
+}
+
+/* Check that mct_app_filter_is_flatpak_app_allowed() only matches the app IDs
+ * of `app/` refs in the app list, and doesn’t match on prefixes of them. */
+static void
+test_app_filter_flatpak_app_ids (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) filter = NULL;
+
+  mct_app_filter_builder_blocklist_flatpak_ref (&builder, "app/org.gnome.Nasty/x86_64/stable");
+  mct_app_filter_builder_blocklist_flatpak_ref (&builder, "app/org.gnome.Nasty/aarch64/master");
+  mct_app_filter_builder_blocklist_flatpak_ref (&builder, "runtime/org.gnome.Platform/x86_64/3.38");
+  mct_app_filter_builder_blocklist_content_type (&builder, "app/org.gnome.Other");
+
+  filter = mct_app_filter_builder_end (&builder);
+
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (filter, "org.gnome.Nasty"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (filter, "org.gnome.Nast"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (filter, "org.gnome.Nasty.Devel"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (filter, "org.gnome.Platform"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (filter, "org.gnome.Other"));
+
+  g_assert_false (mct_app_filter_is_flatpak_ref_allowed (filter, "app/org.gnome.Nasty/aarch64/master"));
+  g_assert_true (mct_app_filter_is_flatpak_ref_allowed (filter, "app/org.gnome.Nasty/aarch64/stable"));
+  g_assert_false (mct_app_filter_is_flatpak_ref_allowed (filter, "runtime/org.gnome.Platform/x86_64/3.38"));
+}
+
+/* Test that prefix patterns in the app list match flatpak refs, app IDs and
+ * content types which start with them, and nothing else. */
+static void
+test_app_filter_prefixes (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(MctAppFilter) roundtrip_filter = NULL;
+  g_autoptr(MctAppFilter) allowlist_filter = NULL;
+  g_autoptr(GVariant) serialized = NULL;
+  g_autoptr(GError) local_error = NULL;
+
+  mct_app_filter_builder_blocklist_flatpak_ref_prefix (&builder, "app/com.example.");
+  mct_app_filter_builder_blocklist_flatpak_ref_prefix (&builder, "app/com.example.Sub");  /* covered by the above */
+  mct_app_filter_builder_blocklist_flatpak_ref_prefix (&builder, "app/org.gnome.Builder/x86_64/");
+  mct_app_filter_builder_blocklist_flatpak_ref_prefix (&builder, "runtime/org.kde.");
+  mct_app_filter_builder_blocklist_content_type_prefix (&builder, "x-scheme-handler/");
+  mct_app_filter_builder_blocklist_content_type_prefix (&builder, "image/x-");
+
+  filter = mct_app_filter_builder_end (&builder);
+
+  g_assert_true (mct_app_filter_is_enabled (filter));
+
+  g_assert_false (mct_app_filter_is_flatpak_ref_allowed (filter, "app/com.example.App/x86_64/stable"));
+  g_assert_false (mct_app_filter_is_flatpak_ref_allowed (filter, "app/com.example.Sub.App/aarch64/master"));
+  g_assert_true (mct_app_filter_is_flatpak_ref_allowed (filter, "app/com.exampleApp/x86_64/stable"));
+  g_assert_true (mct_app_filter_is_flatpak_ref_allowed (filter, "runtime/com.example.Platform/x86_64/1"));
+  g_assert_false (mct_app_filter_is_flatpak_ref_allowed (filter, "app/org.gnome.Builder/x86_64/stable"));
+  g_assert_true (mct_app_filter_is_flatpak_ref_allowed (filter, "app/org.gnome.Builder/aarch64/stable"));
+  g_assert_false (mct_app_filter_is_flatpak_ref_allowed (filter, "runtime/org.kde.Platform/x86_64/5.15"));
+  g_assert_true (mct_app_filter_is_flatpak_ref_allowed (filter, "app/org.kde.Okular/x86_64/stable"));
+
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (filter, "com.example.App"));
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (filter, "com.example.Sub.App"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (filter, "com.exampleApp"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (filter, "com.example"));
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (filter, "org.gnome.Builder"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (filter, "org.gnome.Builder.Devel"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (filter, "org.kde.Okular"));
+
+  g_assert_false (mct_app_filter_is_content_type_allowed (filter, "x-scheme-handler/http"));
+  g_assert_false (mct_app_filter_is_content_type_allowed (filter, "x-scheme-handler/ftp"));
+  g_assert_false (mct_app_filter_is_content_type_allowed (filter, "image/x-portable-bitmap"));
+  g_assert_true (mct_app_filter_is_content_type_allowed (filter, "image/png"));
+  g_assert_true (mct_app_filter_is_content_type_allowed (filter, "text/plain"));
+
+  /* The patterns should survive a round trip through serialisation, and
+   * should work in allowlists too. */
+  serialized = g_variant_ref_sink (mct_app_filter_serialize (filter));
+  roundtrip_filter = mct_app_filter_deserialize (serialized, 1, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (roundtrip_filter, "com.example.App"));
+  g_assert_false (mct_app_filter_is_content_type_allowed (roundtrip_filter, "x-scheme-handler/http"));
+  g_clear_pointer (&serialized, g_variant_unref);
+
+  serialized = g_variant_ref_sink (g_variant_new_parsed (
+    "{ 'AppFilter': <(true, ['app/com.example.*', 'x-scheme-handler/*', 'image/png'])> }"));
+  allowlist_filter = mct_app_filter_deserialize (serialized, 1, &local_error);
+  g_assert_no_error (local_error);
+
+  g_assert_true (mct_app_filter_is_flatpak_ref_allowed (allowlist_filter, "app/com.example.App/x86_64/stable"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (allowlist_filter, "com.example.App"));
+  g_assert_false (mct_app_filter_is_flatpak_ref_allowed (allowlist_filter, "app/org.gnome.Builder/x86_64/stable"));
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (allowlist_filter, "org.gnome.Builder"));
+  g_assert_true (mct_app_filter_is_content_type_allowed (allowlist_filter, "x-scheme-handler/http"));
+  g_assert_true (mct_app_filter_is_content_type_allowed (allowlist_filter, "image/png"));
+  g_assert_false (mct_app_filter_is_content_type_allowed (allowlist_filter, "image/jpeg"));
+}
+
+/* Test that mct_app_filter_is_content_type_hierarchy_allowed() matches
+ * subclasses of the content types in the filter, as well as the content types
+ * themselves. */
 static void
-test_app_filter_builder_copy_full (void)
+test_app_filter_content_type_hierarchy (void)
 {
-  g_autoptr(MctAppFilterBuilder) builder = mct_app_filter_builder_new ();
-  g_autoptr(MctAppFilterBuilder) builder_copy = NULL;
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
   g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(MctAppFilter) allowlist_filter = NULL;
+  GList *registered = NULL;
+  gboolean have_subclass;
 
-  mct_app_filter_builder_blocklist_path (builder, "/bin/true");
-  mct_app_filter_builder_blocklist_content_type (builder,
-                                                 "x-scheme-handler/http");
-  mct_app_filter_builder_set_allow_user_installation (builder, FALSE);
-  mct_app_filter_builder_set_allow_system_installation (builder, TRUE);
-  builder_copy = mct_app_filter_builder_copy (builder);
-  filter = mct_app_filter_builder_end (builder_copy);
+  /* This relies on the shared-mime-info database being installed. */
+  registered = g_content_types_get_registered ();
+  have_subclass = (g_list_find_custom (registered, "text/x-csrc", (GCompareFunc) g_strcmp0) != NULL &&
+                   g_content_type_is_a ("text/x-csrc", "text/plain"));
+  g_list_free_full (registered, g_free);
 
-  g_assert_true (mct_app_filter_is_enabled (filter));
-  g_assert_true (mct_app_filter_is_path_allowed (filter, "/bin/false"));
-  g_assert_false (mct_app_filter_is_path_allowed (filter, "/bin/true"));
-  g_assert_true (mct_app_filter_is_content_type_allowed (filter,
-                                                         "text/plain"));
-  g_assert_false (mct_app_filter_is_content_type_allowed (filter,
-                                                          "x-scheme-handler/http"));
-  g_assert_false (mct_app_filter_is_user_installation_allowed (filter));
-  g_assert_true (mct_app_filter_is_system_installation_allowed (filter));
+  if (!have_subclass)
+    {
+      g_test_skip ("Content type hierarchy not available");
+      return;
+    }
+
+  mct_app_filter_builder_blocklist_content_type (&builder, "text/plain");
+  mct_app_filter_builder_blocklist_content_type_prefix (&builder, "x-scheme-handler/ht*");
+  filter = mct_app_filter_builder_end (&builder);
+
+  /* Check twice, so the second check uses the cached closure. */
+  for (guint i = 0; i < 2; i++)
+    {
+      g_assert_false (mct_app_filter_is_content_type_hierarchy_allowed (filter, "text/plain"));
+      g_assert_false (mct_app_filter_is_content_type_hierarchy_allowed (filter, "text/x-csrc"));
+      g_assert_true (mct_app_filter_is_content_type_hierarchy_allowed (filter, "image/png"));
+      g_assert_false (mct_app_filter_is_content_type_hierarchy_allowed (filter, "x-scheme-handler/http"));
+      g_assert_true (mct_app_filter_is_content_type_hierarchy_allowed (filter, "x-scheme-handler/ftp"));
+    }
+
+  /* The non-hierarchical check is unaffected. */
+  g_assert_true (mct_app_filter_is_content_type_allowed (filter, "text/x-csrc"));
+
+  mct_app_filter_builder_init (&builder);
+  mct_app_filter_builder_allowlist_content_type (&builder, "text/plain");
+  allowlist_filter = mct_app_filter_builder_end (&builder);
+
+  g_assert_true (mct_app_filter_is_content_type_hierarchy_allowed (allowlist_filter, "text/x-csrc"));
+  g_assert_false (mct_app_filter_is_content_type_hierarchy_allowed (allowlist_filter, "image/png"));
 }
 
 /* Check that various configurations of a #GAppInfo are accepted or rejected
@@ -490,6 +1534,9 @@ test_app_filter_appinfo (void)
 {
   g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
   g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(MctAppFilter) content_type_filter = NULL;
+  g_autoptr(GPtrArray) appinfos = g_ptr_array_new_with_free_func (g_object_unref);
+  g_autofree gboolean *allowed = NULL;
   const struct
     {
       gboolean expected_allowed;
@@ -631,7 +1678,568 @@ test_app_filter_appinfo (void)
         g_assert_true (mct_app_filter_is_appinfo_allowed (filter, appinfo));
       else
         g_assert_false (mct_app_filter_is_appinfo_allowed (filter, appinfo));
+
+      g_ptr_array_add (appinfos, g_steal_pointer (&appinfo));
+    }
+
+  /* Check all the vectors again in one batch. */
+  allowed = mct_app_filter_check_app_infos (filter,
+                                            (GAppInfo * const *) appinfos->pdata,
+                                            appinfos->len);
+  g_assert_nonnull (allowed);
+
+  for (gsize i = 0; i < G_N_ELEMENTS (vectors); i++)
+    {
+      g_test_message ("Batch vector %" G_GSIZE_FORMAT, i);
+      g_assert_cmpint (allowed[i], ==, vectors[i].expected_allowed);
+    }
+
+  /* And against a blocklist which only has content types in it, so the
+   * executable and flatpak ID checks are skipped. */
+  mct_app_filter_builder_init (&builder);
+  mct_app_filter_builder_blocklist_content_type (&builder, "x-scheme-handler/http");
+  content_type_filter = mct_app_filter_builder_end (&builder);
+
+  g_clear_pointer (&allowed, g_free);
+  allowed = mct_app_filter_check_app_infos (content_type_filter,
+                                            (GAppInfo * const *) appinfos->pdata,
+                                            appinfos->len);
+  g_assert_nonnull (allowed);
+
+  for (gsize i = 0; i < G_N_ELEMENTS (vectors); i++)
+    {
+      gboolean expected_allowed = (strstr (vectors[i].key_file_data, "MimeType=x-scheme-handler/http") == NULL);
+
+      g_test_message ("Content type vector %" G_GSIZE_FORMAT, i);
+      g_assert_cmpint (allowed[i], ==, expected_allowed);
+      g_assert_cmpint (mct_app_filter_is_appinfo_allowed (content_type_filter, appinfos->pdata[i]), ==,
+                       expected_allowed);
+    }
+}
+
+/* Benchmark the mct_app_filter_is_*_allowed() queries, including the cost of
+ * their precondition checks. This is only run in perf mode (`-m perf`). */
+static void
+test_app_filter_perf_queries (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(GTimer) timer = NULL;
+  const guint n_iterations = 1000000;
+  gdouble elapsed_secs;
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Performance tests not enabled");
+      return;
+    }
+
+  mct_app_filter_builder_blocklist_path (&builder, "/bin/false");
+  mct_app_filter_builder_blocklist_flatpak_ref (&builder, "app/org.gnome.Nasty/x86_64/stable");
+  mct_app_filter_builder_blocklist_content_type (&builder, "x-scheme-handler/http");
+  filter = mct_app_filter_builder_end (&builder);
+
+  timer = g_timer_new ();
+
+  for (guint i = 0; i < n_iterations; i++)
+    g_assert_true (mct_app_filter_is_flatpak_ref_allowed (filter, "app/org.gnome.Nice/x86_64/stable"));
+
+  elapsed_secs = g_timer_elapsed (timer, NULL);
+  g_test_minimized_result (elapsed_secs * 1e9 / n_iterations,
+                           "mct_app_filter_is_flatpak_ref_allowed(): %.1f ns per call",
+                           elapsed_secs * 1e9 / n_iterations);
+
+  g_timer_start (timer);
+
+  for (guint i = 0; i < n_iterations; i++)
+    g_assert_true (mct_app_filter_is_flatpak_app_allowed (filter, "org.gnome.Nice"));
+
+  elapsed_secs = g_timer_elapsed (timer, NULL);
+  g_test_minimized_result (elapsed_secs * 1e9 / n_iterations,
+                           "mct_app_filter_is_flatpak_app_allowed(): %.1f ns per call",
+                           elapsed_secs * 1e9 / n_iterations);
+
+  g_timer_start (timer);
+
+  for (guint i = 0; i < n_iterations; i++)
+    g_assert_true (mct_app_filter_is_content_type_allowed (filter, "text/plain"));
+
+  elapsed_secs = g_timer_elapsed (timer, NULL);
+  g_test_minimized_result (elapsed_secs * 1e9 / n_iterations,
+                           "mct_app_filter_is_content_type_allowed(): %.1f ns per call",
+                           elapsed_secs * 1e9 / n_iterations);
+}
+
+/* Time checking all of @appinfos against @filter, first one at a time using
+ * mct_app_filter_is_appinfo_allowed(), and then in a batch using
+ * mct_app_filter_check_app_infos(). */
+static void
+perf_check_app_infos (MctAppFilter *filter,
+                      GPtrArray    *appinfos,
+                      const gchar  *description)
+{
+  g_autoptr(GTimer) timer = NULL;
+  const guint n_iterations = 100;
+  gdouble elapsed_secs;
+  gsize n_allowed_single = 0, n_allowed_batch = 0;
+
+  timer = g_timer_new ();
+
+  for (guint i = 0; i < n_iterations; i++)
+    for (gsize j = 0; j < appinfos->len; j++)
+      n_allowed_single += mct_app_filter_is_appinfo_allowed (filter, appinfos->pdata[j]);
+
+  elapsed_secs = g_timer_elapsed (timer, NULL);
+  g_test_minimized_result (elapsed_secs * 1e9 / (n_iterations * appinfos->len),
+                           "mct_app_filter_is_appinfo_allowed() (%s): %.1f ns per app",
+                           description, elapsed_secs * 1e9 / (n_iterations * appinfos->len));
+
+  g_timer_start (timer);
+
+  for (guint i = 0; i < n_iterations; i++)
+    {
+      g_autofree gboolean *allowed = NULL;
+
+      allowed = mct_app_filter_check_app_infos (filter,
+                                                (GAppInfo * const *) appinfos->pdata,
+                                                appinfos->len);
+      for (gsize j = 0; j < appinfos->len; j++)
+        n_allowed_batch += allowed[j];
+    }
+
+  elapsed_secs = g_timer_elapsed (timer, NULL);
+  g_test_minimized_result (elapsed_secs * 1e9 / (n_iterations * appinfos->len),
+                           "mct_app_filter_check_app_infos() (%s): %.1f ns per app",
+                           description, elapsed_secs * 1e9 / (n_iterations * appinfos->len));
+
+  g_assert_cmpuint (n_allowed_batch, ==, n_allowed_single);
+}
+
+/* Benchmark mct_app_filter_check_app_infos() against calling
+ * mct_app_filter_is_appinfo_allowed() on each app, for a set of apps which
+ * share executables and content types, as installed apps do. This is only run
+ * in perf mode (`-m perf`). */
+static void
+test_app_filter_perf_check_app_infos (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(MctAppFilter) content_type_filter = NULL;
+  g_autoptr(GPtrArray) appinfos = g_ptr_array_new_with_free_func (g_object_unref);
+  const gsize n_apps = 1000;
+  const gchar *executables[] = { "flatpak", "true", "false", "sh" };
+  const gchar *mime_types[] = { "text/plain;", "image/png;image/jpeg;", "x-scheme-handler/https;text/html;", "" };
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Performance tests not enabled");
+      return;
+    }
+
+  for (gsize i = 0; i < n_apps; i++)
+    {
+      g_autoptr(GKeyFile) key_file = NULL;
+      g_autofree gchar *key_file_data = NULL;
+      g_autoptr(GError) local_error = NULL;
+      GAppInfo *appinfo;
+
+      key_file_data = g_strdup_printf ("[Desktop Entry]\n"
+                                       "Name=App %" G_GSIZE_FORMAT "\n"
+                                       "Exec=%s\n"
+                                       "Type=Application\n"
+                                       "MimeType=%s\n"
+                                       "X-Flatpak=org.example.App%" G_GSIZE_FORMAT "\n",
+                                       i,
+                                       executables[i % G_N_ELEMENTS (executables)],
+                                       mime_types[i % G_N_ELEMENTS (mime_types)],
+                                       i);
+
+      key_file = g_key_file_new ();
+      g_key_file_load_from_data (key_file, key_file_data, -1, G_KEY_FILE_NONE, &local_error);
+      g_assert_no_error (local_error);
+
+      appinfo = G_APP_INFO (g_desktop_app_info_new_from_keyfile (key_file));
+      g_assert_nonnull (appinfo);
+      g_ptr_array_add (appinfos, appinfo);
+    }
+
+  mct_app_filter_builder_blocklist_path (&builder, "/bin/false");
+  mct_app_filter_builder_blocklist_flatpak_ref (&builder, "app/org.example.App1/x86_64/stable");
+  mct_app_filter_builder_blocklist_content_type (&builder, "x-scheme-handler/http");
+  filter = mct_app_filter_builder_end (&builder);
+
+  perf_check_app_infos (filter, appinfos, "full blocklist");
+
+  mct_app_filter_builder_init (&builder);
+  mct_app_filter_builder_blocklist_content_type (&builder, "x-scheme-handler/http");
+  content_type_filter = mct_app_filter_builder_end (&builder);
+
+  perf_check_app_infos (content_type_filter, appinfos, "content type blocklist");
+}
+
+/* Build an app filter with @n_entries entries in its blocklist, split evenly
+ * between flatpak refs, paths and content types. The entries are also returned
+ * as a strv in @app_list_out so they can be scanned linearly for comparison.
+ * The filter is deserialised rather than built, so building very large filters
+ * doesn’t dominate the test runtime. */
+static MctAppFilter *
+build_large_filter (gsize    n_entries,
+                    gchar ***app_list_out)
+{
+  g_autoptr(GPtrArray) app_list = g_ptr_array_new_with_free_func (g_free);
+  GVariantDict dict;
+  g_autoptr(GVariant) serialized = NULL;
+  g_autoptr(GError) local_error = NULL;
+  MctAppFilter *filter;
+
+  for (gsize i = 0; i < n_entries; i++)
+    {
+      switch (i % 3)
+        {
+        case 0:
+          g_ptr_array_add (app_list, g_strdup_printf ("app/org.example.App%" G_GSIZE_FORMAT "/x86_64/stable", i));
+          break;
+        case 1:
+          g_ptr_array_add (app_list, g_strdup_printf ("/usr/bin/program%" G_GSIZE_FORMAT, i));
+          break;
+        case 2:
+          g_ptr_array_add (app_list, g_strdup_printf ("x-scheme-handler/example%" G_GSIZE_FORMAT, i));
+          break;
+        default:
+          g_assert_not_reached ();
+        }
+    }
+  g_ptr_array_add (app_list, NULL);
+
+  g_variant_dict_init (&dict, NULL);
+  g_variant_dict_insert (&dict, "AppFilter", "(b^as)", FALSE, app_list->pdata);
+  serialized = g_variant_ref_sink (g_variant_dict_end (&dict));
+  filter = mct_app_filter_deserialize (serialized, 1000, &local_error);
+  g_assert_no_error (local_error);
+
+  *app_list_out = (gchar **) g_ptr_array_free (g_steal_pointer (&app_list), FALSE);
+
+  return filter;
+}
+
+/* Compare the performance of queries against the app filter with a linear scan
+ * of the app list, for lists of different sizes. Queries are for entries which
+ * aren’t in the list, as that’s the worst case for a linear scan. */
+static void
+test_app_filter_perf_large_lists (void)
+{
+  const gsize list_sizes[] = { 10, 1000, 100000 };
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Performance tests not enabled");
+      return;
+    }
+
+  for (gsize i = 0; i < G_N_ELEMENTS (list_sizes); i++)
+    {
+      g_autoptr(MctAppFilter) filter = NULL;
+      g_auto(GStrv) app_list = NULL;
+      g_autoptr(GTimer) timer = NULL;
+      const guint n_iterations = 1000000;
+      const guint n_linear_iterations = MAX (10, 10000000 / list_sizes[i]);
+      gdouble elapsed_secs;
+
+      filter = build_large_filter (list_sizes[i], &app_list);
+      g_assert_cmpuint (g_strv_length (app_list), ==, list_sizes[i]);
+
+      timer = g_timer_new ();
+
+      for (guint j = 0; j < n_linear_iterations; j++)
+        g_assert_false (g_strv_contains ((const gchar * const *) app_list,
+                                         "app/org.gnome.Nice/x86_64/stable"));
+
+      elapsed_secs = g_timer_elapsed (timer, NULL);
+      g_test_minimized_result (elapsed_secs * 1e9 / n_linear_iterations,
+                               "Linear scan of %" G_GSIZE_FORMAT " entries: %.1f ns per call",
+                               list_sizes[i], elapsed_secs * 1e9 / n_linear_iterations);
+
+      g_timer_start (timer);
+
+      for (guint j = 0; j < n_iterations; j++)
+        g_assert_true (mct_app_filter_is_flatpak_ref_allowed (filter, "app/org.gnome.Nice/x86_64/stable"));
+
+      elapsed_secs = g_timer_elapsed (timer, NULL);
+      g_test_minimized_result (elapsed_secs * 1e9 / n_iterations,
+                               "mct_app_filter_is_flatpak_ref_allowed() with %" G_GSIZE_FORMAT " entries: %.1f ns per call",
+                               list_sizes[i], elapsed_secs * 1e9 / n_iterations);
+
+      g_timer_start (timer);
+
+      for (guint j = 0; j < n_iterations; j++)
+        g_assert_true (mct_app_filter_is_path_allowed (filter, "/usr/bin/nice"));
+
+      elapsed_secs = g_timer_elapsed (timer, NULL);
+      g_test_minimized_result (elapsed_secs * 1e9 / n_iterations,
+                               "mct_app_filter_is_path_allowed() with %" G_GSIZE_FORMAT " entries: %.1f ns per call",
+                               list_sizes[i], elapsed_secs * 1e9 / n_iterations);
+
+      g_timer_start (timer);
+
+      for (guint j = 0; j < n_iterations; j++)
+        g_assert_true (mct_app_filter_is_content_type_allowed (filter, "x-scheme-handler/nice"));
+
+      elapsed_secs = g_timer_elapsed (timer, NULL);
+      g_test_minimized_result (elapsed_secs * 1e9 / n_iterations,
+                               "mct_app_filter_is_content_type_allowed() with %" G_GSIZE_FORMAT " entries: %.1f ns per call",
+                               list_sizes[i], elapsed_secs * 1e9 / n_iterations);
+    }
+}
+
+/* Measure the performance of queries against an app filter containing a large
+ * number of prefix patterns. */
+static void
+test_app_filter_perf_prefixes (void)
+{
+  g_autoptr(GPtrArray) app_list = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(GVariant) serialized = NULL;
+  g_autoptr(GError) local_error = NULL;
+  g_autoptr(GTimer) timer = NULL;
+  GVariantDict dict;
+  const gsize n_prefixes = 100000;
+  const guint n_iterations = 1000000;
+  gdouble elapsed_secs;
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Performance tests not enabled");
+      return;
+    }
+
+  for (gsize i = 0; i < n_prefixes; i++)
+    g_ptr_array_add (app_list, g_strdup_printf ("app/com.example%" G_GSIZE_FORMAT ".*", i));
+  g_ptr_array_add (app_list, NULL);
+
+  g_variant_dict_init (&dict, NULL);
+  g_variant_dict_insert (&dict, "AppFilter", "(b^as)", FALSE, app_list->pdata);
+  serialized = g_variant_ref_sink (g_variant_dict_end (&dict));
+
+  timer = g_timer_new ();
+
+  filter = mct_app_filter_deserialize (serialized, 1000, &local_error);
+  g_assert_no_error (local_error);
+
+  elapsed_secs = g_timer_elapsed (timer, NULL);
+  g_test_minimized_result (elapsed_secs,
+                           "Loading %" G_GSIZE_FORMAT " prefixes: %.3f s",
+                           n_prefixes, elapsed_secs);
+
+  g_timer_start (timer);
+
+  for (guint i = 0; i < n_iterations; i++)
+    g_assert_true (mct_app_filter_is_flatpak_ref_allowed (filter, "app/org.gnome.Nice/x86_64/stable"));
+
+  elapsed_secs = g_timer_elapsed (timer, NULL);
+  g_test_minimized_result (elapsed_secs * 1e9 / n_iterations,
+                           "mct_app_filter_is_flatpak_ref_allowed() (not matching): %.1f ns per call",
+                           elapsed_secs * 1e9 / n_iterations);
+
+  g_timer_start (timer);
+
+  for (guint i = 0; i < n_iterations; i++)
+    g_assert_false (mct_app_filter_is_flatpak_ref_allowed (filter, "app/com.example500.App/x86_64/stable"));
+
+  elapsed_secs = g_timer_elapsed (timer, NULL);
+  g_test_minimized_result (elapsed_secs * 1e9 / n_iterations,
+                           "mct_app_filter_is_flatpak_ref_allowed() (matching): %.1f ns per call",
+                           elapsed_secs * 1e9 / n_iterations);
+
+  g_timer_start (timer);
+
+  for (guint i = 0; i < n_iterations; i++)
+    g_assert_false (mct_app_filter_is_flatpak_app_allowed (filter, "com.example500.App"));
+
+  elapsed_secs = g_timer_elapsed (timer, NULL);
+  g_test_minimized_result (elapsed_secs * 1e9 / n_iterations,
+                           "mct_app_filter_is_flatpak_app_allowed() (matching): %.1f ns per call",
+                           elapsed_secs * 1e9 / n_iterations);
+}
+
+/* Measure how long it takes to build a large app filter, including adding
+ * every entry twice to exercise the duplicate check. */
+static void
+test_app_filter_perf_builder (void)
+{
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(GPtrArray) entries = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr(GTimer) timer = NULL;
+  const gsize n_entries = 50000;
+  gdouble elapsed_secs;
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Performance tests not enabled");
+      return;
+    }
+
+  /* Format the entries first, so only the builder is timed. */
+  for (gsize i = 0; i < n_entries; i++)
+    g_ptr_array_add (entries, g_strdup_printf ("app/org.example.App%" G_GSIZE_FORMAT "/x86_64/stable", i));
+
+  timer = g_timer_new ();
+
+  for (guint repeat = 0; repeat < 2; repeat++)
+    for (gsize i = 0; i < entries->len; i++)
+      mct_app_filter_builder_blocklist_flatpak_ref (&builder, g_ptr_array_index (entries, i));
+
+  filter = mct_app_filter_builder_end (&builder);
+
+  elapsed_secs = g_timer_elapsed (timer, NULL);
+  g_test_minimized_result (elapsed_secs,
+                           "Building a filter with %" G_GSIZE_FORMAT " entries: %.3f s",
+                           n_entries, elapsed_secs);
+
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (filter, "org.example.App0"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (filter, "org.example.Nice"));
+}
+
+/* Build the serialised app filter for synthetic user @user_index, as it
+ * would be loaded from AccountsService. Each user blocks
+ * @n_entries_per_user entries out of a shared pool of @n_pool_entries, so
+ * users’ lists overlap heavily, as they would on a shared machine. */
+static GVariant *
+build_synthetic_user_filter (guint user_index,
+                             gsize n_entries_per_user,
+                             gsize n_pool_entries)
+{
+  g_autoptr(GPtrArray) entries = g_ptr_array_new_with_free_func (g_free);
+  GVariantDict dict;
+
+  for (gsize i = 0; i < n_entries_per_user; i++)
+    {
+      gsize pool_index = (user_index * 7 + i) % n_pool_entries;
+
+      if (pool_index % 2 == 0)
+        g_ptr_array_add (entries, g_strdup_printf ("app/org.example.App%" G_GSIZE_FORMAT "/x86_64/stable", pool_index));
+      else
+        g_ptr_array_add (entries, g_strdup_printf ("application/x-example-%" G_GSIZE_FORMAT, pool_index));
+    }
+  g_ptr_array_add (entries, NULL);
+
+  g_variant_dict_init (&dict, NULL);
+  g_variant_dict_insert (&dict, "AppFilter", "(b^as)", FALSE, entries->pdata);
+
+  return g_variant_ref_sink (g_variant_dict_end (&dict));
+}
+
+/* Test that app filters behave the same when their entries are interned. */
+static void
+test_app_filter_intern_strings (void)
+{
+  g_autoptr(GVariant) serialized = build_synthetic_user_filter (0, 10, 10);
+  g_autoptr(MctAppFilter) filter = NULL;
+  g_autoptr(MctAppFilter) interned_filter1 = NULL;
+  g_autoptr(MctAppFilter) interned_filter2 = NULL;
+  g_autoptr(GVariant) reserialized = NULL;
+  g_auto(MctAppFilterBuilder) builder = MCT_APP_FILTER_BUILDER_INIT ();
+  g_autoptr(MctAppFilter) built_filter = NULL;
+  g_autoptr(GError) local_error = NULL;
+
+  filter = mct_app_filter_deserialize (serialized, 1, &local_error);
+  g_assert_no_error (local_error);
+
+  mct_app_filter_set_intern_strings (TRUE);
+
+  interned_filter1 = mct_app_filter_deserialize (serialized, 1, &local_error);
+  g_assert_no_error (local_error);
+  interned_filter2 = mct_app_filter_deserialize (serialized, 2, &local_error);
+  g_assert_no_error (local_error);
+
+  mct_app_filter_builder_blocklist_flatpak_ref (&builder, "app/org.example.App0/x86_64/stable");
+  built_filter = mct_app_filter_builder_end (&builder);
+
+  mct_app_filter_set_intern_strings (FALSE);
+
+  g_assert_true (mct_app_filter_equal (filter, interned_filter1));
+  g_assert_cmpstr (mct_app_filter_get_digest (interned_filter1), ==,
+                   mct_app_filter_get_digest (interned_filter2));
+  g_assert_cmpint (mct_app_filter_diff (filter, interned_filter2, NULL, NULL, NULL), ==,
+                   MCT_APP_FILTER_DIFF_FLAGS_NONE);
+
+  g_assert_false (mct_app_filter_is_flatpak_ref_allowed (interned_filter1, "app/org.example.App0/x86_64/stable"));
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (interned_filter1, "org.example.App0"));
+  g_assert_true (mct_app_filter_is_flatpak_app_allowed (interned_filter1, "org.example.App1"));
+  g_assert_false (mct_app_filter_is_content_type_allowed (interned_filter1, "application/x-example-1"));
+  g_assert_true (mct_app_filter_is_content_type_allowed (interned_filter1, "application/x-example-0"));
+
+  g_assert_false (mct_app_filter_is_flatpak_app_allowed (built_filter, "org.example.App0"));
+
+  reserialized = g_variant_ref_sink (mct_app_filter_serialize (interned_filter1));
+  g_clear_pointer (&interned_filter1, mct_app_filter_unref);
+  interned_filter1 = mct_app_filter_deserialize (reserialized, 1, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_true (mct_app_filter_equal (filter, interned_filter1));
+}
+
+#ifdef HAVE_MALLINFO2
+/* Get the number of bytes of heap memory currently allocated. */
+static gsize
+get_heap_in_use (void)
+{
+  struct mallinfo2 info = mallinfo2 ();
+
+  return info.uordblks + info.hblkhd;
+}
+#endif
+
+/* Measure how much memory is used by the app filters for a lot of users,
+ * with and without interning their entries. */
+static void
+test_app_filter_perf_intern_strings (void)
+{
+#ifdef HAVE_MALLINFO2
+  const guint n_users = 1000;
+  const gsize n_entries_per_user = 200;
+  const gsize n_pool_entries = 500;
+  gsize heap_in_use[2];
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Performance tests not enabled");
+      return;
+    }
+
+  for (guint intern = 0; intern < 2; intern++)
+    {
+      g_autoptr(GPtrArray) filters = g_ptr_array_new_with_free_func ((GDestroyNotify) mct_app_filter_unref);
+      gsize heap_before;
+
+      mct_app_filter_set_intern_strings (intern);
+      heap_before = get_heap_in_use ();
+
+      for (guint i = 0; i < n_users; i++)
+        {
+          g_autoptr(GVariant) serialized = NULL;
+          g_autoptr(GError) local_error = NULL;
+
+          serialized = build_synthetic_user_filter (i, n_entries_per_user, n_pool_entries);
+          g_ptr_array_add (filters, mct_app_filter_deserialize (serialized, i, &local_error));
+          g_assert_no_error (local_error);
+        }
+
+      heap_in_use[intern] = get_heap_in_use () - heap_before;
+
+      g_test_minimized_result (heap_in_use[intern],
+                               "Memory for %u users’ app filters with%s interning: %" G_GSIZE_FORMAT " bytes",
+                               n_users, intern ? "" : "out", heap_in_use[intern]);
     }
+
+  mct_app_filter_set_intern_strings (FALSE);
+
+  g_test_message ("Interning saved %" G_GSSIZE_FORMAT " bytes (%.1f%%)",
+                  (gssize) (heap_in_use[0] - heap_in_use[1]),
+                  100.0 * ((gdouble) heap_in_use[0] - heap_in_use[1]) / heap_in_use[0]);
+  g_assert_cmpuint (heap_in_use[1], <, heap_in_use[0]);
+#else
+  g_test_skip ("Measuring memory use is not supported on this platform");
+#endif
 }
 
 /* Fixture for tests which interact with the accountsservice over D-Bus. The
@@ -1669,14 +3277,23 @@ main (int    argc,
   g_test_add_func ("/app-filter/error-quark", test_app_filter_error_quark);
   g_test_add_func ("/app-filter/types", test_app_filter_types);
   g_test_add_func ("/app-filter/refs", test_app_filter_refs);
+  g_test_add_func ("/app-filter/refs/threads", test_app_filter_refs_threads);
 
   g_test_add_func ("/app-filter/serialize", test_app_filter_serialize);
   g_test_add_func ("/app-filter/deserialize", test_app_filter_deserialize);
+  g_test_add_func ("/app-filter/deserialize/borrowed", test_app_filter_deserialize_borrowed);
+  g_test_add_func ("/app-filter/deserialize/wildcards", test_app_filter_deserialize_wildcards);
   g_test_add_func ("/app-filter/deserialize/invalid", test_app_filter_deserialize_invalid);
 
   g_test_add_func ("/app-filter/equal", test_app_filter_equal);
+  g_test_add_func ("/app-filter/digest", test_app_filter_digest);
+  g_test_add_func ("/app-filter/diff", test_app_filter_diff);
+  g_test_add_func ("/app-filter/intern-strings", test_app_filter_intern_strings);
+  g_test_add_func ("/app-filter/serialize/cached", test_app_filter_serialize_cached);
 
   g_test_add_func ("/app-filter/is-enabled", test_app_filter_is_enabled);
+  g_test_add_func ("/app-filter/oars-sections", test_app_filter_oars_sections);
+  g_test_add_func ("/app-filter/content-rating", test_app_filter_content_rating);
 
   g_test_add ("/app-filter/builder/stack/non-empty", BuilderFixture, NULL,
               builder_set_up_stack, test_app_filter_builder_non_empty,
@@ -1700,9 +3317,32 @@ main (int    argc,
                    test_app_filter_builder_copy_empty);
   g_test_add_func ("/app-filter/builder/copy/full",
                    test_app_filter_builder_copy_full);
-
+  g_test_add_func ("/app-filter/builder/copy/oars",
+                   test_app_filter_builder_copy_oars);
+  g_test_add_func ("/app-filter/builder/new-from-filter",
+                   test_app_filter_builder_new_from_filter);
+  g_test_add_func ("/app-filter/builder/remove",
+                   test_app_filter_builder_remove);
+  g_test_add_func ("/app-filter/builder/duplicates",
+                   test_app_filter_builder_duplicates);
+  g_test_add_func ("/app-filter/builder/allowlist",
+                   test_app_filter_builder_allowlist);
+  g_test_add_func ("/app-filter/builder/wildcards",
+                   test_app_filter_builder_wildcards);
+
+  g_test_add_func ("/app-filter/paths", test_app_filter_paths);
+  g_test_add_func ("/app-filter/flatpak-app-ids", test_app_filter_flatpak_app_ids);
+  g_test_add_func ("/app-filter/prefixes", test_app_filter_prefixes);
+  g_test_add_func ("/app-filter/content-type-hierarchy", test_app_filter_content_type_hierarchy);
   g_test_add_func ("/app-filter/appinfo", test_app_filter_appinfo);
 
+  g_test_add_func ("/app-filter/perf/queries", test_app_filter_perf_queries);
+  g_test_add_func ("/app-filter/perf/check-app-infos", test_app_filter_perf_check_app_infos);
+  g_test_add_func ("/app-filter/perf/large-lists", test_app_filter_perf_large_lists);
+  g_test_add_func ("/app-filter/perf/prefixes", test_app_filter_perf_prefixes);
+  g_test_add_func ("/app-filter/perf/builder", test_app_filter_perf_builder);
+  g_test_add_func ("/app-filter/perf/intern-strings", test_app_filter_perf_intern_strings);
+
   g_test_add ("/app-filter/bus/get/async", BusFixture, GUINT_TO_POINTER (TRUE),
               bus_set_up, test_app_filter_bus_get, bus_tear_down);
   g_test_add ("/app-filter/bus/get/sync", BusFixture, GUINT_TO_POINTER (FALSE),
@@ -23,6 +23,7 @@
 #include "config.h"
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 #include <libmalcontent/session-limits.h>
 #include <libmalcontent/manager.h>
@@ -73,6 +74,57 @@ test_session_limits_refs (void)
   /* Final ref is dropped by g_autoptr(). */
 }
 
+#define N_THREADS 8
+#define N_ITERATIONS 10000
+
+static gpointer
+refs_threads_thread_cb (gpointer user_data)
+{
+  g_autoptr(MctSessionLimits) limits = user_data;
+
+  for (gsize i = 0; i < N_ITERATIONS; i++)
+    {
+      g_autoptr(MctSessionLimits) limits_ref = mct_session_limits_ref (limits);
+      guint64 time_remaining_secs;
+      gboolean time_limit_enabled;
+
+      g_assert_true (mct_session_limits_is_enabled (limits_ref));
+      g_assert_false (mct_session_limits_check_time_remaining (limits_ref, usec (99), NULL, NULL));
+      g_assert_true (mct_session_limits_check_time_remaining (limits_ref, usec (100),
+                                                              &time_remaining_secs,
+                                                              &time_limit_enabled));
+      g_assert_cmpuint (time_remaining_secs, ==, 8 * 60 * 60 - 100);
+      g_assert_true (time_limit_enabled);
+    }
+
+  /* The last thread to finish frees the limits. */
+  return NULL;
+}
+
+/* Test that ref(), unref() and the query methods can be called on a single
+ * #MctSessionLimits from several threads at once. */
+static void
+test_session_limits_refs_threads (void)
+{
+  g_auto(MctSessionLimitsBuilder) builder = MCT_SESSION_LIMITS_BUILDER_INIT ();
+  g_autoptr(MctSessionLimits) limits = NULL;
+  GThread *threads[N_THREADS];
+
+  mct_session_limits_builder_set_daily_schedule (&builder, 100, 8 * 60 * 60);
+  limits = mct_session_limits_builder_end (&builder);
+
+  /* Give each thread its own reference, and drop ours before joining them, so
+   * that the limits are freed from one of the threads. */
+  for (gsize i = 0; i < G_N_ELEMENTS (threads); i++)
+    threads[i] = g_thread_new ("refs-threads", refs_threads_thread_cb,
+                               mct_session_limits_ref (limits));
+
+  g_clear_pointer (&limits, mct_session_limits_unref);
+
+  for (gsize i = 0; i < G_N_ELEMENTS (threads); i++)
+    g_thread_join (threads[i]);
+}
+
 /* Check error handling when passing an invalid time for @now_usecs to
  * mct_session_limits_check_time_remaining(). */
 static void
@@ -92,6 +144,839 @@ test_session_limits_check_time_remaining_invalid_time (void)
   g_assert_true (time_limit_enabled);
 }
 
+/* Test that mct_session_limits_get_next_transition() returns the next time
+ * the result of mct_session_limits_check_time_remaining() changes, including
+ * across day boundaries. */
+static void
+test_session_limits_get_next_transition (void)
+{
+  g_auto(MctSessionLimitsBuilder) builder = MCT_SESSION_LIMITS_BUILDER_INIT ();
+  g_autoptr(MctSessionLimits) limits = NULL;
+  g_autoptr(MctSessionLimits) none_limits = NULL;
+  g_autoptr(MctSessionLimits) all_day_limits = NULL;
+  const guint64 day = 24 * 60 * 60;
+  const struct
+    {
+      guint64 now_usecs;
+      guint64 expected_next_transition_usecs;
+      gboolean expected_allowed_after;
+    }
+  vectors[] =
+    {
+      { usec (0), usec (100), TRUE },
+      { usec (99) + 999999, usec (100), TRUE },
+      { usec (100), usec (8 * 60 * 60), FALSE },
+      { usec (4 * 60 * 60), usec (8 * 60 * 60), FALSE },
+      { usec (8 * 60 * 60), usec (day + 100), TRUE },
+      { usec (day - 1), usec (day + 100), TRUE },
+      { usec (10 * day + 200), usec (10 * day + 8 * 60 * 60), FALSE },
+    };
+
+  mct_session_limits_builder_set_daily_schedule (&builder, 100, 8 * 60 * 60);
+  limits = mct_session_limits_builder_end (&builder);
+
+  for (gsize i = 0; i < G_N_ELEMENTS (vectors); i++)
+    {
+      guint64 next_transition_usecs;
+      gboolean allowed_after;
+
+      g_test_message ("Vector %" G_GSIZE_FORMAT ": %" G_GUINT64_FORMAT,
+                      i, vectors[i].now_usecs);
+
+      g_assert_true (mct_session_limits_get_next_transition (limits, vectors[i].now_usecs,
+                                                             &next_transition_usecs,
+                                                             &allowed_after));
+      g_assert_cmpuint (next_transition_usecs, ==, vectors[i].expected_next_transition_usecs);
+      g_assert_cmpint (allowed_after, ==, vectors[i].expected_allowed_after);
+
+      /* Check consistency with mct_session_limits_check_time_remaining(). */
+      g_assert_cmpint (mct_session_limits_check_time_remaining (limits, vectors[i].now_usecs, NULL, NULL), ==,
+                       !allowed_after);
+      g_assert_cmpint (mct_session_limits_check_time_remaining (limits, next_transition_usecs - 1, NULL, NULL), ==,
+                       !allowed_after);
+      g_assert_cmpint (mct_session_limits_check_time_remaining (limits, next_transition_usecs, NULL, NULL), ==,
+                       allowed_after);
+    }
+
+  /* Invalid times have no transitions. */
+  g_assert_false (mct_session_limits_get_next_transition (limits, G_MAXUINT64, NULL, NULL));
+
+  /* No limits, and schedules covering the whole day, have no transitions. */
+  mct_session_limits_builder_init (&builder);
+  none_limits = mct_session_limits_builder_end (&builder);
+  g_assert_false (mct_session_limits_get_next_transition (none_limits, usec (100), NULL, NULL));
+
+  mct_session_limits_builder_init (&builder);
+  mct_session_limits_builder_set_daily_schedule (&builder, 0, day);
+  all_day_limits = mct_session_limits_builder_end (&builder);
+  g_assert_false (mct_session_limits_get_next_transition (all_day_limits, usec (100), NULL, NULL));
+}
+
+/* A POSIX time zone string with the same rules as Europe/London: GMT in
+ * winter, and BST (UTC+1) from 01:00 UTC on the last Sunday in March to 01:00
+ * UTC on the last Sunday in October. This avoids depending on tzdata. */
+#define UK_TIME_ZONE "GMT0BST,M3.5.0/1,M10.5.0"
+
+/* Midnight UTC on various days in 2020, in seconds since the Unix epoch. */
+#define SPRING_FORWARD_DAY 1585440000  /* 2020-03-29 */
+#define SUMMER_DAY 1590969600  /* 2020-06-01 */
+#define FALL_BACK_DAY 1603584000  /* 2020-10-25 */
+
+/* Set the local time zone which session limits are evaluated in to
+ * @identifier, using the `TZ` environment variable. If GLib doesn’t pick up
+ * the change, the test is skipped and %FALSE is returned. The time zone should
+ * be reset to UTC at the end of the test. */
+static gboolean
+set_local_time_zone (const gchar *identifier)
+{
+  g_autoptr(GTimeZone) tz = NULL;
+
+  g_setenv ("TZ", identifier, TRUE);
+  tz = g_time_zone_new_local ();
+
+  if (g_strcmp0 (g_time_zone_get_identifier (tz), identifier) != 0)
+    {
+      g_setenv ("TZ", "UTC", TRUE);
+      g_test_skip ("Local time zone can’t be changed using TZ");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Test that mct_session_limits_check_time_remaining() interprets the schedule
+ * in the local time zone, and notices when it changes. */
+static void
+test_session_limits_check_time_remaining_time_zone (void)
+{
+  g_auto(MctSessionLimitsBuilder) builder = MCT_SESSION_LIMITS_BUILDER_INIT ();
+  g_autoptr(MctSessionLimits) limits = NULL;
+  const guint64 day = 24 * 60 * 60;
+  guint64 time_remaining_secs;
+  guint64 next_transition_usecs;
+  gboolean allowed_after;
+
+  /* UTC+05:30. */
+  if (!set_local_time_zone ("IST-5:30"))
+    return;
+
+  mct_session_limits_builder_set_daily_schedule (&builder, 9 * 60 * 60, 17 * 60 * 60);
+  limits = mct_session_limits_builder_end (&builder);
+
+  /* 08:59:59 and 09:00 local time. */
+  g_assert_false (mct_session_limits_check_time_remaining (limits, usec (10 * day + 3 * 60 * 60 + 29 * 60 + 59),
+                                                           &time_remaining_secs, NULL));
+  g_assert_cmpuint (time_remaining_secs, ==, 0);
+  g_assert_true (mct_session_limits_check_time_remaining (limits, usec (10 * day + 3 * 60 * 60 + 30 * 60),
+                                                          &time_remaining_secs, NULL));
+  g_assert_cmpuint (time_remaining_secs, ==, 8 * 60 * 60);
+
+  /* 16:59:59 and 17:00 local time. */
+  g_assert_true (mct_session_limits_check_time_remaining (limits, usec (10 * day + 11 * 60 * 60 + 29 * 60 + 59),
+                                                          &time_remaining_secs, NULL));
+  g_assert_cmpuint (time_remaining_secs, ==, 1);
+  g_assert_false (mct_session_limits_check_time_remaining (limits, usec (10 * day + 11 * 60 * 60 + 30 * 60),
+                                                           &time_remaining_secs, NULL));
+
+  g_assert_true (mct_session_limits_get_next_transition (limits, usec (10 * day),
+                                                         &next_transition_usecs, &allowed_after));
+  g_assert_cmpuint (next_transition_usecs, ==, usec (10 * day + 3 * 60 * 60 + 30 * 60));
+  g_assert_true (allowed_after);
+
+  /* Changing the time zone takes effect immediately. */
+  g_assert_true (set_local_time_zone ("UTC"));
+
+  g_assert_false (mct_session_limits_check_time_remaining (limits, usec (10 * day + 3 * 60 * 60 + 30 * 60),
+                                                           NULL, NULL));
+  g_assert_true (mct_session_limits_check_time_remaining (limits, usec (10 * day + 9 * 60 * 60),
+                                                          &time_remaining_secs, NULL));
+  g_assert_cmpuint (time_remaining_secs, ==, 8 * 60 * 60);
+}
+
+/* Test that mct_session_limits_check_time_remaining() handles daylight saving
+ * changes, including when the end of the schedule is skipped or repeated. */
+static void
+test_session_limits_check_time_remaining_dst (void)
+{
+  const struct
+    {
+      guint start_time_secs;
+      guint end_time_secs;
+      guint64 now_secs;
+      gboolean expected_allowed;
+      guint64 expected_time_remaining_secs;
+    }
+  vectors[] =
+    {
+      /* 08:30 and 09:00 BST. */
+      { 9 * 60 * 60, 17 * 60 * 60, SUMMER_DAY + 7 * 60 * 60 + 30 * 60, FALSE, 0 },
+      { 9 * 60 * 60, 17 * 60 * 60, SUMMER_DAY + 8 * 60 * 60, TRUE, 8 * 60 * 60 },
+
+      /* The day the clocks go forward from 01:00 GMT to 02:00 BST is an hour
+       * shorter. If the end of the schedule is skipped, the session ends when
+       * the clocks change. */
+      { 0, 3 * 60 * 60, SPRING_FORWARD_DAY, TRUE, 2 * 60 * 60 },
+      { 30 * 60, 90 * 60, SPRING_FORWARD_DAY + 45 * 60, TRUE, 15 * 60 },
+      { 3 * 60 * 60, 4 * 60 * 60, SPRING_FORWARD_DAY + 2 * 60 * 60, TRUE, 60 * 60 },
+
+      /* The day the clocks go back from 02:00 BST to 01:00 GMT is an hour
+       * longer. If the end of the schedule is repeated, the session ends the
+       * first time it’s reached, and is allowed again in the repeated hour. */
+      { 0, 3 * 60 * 60, FALL_BACK_DAY - 60 * 60, TRUE, 4 * 60 * 60 },
+      { 0, 90 * 60, FALL_BACK_DAY - 60 * 60, TRUE, 90 * 60 },
+      { 0, 90 * 60, FALL_BACK_DAY + 45 * 60, FALSE, 0 },
+      { 0, 90 * 60, FALL_BACK_DAY + 60 * 60, TRUE, 30 * 60 },
+    };
+
+  if (!set_local_time_zone (UK_TIME_ZONE))
+    return;
+
+  for (gsize i = 0; i < G_N_ELEMENTS (vectors); i++)
+    {
+      g_auto(MctSessionLimitsBuilder) builder = MCT_SESSION_LIMITS_BUILDER_INIT ();
+      g_autoptr(MctSessionLimits) limits = NULL;
+      guint64 time_remaining_secs;
+      gboolean time_limit_enabled;
+
+      g_test_message ("Vector %" G_GSIZE_FORMAT ": %u–%u at %" G_GUINT64_FORMAT,
+                      i, vectors[i].start_time_secs, vectors[i].end_time_secs,
+                      vectors[i].now_secs);
+
+      mct_session_limits_builder_set_daily_schedule (&builder,
+                                                     vectors[i].start_time_secs,
+                                                     vectors[i].end_time_secs);
+      limits = mct_session_limits_builder_end (&builder);
+
+      g_assert_cmpint (mct_session_limits_check_time_remaining (limits, usec (vectors[i].now_secs),
+                                                                &time_remaining_secs,
+                                                                &time_limit_enabled), ==,
+                       vectors[i].expected_allowed);
+      g_assert_cmpuint (time_remaining_secs, ==, vectors[i].expected_time_remaining_secs);
+      g_assert_true (time_limit_enabled);
+    }
+
+  set_local_time_zone ("UTC");
+}
+
+/* Test that mct_session_limits_get_next_transition() handles daylight saving
+ * changes, and stays consistent with mct_session_limits_check_time_remaining()
+ * across them. */
+static void
+test_session_limits_get_next_transition_dst (void)
+{
+  const guint64 day = 24 * 60 * 60;
+  const struct
+    {
+      guint start_time_secs;
+      guint end_time_secs;
+      guint64 now_secs;
+      guint64 expected_next_transition_secs;
+      gboolean expected_allowed_after;
+    }
+  vectors[] =
+    {
+      /* 08:00 BST until 09:00 BST. */
+      { 9 * 60 * 60, 17 * 60 * 60, SUMMER_DAY + 7 * 60 * 60, SUMMER_DAY + 8 * 60 * 60, TRUE },
+
+      /* The end of the schedule is skipped, so the clocks changing ends it. */
+      { 30 * 60, 90 * 60, SPRING_FORWARD_DAY + 45 * 60, SPRING_FORWARD_DAY + 60 * 60, FALSE },
+
+      /* The whole schedule is skipped, so the next transition is the
+       * following day, at 01:15 BST. */
+      { 75 * 60, 105 * 60, SPRING_FORWARD_DAY, SPRING_FORWARD_DAY + day + 15 * 60, TRUE },
+
+      /* 00:00 BST until 03:00 GMT. */
+      { 0, 3 * 60 * 60, FALL_BACK_DAY - 60 * 60, FALL_BACK_DAY + 3 * 60 * 60, FALSE },
+
+      /* 01:45 BST until the clocks change to 01:00 GMT, which is in the
+       * schedule again. */
+      { 0, 90 * 60, FALL_BACK_DAY + 45 * 60, FALL_BACK_DAY + 60 * 60, TRUE },
+    };
+
+  if (!set_local_time_zone (UK_TIME_ZONE))
+    return;
+
+  for (gsize i = 0; i < G_N_ELEMENTS (vectors); i++)
+    {
+      g_auto(MctSessionLimitsBuilder) builder = MCT_SESSION_LIMITS_BUILDER_INIT ();
+      g_autoptr(MctSessionLimits) limits = NULL;
+      guint64 next_transition_usecs;
+      gboolean allowed_after;
+
+      g_test_message ("Vector %" G_GSIZE_FORMAT ": %u–%u at %" G_GUINT64_FORMAT,
+                      i, vectors[i].start_time_secs, vectors[i].end_time_secs,
+                      vectors[i].now_secs);
+
+      mct_session_limits_builder_set_daily_schedule (&builder,
+                                                     vectors[i].start_time_secs,
+                                                     vectors[i].end_time_secs);
+      limits = mct_session_limits_builder_end (&builder);
+
+      g_assert_true (mct_session_limits_get_next_transition (limits, usec (vectors[i].now_secs),
+                                                             &next_transition_usecs,
+                                                             &allowed_after));
+      g_assert_cmpuint (next_transition_usecs, ==, usec (vectors[i].expected_next_transition_secs));
+      g_assert_cmpint (allowed_after, ==, vectors[i].expected_allowed_after);
+
+      /* Check consistency with mct_session_limits_check_time_remaining(). */
+      g_assert_cmpint (mct_session_limits_check_time_remaining (limits, usec (vectors[i].now_secs), NULL, NULL), ==,
+                       !allowed_after);
+      g_assert_cmpint (mct_session_limits_check_time_remaining (limits, next_transition_usecs - 1, NULL, NULL), ==,
+                       !allowed_after);
+      g_assert_cmpint (mct_session_limits_check_time_remaining (limits, next_transition_usecs, NULL, NULL), ==,
+                       allowed_after);
+    }
+
+  set_local_time_zone ("UTC");
+}
+
+/* Test the performance of mct_session_limits_check_time_remaining() when
+ * evaluating the limits of many users every minute, as a multi-seat system
+ * might, over a week which includes a daylight saving change. */
+static void
+test_session_limits_perf_check_time_remaining (void)
+{
+  g_autoptr(GPtrArray) limits_array = NULL;
+  g_autoptr(GTimer) timer = NULL;
+  const guint n_users = 1000;
+  const guint n_minutes = 7 * 24 * 60;
+  const guint64 start_secs = SPRING_FORWARD_DAY - 3 * 24 * 60 * 60;
+  guint n_allowed = 0;
+  gdouble elapsed_secs;
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Performance tests not enabled");
+      return;
+    }
+
+  if (!set_local_time_zone (UK_TIME_ZONE))
+    return;
+
+  limits_array = g_ptr_array_new_with_free_func ((GDestroyNotify) mct_session_limits_unref);
+
+  for (guint i = 0; i < n_users; i++)
+    {
+      g_auto(MctSessionLimitsBuilder) builder = MCT_SESSION_LIMITS_BUILDER_INIT ();
+
+      mct_session_limits_builder_set_daily_schedule (&builder,
+                                                     (i % 12) * 60 * 60,
+                                                     (i % 12 + 12) * 60 * 60);
+      g_ptr_array_add (limits_array, mct_session_limits_builder_end (&builder));
+    }
+
+  timer = g_timer_new ();
+
+  for (guint i = 0; i < n_minutes; i++)
+    for (guint j = 0; j < n_users; j++)
+      if (mct_session_limits_check_time_remaining (limits_array->pdata[j],
+                                                   usec (start_secs + i * 60),
+                                                   NULL, NULL))
+        n_allowed++;
+
+  elapsed_secs = g_timer_elapsed (timer, NULL);
+  g_test_minimized_result (elapsed_secs * 1e9 / (n_minutes * n_users),
+                           "mct_session_limits_check_time_remaining(): %.1f ns per call",
+                           elapsed_secs * 1e9 / (n_minutes * n_users));
+
+  /* Each user is allowed for half of each day. */
+  g_assert_cmpuint (n_allowed, >, 0);
+  g_assert_cmpuint (n_allowed, <, n_minutes * n_users);
+
+  set_local_time_zone ("UTC");
+}
+
+/* Build a weekly schedule with several intervals on Monday (two of which
+ * overlap), one on Saturday, and one from Sunday evening into Monday. */
+static MctSessionLimits *
+build_weekly_schedule (void)
+{
+  g_auto(MctSessionLimitsBuilder) builder = MCT_SESSION_LIMITS_BUILDER_INIT ();
+  const guint hour = 60 * 60;
+
+  mct_session_limits_builder_set_weekly_schedule (&builder);
+  mct_session_limits_builder_add_weekly_interval (&builder, G_DATE_MONDAY, 9 * hour, 12 * hour);
+  mct_session_limits_builder_add_weekly_interval (&builder, G_DATE_SATURDAY, 10 * hour, 18 * hour);
+  mct_session_limits_builder_add_weekly_interval (&builder, G_DATE_MONDAY, 13 * hour, 15 * hour);
+  mct_session_limits_builder_add_weekly_interval (&builder, G_DATE_MONDAY, 11 * hour, 12 * hour + 30 * 60);
+  mct_session_limits_builder_add_weekly_interval (&builder, G_DATE_SUNDAY, 22 * hour, 24 * hour);
+  mct_session_limits_builder_add_weekly_interval (&builder, G_DATE_MONDAY, 0, 2 * hour);
+
+  return mct_session_limits_builder_end (&builder);
+}
+
+/* Test that mct_session_limits_check_time_remaining() handles weekly
+ * schedules, including merging overlapping intervals and intervals which
+ * continue into the next week. */
+static void
+test_session_limits_check_time_remaining_weekly (void)
+{
+  g_autoptr(MctSessionLimits) limits = NULL;
+  const guint64 hour = 60 * 60;
+  const guint64 day = 24 * hour;
+  /* The Unix epoch was a Thursday, so this is midnight at the start of a
+   * Monday. */
+  const guint64 monday = 4 * day + 10 * 7 * day;
+  const struct
+    {
+      guint64 now_secs;
+      gboolean expected_allowed;
+      guint64 expected_time_remaining_secs;
+    }
+  vectors[] =
+    {
+      { monday + 9 * hour - 1, FALSE, 0 },
+      { monday + 9 * hour, TRUE, 3 * hour + 30 * 60 },
+      { monday + 12 * hour + 30 * 60 - 1, TRUE, 1 },
+      { monday + 12 * hour + 30 * 60, FALSE, 0 },
+      { monday + 13 * hour, TRUE, 2 * hour },
+      { monday + day + 10 * hour, FALSE, 0 },
+      { monday + 5 * day + 17 * hour, TRUE, hour },
+      { monday + 6 * day + 23 * hour, TRUE, 3 * hour },
+      { monday + hour, TRUE, hour },
+      { monday + 2 * hour, FALSE, 0 },
+    };
+
+  limits = build_weekly_schedule ();
+
+  for (gsize i = 0; i < G_N_ELEMENTS (vectors); i++)
+    {
+      guint64 time_remaining_secs;
+      gboolean time_limit_enabled;
+
+      g_test_message ("Vector %" G_GSIZE_FORMAT ": %" G_GUINT64_FORMAT,
+                      i, vectors[i].now_secs);
+
+      g_assert_cmpint (mct_session_limits_check_time_remaining (limits, usec (vectors[i].now_secs),
+                                                                &time_remaining_secs,
+                                                                &time_limit_enabled), ==,
+                       vectors[i].expected_allowed);
+      g_assert_cmpuint (time_remaining_secs, ==, vectors[i].expected_time_remaining_secs);
+      g_assert_true (time_limit_enabled);
+    }
+}
+
+/* Test that mct_session_limits_get_next_transition() handles weekly
+ * schedules, and stays consistent with
+ * mct_session_limits_check_time_remaining(). */
+static void
+test_session_limits_get_next_transition_weekly (void)
+{
+  g_auto(MctSessionLimitsBuilder) builder = MCT_SESSION_LIMITS_BUILDER_INIT ();
+  g_autoptr(MctSessionLimits) limits = NULL;
+  g_autoptr(MctSessionLimits) empty_limits = NULL;
+  g_autoptr(MctSessionLimits) all_week_limits = NULL;
+  const guint64 hour = 60 * 60;
+  const guint64 day = 24 * hour;
+  const guint64 monday = 4 * day + 10 * 7 * day;
+  const struct
+    {
+      guint64 now_secs;
+      guint64 expected_next_transition_secs;
+      gboolean expected_allowed_after;
+    }
+  vectors[] =
+    {
+      { monday + 8 * hour, monday + 9 * hour, TRUE },
+      { monday + 10 * hour, monday + 12 * hour + 30 * 60, FALSE },
+      { monday + 12 * hour + 30 * 60, monday + 13 * hour, TRUE },
+      { monday + 15 * hour, monday + 5 * day + 10 * hour, TRUE },
+      { monday + 5 * day + 18 * hour, monday + 6 * day + 22 * hour, TRUE },
+      { monday + 6 * day + 22 * hour + 30 * 60, monday + 7 * day + 2 * hour, FALSE },
+    };
+
+  limits = build_weekly_schedule ();
+
+  for (gsize i = 0; i < G_N_ELEMENTS (vectors); i++)
+    {
+      guint64 next_transition_usecs;
+      gboolean allowed_after;
+
+      g_test_message ("Vector %" G_GSIZE_FORMAT ": %" G_GUINT64_FORMAT,
+                      i, vectors[i].now_secs);
+
+      g_assert_true (mct_session_limits_get_next_transition (limits, usec (vectors[i].now_secs),
+                                                             &next_transition_usecs,
+                                                             &allowed_after));
+      g_assert_cmpuint (next_transition_usecs, ==, usec (vectors[i].expected_next_transition_secs));
+      g_assert_cmpint (allowed_after, ==, vectors[i].expected_allowed_after);
+
+      /* Check consistency with mct_session_limits_check_time_remaining(). */
+      g_assert_cmpint (mct_session_limits_check_time_remaining (limits, usec (vectors[i].now_secs), NULL, NULL), ==,
+                       !allowed_after);
+      g_assert_cmpint (mct_session_limits_check_time_remaining (limits, next_transition_usecs - 1, NULL, NULL), ==,
+                       !allowed_after);
+      g_assert_cmpint (mct_session_limits_check_time_remaining (limits, next_transition_usecs, NULL, NULL), ==,
+                       allowed_after);
+    }
+
+  /* An empty weekly schedule never allows sessions, and one covering the
+   * whole week always does, so neither has transitions. */
+  mct_session_limits_builder_set_weekly_schedule (&builder);
+  empty_limits = mct_session_limits_builder_end (&builder);
+  g_assert_false (mct_session_limits_check_time_remaining (empty_limits, usec (monday), NULL, NULL));
+  g_assert_false (mct_session_limits_get_next_transition (empty_limits, usec (monday), NULL, NULL));
+
+  mct_session_limits_builder_init (&builder);
+  mct_session_limits_builder_set_weekly_schedule (&builder);
+  for (GDateWeekday weekday = G_DATE_MONDAY; weekday <= G_DATE_SUNDAY; weekday++)
+    mct_session_limits_builder_add_weekly_interval (&builder, weekday, 0, day);
+  all_week_limits = mct_session_limits_builder_end (&builder);
+  g_assert_true (mct_session_limits_check_time_remaining (all_week_limits, usec (monday), NULL, NULL));
+  g_assert_false (mct_session_limits_get_next_transition (all_week_limits, usec (monday), NULL, NULL));
+}
+
+/* Test that a weekly schedule survives a round trip through
+ * mct_session_limits_serialize() and mct_session_limits_deserialize(), and that
+ * its intervals are serialised sorted and merged. */
+static void
+test_session_limits_serialize_weekly (void)
+{
+  g_autoptr(MctSessionLimits) limits = NULL;
+  g_autoptr(MctSessionLimits) deserialized = NULL;
+  g_autoptr(GVariant) serialized = NULL;
+  g_autoptr(GVariant) weekly_schedule = NULL;
+  g_autoptr(GVariant) expected_weekly_schedule = NULL;
+  g_autoptr(GError) local_error = NULL;
+  const guint64 day = 24 * 60 * 60;
+  const guint64 monday = 4 * day + 10 * 7 * day;
+
+  limits = build_weekly_schedule ();
+  serialized = g_variant_ref_sink (mct_session_limits_serialize (limits));
+
+  weekly_schedule = g_variant_lookup_value (serialized, "WeeklySchedule", G_VARIANT_TYPE ("a(uu)"));
+  expected_weekly_schedule = g_variant_ref_sink (g_variant_new_parsed ("[(@u 0, @u 7200), (32400, 45000), "
+                                                                       "(46800, 54000), (468000, 496800), "
+                                                                       "(597600, 604800)]"));
+  g_assert_cmpvariant (weekly_schedule, expected_weekly_schedule);
+
+  deserialized = mct_session_limits_deserialize (serialized, 1, &local_error);
+  g_assert_no_error (local_error);
+
+  for (guint64 t = monday; t < monday + 7 * day; t += 30 * 60)
+    g_assert_cmpint (mct_session_limits_check_time_remaining (deserialized, usec (t), NULL, NULL), ==,
+                     mct_session_limits_check_time_remaining (limits, usec (t), NULL, NULL));
+}
+
+/* Test the performance of evaluating weekly schedules with varying numbers of
+ * intervals. Lookups should scale logarithmically. */
+static void
+test_session_limits_perf_weekly_schedule (void)
+{
+  const guint n_intervals_per_day[] = { 1, 12, 144 };
+  const guint64 day = 24 * 60 * 60;
+  const guint64 monday = 4 * day + 10 * 7 * day;
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Performance tests not enabled");
+      return;
+    }
+
+  for (gsize i = 0; i < G_N_ELEMENTS (n_intervals_per_day); i++)
+    {
+      g_auto(MctSessionLimitsBuilder) builder = MCT_SESSION_LIMITS_BUILDER_INIT ();
+      g_autoptr(MctSessionLimits) limits = NULL;
+      g_autoptr(GTimer) timer = NULL;
+      const guint n_iterations = 1000000;
+      const guint period = day / n_intervals_per_day[i];
+      gdouble elapsed_secs;
+
+      /* Allow the first half of each period. */
+      mct_session_limits_builder_set_weekly_schedule (&builder);
+      for (GDateWeekday weekday = G_DATE_MONDAY; weekday <= G_DATE_SUNDAY; weekday++)
+        for (guint j = 0; j < n_intervals_per_day[i]; j++)
+          mct_session_limits_builder_add_weekly_interval (&builder, weekday,
+                                                          j * period, j * period + period / 2);
+      limits = mct_session_limits_builder_end (&builder);
+
+      timer = g_timer_new ();
+
+      for (guint j = 0; j < n_iterations; j++)
+        mct_session_limits_check_time_remaining (limits, usec (monday + ((guint64) j * 7919) % (7 * day)),
+                                                 NULL, NULL);
+
+      elapsed_secs = g_timer_elapsed (timer, NULL);
+      g_test_minimized_result (elapsed_secs * 1e9 / n_iterations,
+                               "mct_session_limits_check_time_remaining() with %u intervals: %.1f ns per call",
+                               7 * n_intervals_per_day[i], elapsed_secs * 1e9 / n_iterations);
+    }
+}
+
+/* Test that mct_session_limits_check_time_remaining_with_usage() works out
+ * what is left of a daily quota, and that quotas have no transitions. */
+static void
+test_session_limits_check_time_remaining_daily_quota (void)
+{
+  g_auto(MctSessionLimitsBuilder) builder = MCT_SESSION_LIMITS_BUILDER_INIT ();
+  g_autoptr(MctSessionLimits) limits = NULL;
+  g_autoptr(MctSessionLimits) user_limits = NULL;
+  g_autoptr(GVariant) serialized = NULL;
+  g_autoptr(GError) local_error = NULL;
+  const guint64 hour = 60 * 60;
+  const guint64 now_secs = 1000 * 24 * hour + 15 * hour;
+  const struct
+    {
+      guint64 usage_secs;
+      gboolean expected_allowed;
+      guint64 expected_time_remaining_secs;
+    }
+  vectors[] =
+    {
+      { 0, TRUE, 2 * hour },
+      { 30 * 60, TRUE, hour + 30 * 60 },
+      { 2 * hour - 1, TRUE, 1 },
+      { 2 * hour, FALSE, 0 },
+      { 5 * hour, FALSE, 0 },
+    };
+  guint64 time_remaining_secs;
+  gboolean time_limit_enabled;
+
+  mct_session_limits_builder_set_daily_quota (&builder, 2 * hour);
+  limits = mct_session_limits_builder_end (&builder);
+
+  g_assert_true (mct_session_limits_is_enabled (limits));
+
+  for (gsize i = 0; i < G_N_ELEMENTS (vectors); i++)
+    {
+      gboolean allowed;
+
+      g_test_message ("Vector %" G_GSIZE_FORMAT ": %" G_GUINT64_FORMAT " seconds used",
+                      i, vectors[i].usage_secs);
+
+      allowed = mct_session_limits_check_time_remaining_with_usage (limits, usec (now_secs),
+                                                                    vectors[i].usage_secs,
+                                                                    &time_remaining_secs,
+                                                                    &time_limit_enabled);
+      g_assert_cmpint (allowed, ==, vectors[i].expected_allowed);
+      g_assert_cmpuint (time_remaining_secs, ==, vectors[i].expected_time_remaining_secs);
+      g_assert_true (time_limit_enabled);
+    }
+
+  /* mct_session_limits_check_time_remaining() doesn’t read any ledger, even
+   * for limits loaded for a user, so it assumes no usage. */
+  g_assert_true (mct_session_limits_check_time_remaining (limits, usec (now_secs),
+                                                          &time_remaining_secs, NULL));
+  g_assert_cmpuint (time_remaining_secs, ==, 2 * hour);
+
+  serialized = g_variant_ref_sink (mct_session_limits_serialize (limits));
+  user_limits = mct_session_limits_deserialize (serialized, 1000, &local_error);
+  g_assert_no_error (local_error);
+
+  g_assert_true (mct_session_limits_check_time_remaining (user_limits, usec (now_secs),
+                                                          &time_remaining_secs, NULL));
+  g_assert_cmpuint (time_remaining_secs, ==, 2 * hour);
+
+  /* Usage is ignored for other types of limit. */
+  g_clear_pointer (&limits, mct_session_limits_unref);
+  limits = mct_session_limits_builder_end (&builder);
+
+  g_assert_true (mct_session_limits_check_time_remaining_with_usage (limits, usec (now_secs),
+                                                                     24 * hour,
+                                                                     &time_remaining_secs,
+                                                                     &time_limit_enabled));
+  g_assert_cmpuint (time_remaining_secs, ==, G_MAXUINT64);
+  g_assert_false (time_limit_enabled);
+
+  /* Quotas don’t depend on the time, so have no transitions. */
+  g_clear_pointer (&limits, mct_session_limits_unref);
+  mct_session_limits_builder_set_daily_quota (&builder, 0);
+  limits = mct_session_limits_builder_end (&builder);
+
+  g_assert_false (mct_session_limits_check_time_remaining (limits, usec (now_secs), NULL, NULL));
+  g_assert_false (mct_session_limits_get_next_transition (limits, usec (now_secs), NULL, NULL));
+}
+
+/* Test that mct_session_limits_check_time_remaining_with_ledger() reads the
+ * usage for a daily quota from the ledger, and doesn’t allow the user a
+ * session if the ledger can’t be read. */
+static void
+test_session_limits_check_time_remaining_daily_quota_ledger (void)
+{
+  g_auto(MctSessionLimitsBuilder) builder = MCT_SESSION_LIMITS_BUILDER_INIT ();
+  g_autoptr(MctSessionLimits) limits = NULL;
+  g_autoptr(MctUsageLedger) ledger = NULL;
+  g_autoptr(GError) local_error = NULL;
+  g_autofree gchar *tmp_dir = NULL;
+  g_autofree gchar *ledger_dir = NULL;
+  g_autofree gchar *ledger_path = NULL;
+  const guint64 hour = 60 * 60;
+  const guint64 day_secs = 1000 * 24 * hour;
+  guint64 time_remaining_secs;
+  gboolean time_limit_enabled;
+
+  tmp_dir = g_dir_make_tmp ("malcontent-session-limits-XXXXXX", &local_error);
+  g_assert_no_error (local_error);
+  ledger_dir = g_build_filename (tmp_dir, "usage", NULL);
+  ledger_path = g_build_filename (ledger_dir, "1000", NULL);
+  ledger = mct_usage_ledger_new (ledger_path);
+
+  mct_session_limits_builder_set_daily_quota (&builder, 2 * hour);
+  limits = mct_session_limits_builder_end (&builder);
+
+  /* No usage has been recorded yet. */
+  g_assert_true (mct_session_limits_check_time_remaining_with_ledger (limits, usec (day_secs + 9 * hour),
+                                                                      ledger,
+                                                                      &time_remaining_secs,
+                                                                      &time_limit_enabled));
+  g_assert_cmpuint (time_remaining_secs, ==, 2 * hour);
+  g_assert_true (time_limit_enabled);
+
+  /* Spend an hour in a session. */
+  g_assert_true (mct_usage_ledger_record_session_start (ledger, usec (day_secs + 9 * hour), &local_error));
+  g_assert_no_error (local_error);
+  g_assert_true (mct_usage_ledger_record_session_end (ledger, usec (day_secs + 10 * hour), &local_error));
+  g_assert_no_error (local_error);
+
+  g_assert_true (mct_session_limits_check_time_remaining_with_ledger (limits, usec (day_secs + 15 * hour),
+                                                                      ledger,
+                                                                      &time_remaining_secs,
+                                                                      &time_limit_enabled));
+  g_assert_cmpuint (time_remaining_secs, ==, hour);
+  g_assert_true (time_limit_enabled);
+
+  /* Break the ledger by replacing it with a directory. The quota must not
+   * be lifted. */
+  g_assert_cmpint (g_unlink (ledger_path), ==, 0);
+  g_assert_cmpint (g_mkdir (ledger_path, 0755), ==, 0);
+
+  g_test_expect_message (NULL, G_LOG_LEVEL_WARNING, "Error getting usage for user *");
+  g_assert_false (mct_session_limits_check_time_remaining_with_ledger (limits, usec (day_secs + 15 * hour),
+                                                                       ledger,
+                                                                       &time_remaining_secs,
+                                                                       &time_limit_enabled));
+  g_test_assert_expected_messages ();
+  g_assert_cmpuint (time_remaining_secs, ==, 0);
+  g_assert_true (time_limit_enabled);
+
+  /* The ledger isn’t read for other types of limit. */
+  g_clear_pointer (&limits, mct_session_limits_unref);
+  mct_session_limits_builder_set_daily_schedule (&builder, 0, 24 * hour);
+  limits = mct_session_limits_builder_end (&builder);
+
+  g_assert_true (mct_session_limits_check_time_remaining_with_ledger (limits, usec (day_secs + 15 * hour),
+                                                                      ledger, NULL, NULL));
+
+  g_rmdir (ledger_path);
+  g_rmdir (ledger_dir);
+  g_rmdir (tmp_dir);
+}
+
+/* Test that a daily quota survives a round trip through
+ * mct_session_limits_serialize() and mct_session_limits_deserialize(). */
+static void
+test_session_limits_serialize_daily_quota (void)
+{
+  g_auto(MctSessionLimitsBuilder) builder = MCT_SESSION_LIMITS_BUILDER_INIT ();
+  g_autoptr(MctSessionLimits) limits = NULL;
+  g_autoptr(MctSessionLimits) deserialized = NULL;
+  g_autoptr(GVariant) serialized = NULL;
+  g_autoptr(GError) local_error = NULL;
+  guint32 limit_type, daily_quota_secs;
+  guint64 time_remaining_secs;
+
+  mct_session_limits_builder_set_daily_quota (&builder, 90 * 60);
+  limits = mct_session_limits_builder_end (&builder);
+  serialized = g_variant_ref_sink (mct_session_limits_serialize (limits));
+
+  g_assert_true (g_variant_lookup (serialized, "LimitType", "u", &limit_type));
+  g_assert_cmpuint (limit_type, ==, 3);
+  g_assert_true (g_variant_lookup (serialized, "DailyQuota", "u", &daily_quota_secs));
+  g_assert_cmpuint (daily_quota_secs, ==, 90 * 60);
+
+  deserialized = mct_session_limits_deserialize (serialized, 1, &local_error);
+  g_assert_no_error (local_error);
+
+  g_assert_true (mct_session_limits_check_time_remaining_with_usage (deserialized, usec (0), 30 * 60,
+                                                                     &time_remaining_secs, NULL));
+  g_assert_cmpuint (time_remaining_secs, ==, 60 * 60);
+}
+
+/* Test that mct_session_limits_equal() and mct_session_limits_get_digest()
+ * compare the policy in session limits, regardless of how they were built. */
+static void
+test_session_limits_equal (void)
+{
+  g_auto(MctSessionLimitsBuilder) builder = MCT_SESSION_LIMITS_BUILDER_INIT ();
+  g_autoptr(MctSessionLimits) none = NULL;
+  g_autoptr(MctSessionLimits) daily = NULL;
+  g_autoptr(MctSessionLimits) daily2 = NULL;
+  g_autoptr(MctSessionLimits) daily_other = NULL;
+  g_autoptr(MctSessionLimits) weekly = NULL;
+  g_autoptr(MctSessionLimits) weekly2 = NULL;
+  g_autoptr(MctSessionLimits) quota = NULL;
+  g_autoptr(MctSessionLimits) quota_other = NULL;
+  g_autoptr(MctSessionLimits) deserialized_none = NULL;
+  g_autoptr(MctSessionLimits) deserialized_daily = NULL;
+  g_autoptr(MctSessionLimits) deserialized_daily2 = NULL;
+  g_autoptr(GVariant) serialized_none = NULL;
+  g_autoptr(GVariant) serialized_daily = NULL;
+  g_autoptr(GError) local_error = NULL;
+  const gchar *digest;
+  const guint hour = 60 * 60;
+
+  none = mct_session_limits_builder_end (&builder);
+
+  mct_session_limits_builder_set_daily_schedule (&builder, 100, 8000);
+  daily = mct_session_limits_builder_end (&builder);
+  mct_session_limits_builder_set_daily_schedule (&builder, 100, 8000);
+  daily2 = mct_session_limits_builder_end (&builder);
+  mct_session_limits_builder_set_daily_schedule (&builder, 100, 8001);
+  daily_other = mct_session_limits_builder_end (&builder);
+
+  /* The same intervals as build_weekly_schedule(), merged and in a different
+   * order. */
+  weekly = build_weekly_schedule ();
+  mct_session_limits_builder_set_weekly_schedule (&builder);
+  mct_session_limits_builder_add_weekly_interval (&builder, G_DATE_SUNDAY, 22 * hour, 24 * hour);
+  mct_session_limits_builder_add_weekly_interval (&builder, G_DATE_SATURDAY, 10 * hour, 18 * hour);
+  mct_session_limits_builder_add_weekly_interval (&builder, G_DATE_MONDAY, 13 * hour, 15 * hour);
+  mct_session_limits_builder_add_weekly_interval (&builder, G_DATE_MONDAY, 9 * hour, 12 * hour + 30 * 60);
+  mct_session_limits_builder_add_weekly_interval (&builder, G_DATE_MONDAY, 0, 2 * hour);
+  weekly2 = mct_session_limits_builder_end (&builder);
+
+  mct_session_limits_builder_set_daily_quota (&builder, hour);
+  quota = mct_session_limits_builder_end (&builder);
+  mct_session_limits_builder_set_daily_quota (&builder, hour + 1);
+  quota_other = mct_session_limits_builder_end (&builder);
+
+  /* The digest is cached. */
+  digest = mct_session_limits_get_digest (daily);
+  g_assert_cmpuint (strlen (digest), ==, 64);
+  g_assert_true (mct_session_limits_get_digest (daily) == digest);
+
+  g_assert_true (mct_session_limits_equal (daily, daily));
+  g_assert_true (mct_session_limits_equal (daily, daily2));
+  g_assert_cmpstr (mct_session_limits_get_digest (daily), ==, mct_session_limits_get_digest (daily2));
+  g_assert_false (mct_session_limits_equal (daily, daily_other));
+  g_assert_true (mct_session_limits_equal (weekly, weekly2));
+  g_assert_false (mct_session_limits_equal (quota, quota_other));
+  g_assert_false (mct_session_limits_equal (none, daily));
+  g_assert_false (mct_session_limits_equal (daily, weekly));
+  g_assert_false (mct_session_limits_equal (quota, none));
+
+  /* Details of limit types which aren’t in use don’t matter. */
+  serialized_none = g_variant_ref_sink (g_variant_new_parsed ("{ 'LimitType': <@u 0>, "
+                                                              "'DailySchedule': <(@u 0, @u 100)>, "
+                                                              "'DailyQuota': <@u 60> }"));
+  deserialized_none = mct_session_limits_deserialize (serialized_none, 1, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_cmpstr (mct_session_limits_get_digest (deserialized_none), ==,
+                   mct_session_limits_get_digest (none));
+
+  /* Limits for different users have the same digest, but aren’t equal. */
+  serialized_daily = g_variant_ref_sink (mct_session_limits_serialize (daily));
+  deserialized_daily = mct_session_limits_deserialize (serialized_daily, 1, &local_error);
+  g_assert_no_error (local_error);
+  deserialized_daily2 = mct_session_limits_deserialize (serialized_daily, 1, &local_error);
+  g_assert_no_error (local_error);
+
+  g_assert_cmpstr (mct_session_limits_get_digest (deserialized_daily), ==,
+                   mct_session_limits_get_digest (daily));
+  g_assert_false (mct_session_limits_equal (deserialized_daily, daily));
+  g_assert_true (mct_session_limits_equal (deserialized_daily, deserialized_daily2));
+}
+
 /* Basic test of mct_session_limits_serialize() on session limits. */
 static void
 test_session_limits_serialize (void)
@@ -121,6 +1006,12 @@ test_session_limits_deserialize (void)
       "{ 'LimitType': <@u 0> }",
       "{ 'LimitType': <@u 1>, 'DailySchedule': <(@u 0, @u 100)> }",
       "{ 'DailySchedule': <(@u 0, @u 100)> }",
+      "{ 'LimitType': <@u 2>, 'WeeklySchedule': <[(@u 0, @u 100), (@u 50, @u 200)]> }",
+      "{ 'LimitType': <@u 2>, 'WeeklySchedule': <@a(uu) []> }",
+      "{ 'WeeklySchedule': <[(@u 0, @u 604800)]> }",
+      "{ 'LimitType': <@u 3>, 'DailyQuota': <@u 3600> }",
+      "{ 'LimitType': <@u 3> }",
+      "{ 'DailyQuota': <@u 0> }",
     };
 
   for (gsize i = 0; i < G_N_ELEMENTS (valid_session_limits); i++)
@@ -151,6 +1042,11 @@ test_session_limits_deserialize_invalid (void)
       "{ 'LimitType': <@u 100> }",
       "{ 'DailySchedule': <(@u 100, @u 0)> }",
       "{ 'DailySchedule': <(@u 0, @u 4294967295)> }",
+      "{ 'WeeklySchedule': <[(@u 100, @u 0)]> }",
+      "{ 'WeeklySchedule': <[(@u 0, @u 100), (@u 100, @u 100)]> }",
+      "{ 'LimitType': <@u 2>, 'WeeklySchedule': <[(@u 0, @u 604801)]> }",
+      "{ 'LimitType': <@u 4> }",
+      "{ 'LimitType': <@u 3>, 'DailyQuota': <@u 86401> }",
     };
 
   for (gsize i = 0; i < G_N_ELEMENTS (invalid_session_limits); i++)
@@ -346,6 +1242,81 @@ test_session_limits_builder_override_daily_schedule (void)
   g_assert_false (mct_session_limits_check_time_remaining (limits, usec (7 * 60 * 60 + 30 * 60), NULL, NULL));
 }
 
+/* Check that overriding an already-set limit in a #MctSessionLimitsBuilder
+ * removes all trace of it. In this test, override a ‘weekly schedule’ limit
+ * with a ‘daily schedule’ limit, and vice versa. */
+static void
+test_session_limits_builder_override_weekly_schedule (void)
+{
+  g_autoptr(MctSessionLimitsBuilder) builder = mct_session_limits_builder_new ();
+  g_autoptr(MctSessionLimitsBuilder) builder_copy = NULL;
+  g_autoptr(MctSessionLimits) limits = NULL;
+  g_autoptr(MctSessionLimits) limits_copy = NULL;
+  const guint64 day = 24 * 60 * 60;
+
+  /* 1970-01-01 was a Thursday. */
+  mct_session_limits_builder_set_weekly_schedule (builder);
+  mct_session_limits_builder_add_weekly_interval (builder, G_DATE_THURSDAY, 0, 100);
+  mct_session_limits_builder_set_daily_schedule (builder, 200, 7 * 60 * 60);
+  limits = mct_session_limits_builder_end (builder);
+
+  g_assert_false (mct_session_limits_check_time_remaining (limits, usec (50), NULL, NULL));
+  g_assert_true (mct_session_limits_check_time_remaining (limits, usec (day + 4 * 60 * 60), NULL, NULL));
+
+  /* Copying a weekly schedule copies its intervals. */
+  g_clear_pointer (&limits, mct_session_limits_unref);
+  mct_session_limits_builder_init (builder);
+  mct_session_limits_builder_set_daily_schedule (builder, 200, 7 * 60 * 60);
+  mct_session_limits_builder_set_weekly_schedule (builder);
+  mct_session_limits_builder_add_weekly_interval (builder, G_DATE_THURSDAY, 0, 100);
+  builder_copy = mct_session_limits_builder_copy (builder);
+  mct_session_limits_builder_add_weekly_interval (builder, G_DATE_FRIDAY, 0, 100);
+  limits = mct_session_limits_builder_end (builder);
+  limits_copy = mct_session_limits_builder_end (builder_copy);
+
+  g_assert_true (mct_session_limits_check_time_remaining (limits, usec (50), NULL, NULL));
+  g_assert_false (mct_session_limits_check_time_remaining (limits, usec (4 * 60 * 60), NULL, NULL));
+  g_assert_true (mct_session_limits_check_time_remaining (limits, usec (day + 50), NULL, NULL));
+  g_assert_true (mct_session_limits_check_time_remaining (limits_copy, usec (50), NULL, NULL));
+  g_assert_false (mct_session_limits_check_time_remaining (limits_copy, usec (day + 50), NULL, NULL));
+}
+
+/* Check that overriding an already-set limit in a #MctSessionLimitsBuilder
+ * removes all trace of it. In this test, override a ‘daily quota’ limit with a
+ * ‘daily schedule’ limit, and vice versa. */
+static void
+test_session_limits_builder_override_daily_quota (void)
+{
+  g_autoptr(MctSessionLimitsBuilder) builder = mct_session_limits_builder_new ();
+  g_autoptr(MctSessionLimitsBuilder) builder_copy = NULL;
+  g_autoptr(MctSessionLimits) limits = NULL;
+  g_autoptr(MctSessionLimits) limits_copy = NULL;
+  guint64 time_remaining_secs;
+
+  mct_session_limits_builder_set_daily_quota (builder, 0);
+  mct_session_limits_builder_set_daily_schedule (builder, 200, 7 * 60 * 60);
+  limits = mct_session_limits_builder_end (builder);
+
+  g_assert_false (mct_session_limits_check_time_remaining (limits, usec (150), NULL, NULL));
+  g_assert_true (mct_session_limits_check_time_remaining (limits, usec (4 * 60 * 60), NULL, NULL));
+
+  /* Copying a daily quota copies the quota. */
+  g_clear_pointer (&limits, mct_session_limits_unref);
+  mct_session_limits_builder_init (builder);
+  mct_session_limits_builder_set_daily_schedule (builder, 200, 7 * 60 * 60);
+  mct_session_limits_builder_set_daily_quota (builder, 60 * 60);
+  builder_copy = mct_session_limits_builder_copy (builder);
+  limits = mct_session_limits_builder_end (builder);
+  limits_copy = mct_session_limits_builder_end (builder_copy);
+
+  g_assert_true (mct_session_limits_check_time_remaining (limits, usec (150),
+                                                          &time_remaining_secs, NULL));
+  g_assert_cmpuint (time_remaining_secs, ==, 60 * 60);
+  g_assert_true (mct_session_limits_check_time_remaining (limits_copy, usec (150),
+                                                          &time_remaining_secs, NULL));
+  g_assert_cmpuint (time_remaining_secs, ==, 60 * 60);
+}
+
 /* Fixture for tests which interact with the accountsservice over D-Bus. The
  * D-Bus service is mocked up using @queue, which allows us to reply to D-Bus
  * calls from the code under test from within the test process.
@@ -856,6 +1827,10 @@ test_session_limits_bus_get_error_disabled (BusFixture    *fixture,
  * set on a mock User object, and compares their values to the given
  * `expected_*` ones.
  *
+ * Before setting them, mct_manager_set_session_limits() queries the current
+ * properties, which are returned from @current_properties. If that is %NULL,
+ * no properties are returned, as if the caller isn’t allowed to query them.
+ *
  * If @error_index is non-negative, it gives the index of a Set() call to return
  * the given @dbus_error_name and @dbus_error_message from, rather than
  * accepting the property value from the caller. If @error_index is negative,
@@ -867,6 +1842,7 @@ typedef struct
   const gchar * const *expected_properties;
 
   /* All GVariants in text format: */
+  const gchar *current_properties;  /* (nullable) */
   const gchar *expected_limit_type_value;  /* (nullable) */
   const gchar *expected_daily_schedule_value;  /* (nullable) */
 
@@ -894,7 +1870,9 @@ set_session_limits_server_cb (GtDBusQueue *queue,
 {
   const SetSessionLimitsData *data = user_data;
   g_autoptr(GDBusMethodInvocation) find_invocation = NULL;
+  g_autoptr(GDBusMethodInvocation) get_invocation = NULL;
   g_autofree gchar *object_path = NULL;
+  g_autoptr(GVariant) current_properties_variant = NULL;
 
   g_assert ((data->error_index == -1) == (data->dbus_error_name == NULL));
   g_assert ((data->dbus_error_name == NULL) == (data->dbus_error_message == NULL));
@@ -911,6 +1889,22 @@ set_session_limits_server_cb (GtDBusQueue *queue,
   object_path = g_strdup_printf ("/org/freedesktop/Accounts/User%u", (uid_t) user_id);
   g_dbus_method_invocation_return_value (find_invocation, g_variant_new ("(o)", object_path));
 
+  /* Handle the Properties.GetAll() call to query the current properties. */
+  const gchar *get_property_interface;
+  get_invocation =
+      gt_dbus_queue_assert_pop_message (queue,
+                                        object_path,
+                                        "org.freedesktop.DBus.Properties",
+                                        "GetAll", "(&s)", &get_property_interface);
+  g_assert_cmpstr (get_property_interface, ==, "com.endlessm.ParentalControls.SessionLimits");
+
+  if (data->current_properties != NULL)
+    current_properties_variant = g_variant_ref_sink (g_variant_new_parsed (data->current_properties));
+  else
+    current_properties_variant = g_variant_ref_sink (g_variant_new_parsed ("@a{sv} {}"));
+  g_dbus_method_invocation_return_value (get_invocation,
+                                         g_variant_new_tuple (&current_properties_variant, 1));
+
   /* Handle the Properties.Set() calls. */
   gsize i;
 
@@ -1013,6 +2007,108 @@ test_session_limits_bus_set (BusFixture    *fixture,
   g_assert_true (success);
 }
 
+/* Test that mct_manager_set_session_limits() doesn’t save session limits
+ * which are the same as the user’s current ones, but does save them if the
+ * user’s limits have been changed by something else since they were loaded.
+ *
+ * The mock D-Bus replies are generated in get_session_limits_server_cb() and
+ * set_session_limits_server_cb(), which are called inline. */
+static void
+test_session_limits_bus_set_unchanged (BusFixture    *fixture,
+                                       gconstpointer  test_data)
+{
+  gboolean success;
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(MctSessionLimits) loaded_limits = NULL;
+  g_autoptr(GError) local_error = NULL;
+  const gchar *loaded_properties = "{"
+    "'LimitType': <@u 1>,"
+    "'DailySchedule': <(@u 100, @u 8000)>,"
+    "'DailyQuota': <@u 86400>"
+  "}";
+  const GetSessionLimitsData get_session_limits_data =
+    {
+      .expected_uid = fixture->valid_uid,
+      .properties = loaded_properties,
+    };
+  const gchar *no_properties[] = { NULL };
+  const SetSessionLimitsData unchanged_data =
+    {
+      .expected_uid = fixture->valid_uid,
+      .expected_properties = no_properties,
+      .current_properties = loaded_properties,
+      .error_index = -1,
+    };
+  const gchar *expected_properties[] =
+    {
+      "DailySchedule",
+      "LimitType",
+      NULL
+    };
+  const SetSessionLimitsData changed_data =
+    {
+      .expected_uid = fixture->valid_uid,
+      .expected_properties = expected_properties,
+      .current_properties = "{"
+        "'LimitType': <@u 1>,"
+        "'DailySchedule': <(@u 100, @u 4000)>,"
+        "'DailyQuota': <@u 86400>"
+      "}",
+      .expected_limit_type_value = "@u 1",
+      .expected_daily_schedule_value = "(@u 100, @u 8000)",
+      .error_index = -1,
+    };
+
+  /* Load the user’s limits. */
+  mct_manager_get_session_limits_async (fixture->manager,
+                                        fixture->valid_uid,
+                                        MCT_MANAGER_GET_VALUE_FLAGS_NONE, NULL,
+                                        async_result_cb, &result);
+  get_session_limits_server_cb (fixture->queue, (gpointer) &get_session_limits_data);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+  loaded_limits = mct_manager_get_session_limits_finish (fixture->manager, result,
+                                                         &local_error);
+  g_assert_no_error (local_error);
+  g_assert_nonnull (loaded_limits);
+  g_clear_object (&result);
+
+  /* Saving them again without changes only queries the current limits. */
+  mct_manager_set_session_limits_async (fixture->manager,
+                                        fixture->valid_uid, loaded_limits,
+                                        MCT_MANAGER_SET_VALUE_FLAGS_INTERACTIVE, NULL,
+                                        async_result_cb, &result);
+  set_session_limits_server_cb (fixture->queue, (gpointer) &unchanged_data);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+  success = mct_manager_set_session_limits_finish (fixture->manager, result,
+                                                   &local_error);
+  g_assert_no_error (local_error);
+  g_assert_true (success);
+  g_clear_object (&result);
+
+  gt_dbus_queue_assert_no_messages (fixture->queue);
+
+  /* If the limits are changed by something else, saving the loaded ones again
+   * changes them back. */
+  mct_manager_set_session_limits_async (fixture->manager,
+                                        fixture->valid_uid, loaded_limits,
+                                        MCT_MANAGER_SET_VALUE_FLAGS_INTERACTIVE, NULL,
+                                        async_result_cb, &result);
+  set_session_limits_server_cb (fixture->queue, (gpointer) &changed_data);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+  success = mct_manager_set_session_limits_finish (fixture->manager, result,
+                                                   &local_error);
+  g_assert_no_error (local_error);
+  g_assert_true (success);
+
+  gt_dbus_queue_assert_no_messages (fixture->queue);
+}
+
 /* Test that mct_manager_set_session_limits() returns an appropriate error if
  * the mock D-Bus service reports that the given user cannot be found.
  *
@@ -1203,16 +2299,45 @@ main (int    argc,
       char **argv)
 {
   setlocale (LC_ALL, "");
+
+  /* Session limits are evaluated in the local time zone. Most of the tests
+   * assume it’s UTC; those which don’t set it themselves. */
+  g_setenv ("TZ", "UTC", TRUE);
+
   g_test_init (&argc, &argv, NULL);
 
   g_test_add_func ("/session-limits/types", test_session_limits_types);
   g_test_add_func ("/session-limits/refs", test_session_limits_refs);
+  g_test_add_func ("/session-limits/refs/threads", test_session_limits_refs_threads);
   g_test_add_func ("/session-limits/check-time-remaining/invalid-time",
                    test_session_limits_check_time_remaining_invalid_time);
+  g_test_add_func ("/session-limits/check-time-remaining/time-zone",
+                   test_session_limits_check_time_remaining_time_zone);
+  g_test_add_func ("/session-limits/check-time-remaining/dst",
+                   test_session_limits_check_time_remaining_dst);
+  g_test_add_func ("/session-limits/get-next-transition",
+                   test_session_limits_get_next_transition);
+  g_test_add_func ("/session-limits/get-next-transition/dst",
+                   test_session_limits_get_next_transition_dst);
+  g_test_add_func ("/session-limits/perf/check-time-remaining",
+                   test_session_limits_perf_check_time_remaining);
+  g_test_add_func ("/session-limits/check-time-remaining/weekly",
+                   test_session_limits_check_time_remaining_weekly);
+  g_test_add_func ("/session-limits/get-next-transition/weekly",
+                   test_session_limits_get_next_transition_weekly);
+  g_test_add_func ("/session-limits/perf/weekly-schedule",
+                   test_session_limits_perf_weekly_schedule);
+  g_test_add_func ("/session-limits/check-time-remaining/daily-quota",
+                   test_session_limits_check_time_remaining_daily_quota);
+  g_test_add_func ("/session-limits/check-time-remaining/daily-quota/ledger",
+                   test_session_limits_check_time_remaining_daily_quota_ledger);
 
   g_test_add_func ("/session-limits/serialize", test_session_limits_serialize);
+  g_test_add_func ("/session-limits/serialize/weekly", test_session_limits_serialize_weekly);
+  g_test_add_func ("/session-limits/serialize/daily-quota", test_session_limits_serialize_daily_quota);
   g_test_add_func ("/session-limits/deserialize", test_session_limits_deserialize);
   g_test_add_func ("/session-limits/deserialize/invalid", test_session_limits_deserialize_invalid);
+  g_test_add_func ("/session-limits/equal", test_session_limits_equal);
 
   g_test_add ("/session-limits/builder/stack/non-empty", BuilderFixture, NULL,
               builder_set_up_stack, test_session_limits_builder_non_empty,
@@ -1240,6 +2365,10 @@ main (int    argc,
                    test_session_limits_builder_override_none);
   g_test_add_func ("/session-limits/builder/override/daily-schedule",
                    test_session_limits_builder_override_daily_schedule);
+  g_test_add_func ("/session-limits/builder/override/weekly-schedule",
+                   test_session_limits_builder_override_weekly_schedule);
+  g_test_add_func ("/session-limits/builder/override/daily-quota",
+                   test_session_limits_builder_override_daily_quota);
 
   g_test_add ("/session-limits/bus/get/async", BusFixture, GUINT_TO_POINTER (TRUE),
               bus_set_up, test_session_limits_bus_get, bus_tear_down);
@@ -1264,6 +2393,8 @@ main (int    argc,
   g_test_add ("/session-limits/bus/set/sync", BusFixture, GUINT_TO_POINTER (FALSE),
               bus_set_up, test_session_limits_bus_set, bus_tear_down);
 
+  g_test_add ("/session-limits/bus/set/unchanged", BusFixture, NULL,
+              bus_set_up, test_session_limits_bus_set_unchanged, bus_tear_down);
   g_test_add ("/session-limits/bus/set/error/invalid-user", BusFixture, NULL,
               bus_set_up, test_session_limits_bus_set_error_invalid_user, bus_tear_down);
   g_test_add ("/session-limits/bus/set/error/permission-denied", BusFixture, NULL,
@@ -0,0 +1,453 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2020 Endless Mobile, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <libmalcontent/usage-ledger.h>
+#include <locale.h>
+#include <stdio.h>
+
+
+/* Helper function to convert a constant time in seconds to microseconds,
+ * avoiding issues with integer constants being too small for the multiplication
+ * by using explicit typing. */
+static guint64
+usec (guint64 sec)
+{
+  return sec * G_USEC_PER_SEC;
+}
+
+#define HOUR_SECS ((guint64) 60 * 60)
+#define DAY_SECS (24 * HOUR_SECS)
+
+/* Midnight at the start of an arbitrary day, in UTC (which the tests run in). */
+#define SOME_DAY (1000 * DAY_SECS)
+
+/* Arbitrary boot IDs, so the tests don’t depend on the current boot. */
+#define BOOT_ID_1 "1c5a9c2e-5f1b-4d3a-9b0e-2f6d8c4a7e11"
+#define BOOT_ID_2 "8e0d3b47-a2c6-4f19-8d5e-0b7c9a1f3e22"
+
+/* Fixture for tests which need a ledger on disk. The ledger file is in a
+ * subdirectory of @tmp_dir which doesn’t exist yet. @ledger is for the boot
+ * %BOOT_ID_1. */
+typedef struct
+{
+  gchar *tmp_dir;  /* (owned) */
+  gchar *ledger_dir;  /* (owned) */
+  gchar *ledger_path;  /* (owned) */
+  MctUsageLedger *ledger;  /* (owned) */
+} LedgerFixture;
+
+static void
+setup (LedgerFixture *fixture,
+       gconstpointer  test_data)
+{
+  g_autoptr(GError) local_error = NULL;
+
+  fixture->tmp_dir = g_dir_make_tmp ("malcontent-usage-ledger-XXXXXX", &local_error);
+  g_assert_no_error (local_error);
+
+  fixture->ledger_dir = g_build_filename (fixture->tmp_dir, "usage", NULL);
+  fixture->ledger_path = g_build_filename (fixture->ledger_dir, "1000", NULL);
+  fixture->ledger = g_object_new (MCT_TYPE_USAGE_LEDGER,
+                                  "path", fixture->ledger_path,
+                                  "boot-id", BOOT_ID_1,
+                                  NULL);
+}
+
+static void
+teardown (LedgerFixture *fixture,
+          gconstpointer  test_data)
+{
+  g_clear_object (&fixture->ledger);
+
+  g_unlink (fixture->ledger_path);
+  g_rmdir (fixture->ledger_dir);
+  g_rmdir (fixture->tmp_dir);
+
+  g_clear_pointer (&fixture->ledger_path, g_free);
+  g_clear_pointer (&fixture->ledger_dir, g_free);
+  g_clear_pointer (&fixture->tmp_dir, g_free);
+}
+
+static void
+record_session_start (MctUsageLedger *ledger,
+                      guint64         time_secs)
+{
+  g_autoptr(GError) local_error = NULL;
+
+  g_assert_true (mct_usage_ledger_record_session_start (ledger, usec (time_secs), &local_error));
+  g_assert_no_error (local_error);
+}
+
+static void
+record_session_end (MctUsageLedger *ledger,
+                    guint64         time_secs)
+{
+  g_autoptr(GError) local_error = NULL;
+
+  g_assert_true (mct_usage_ledger_record_session_end (ledger, usec (time_secs), &local_error));
+  g_assert_no_error (local_error);
+}
+
+static guint64
+get_usage (MctUsageLedger *ledger,
+           guint64         time_secs)
+{
+  g_autoptr(GError) local_error = NULL;
+  guint64 usage_secs = 0;
+
+  g_assert_true (mct_usage_ledger_get_usage (ledger, usec (time_secs), &usage_secs, &local_error));
+  g_assert_no_error (local_error);
+
+  return usage_secs;
+}
+
+/* Test that the #GType definitions for various types work. */
+static void
+test_usage_ledger_types (void)
+{
+  g_type_ensure (mct_usage_ledger_get_type ());
+}
+
+/* Test that the properties of an #MctUsageLedger work. */
+static void
+test_usage_ledger_properties (void)
+{
+  g_autoptr(MctUsageLedger) ledger = NULL;
+  g_autoptr(MctUsageLedger) user_ledger = NULL;
+  g_autoptr(MctUsageLedger) boot_ledger = NULL;
+  g_autofree gchar *path_prop = NULL;
+  g_autofree gchar *boot_id_prop = NULL;
+  g_autofree gchar *user_ledger_basename = NULL;
+
+  ledger = mct_usage_ledger_new ("/nonexistent/ledger");
+  g_assert_cmpstr (mct_usage_ledger_get_path (ledger), ==, "/nonexistent/ledger");
+
+  g_object_get (ledger, "path", &path_prop, NULL);
+  g_assert_cmpstr (path_prop, ==, "/nonexistent/ledger");
+
+  user_ledger = mct_usage_ledger_new_for_user (1000);
+  user_ledger_basename = g_path_get_basename (mct_usage_ledger_get_path (user_ledger));
+  g_assert_cmpstr (user_ledger_basename, ==, "1000");
+
+  /* The boot ID defaults to the current one, if it’s known. */
+  if (mct_usage_ledger_get_boot_id (ledger) != NULL)
+    g_assert_true (g_uuid_string_is_valid (mct_usage_ledger_get_boot_id (ledger)));
+
+  boot_ledger = g_object_new (MCT_TYPE_USAGE_LEDGER,
+                              "path", "/nonexistent/ledger",
+                              "boot-id", BOOT_ID_1,
+                              NULL);
+  g_assert_cmpstr (mct_usage_ledger_get_boot_id (boot_ledger), ==, BOOT_ID_1);
+
+  g_object_get (boot_ledger, "boot-id", &boot_id_prop, NULL);
+  g_assert_cmpstr (boot_id_prop, ==, BOOT_ID_1);
+}
+
+/* Test that a ledger which doesn’t exist yet has no usage. */
+static void
+test_usage_ledger_empty (LedgerFixture *fixture,
+                         gconstpointer  test_data)
+{
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY), ==, 0);
+  g_assert_false (g_file_test (fixture->ledger_path, G_FILE_TEST_EXISTS));
+}
+
+/* Test that usage accumulates across sessions on the same day, including the
+ * session which is currently active. */
+static void
+test_usage_ledger_sessions (LedgerFixture *fixture,
+                            gconstpointer  test_data)
+{
+  record_session_start (fixture->ledger, SOME_DAY + 9 * HOUR_SECS);
+  g_assert_true (g_file_test (fixture->ledger_path, G_FILE_TEST_EXISTS));
+
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + 9 * HOUR_SECS), ==, 0);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + 9 * HOUR_SECS + 1800), ==, 1800);
+
+  record_session_end (fixture->ledger, SOME_DAY + 10 * HOUR_SECS);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + 10 * HOUR_SECS), ==, HOUR_SECS);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + 15 * HOUR_SECS), ==, HOUR_SECS);
+
+  record_session_start (fixture->ledger, SOME_DAY + 16 * HOUR_SECS);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + 16 * HOUR_SECS + 60), ==, HOUR_SECS + 60);
+
+  record_session_end (fixture->ledger, SOME_DAY + 17 * HOUR_SECS);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + 20 * HOUR_SECS), ==, 2 * HOUR_SECS);
+
+  /* The total is reset the next day. */
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + DAY_SECS), ==, 0);
+
+  /* Ending a session when none are active is ignored. */
+  record_session_end (fixture->ledger, SOME_DAY + 21 * HOUR_SECS);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + 22 * HOUR_SECS), ==, 2 * HOUR_SECS);
+}
+
+/* Test that time spent in concurrent sessions is only counted once. */
+static void
+test_usage_ledger_concurrent_sessions (LedgerFixture *fixture,
+                                       gconstpointer  test_data)
+{
+  record_session_start (fixture->ledger, SOME_DAY + 9 * HOUR_SECS);
+  record_session_start (fixture->ledger, SOME_DAY + 9 * HOUR_SECS + 600);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + 9 * HOUR_SECS + 1200), ==, 1200);
+
+  record_session_end (fixture->ledger, SOME_DAY + 10 * HOUR_SECS);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + 11 * HOUR_SECS), ==, 2 * HOUR_SECS);
+
+  record_session_end (fixture->ledger, SOME_DAY + 11 * HOUR_SECS);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + 12 * HOUR_SECS), ==, 2 * HOUR_SECS);
+}
+
+/* Test that a session which is active over midnight is counted from midnight
+ * on the new day. */
+static void
+test_usage_ledger_midnight (LedgerFixture *fixture,
+                            gconstpointer  test_data)
+{
+  record_session_start (fixture->ledger, SOME_DAY - HOUR_SECS);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY - 1), ==, HOUR_SECS - 1);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY), ==, 0);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + 600), ==, 600);
+
+  record_session_end (fixture->ledger, SOME_DAY + 1200);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + HOUR_SECS), ==, 1200);
+}
+
+/* Test that a session which was never ended stops being counted once the
+ * computer is restarted, rather than being counted forever. */
+static void
+test_usage_ledger_reboot (LedgerFixture *fixture,
+                          gconstpointer  test_data)
+{
+  g_autoptr(MctUsageLedger) rebooted_ledger = NULL;
+
+  /* A session starts, and the computer loses power before it ends. */
+  record_session_start (fixture->ledger, SOME_DAY + 9 * HOUR_SECS);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + 10 * HOUR_SECS), ==, HOUR_SECS);
+
+  /* After a restart, the session is no longer counted. Its usage up to its
+   * start is all that’s known. */
+  rebooted_ledger = g_object_new (MCT_TYPE_USAGE_LEDGER,
+                                  "path", fixture->ledger_path,
+                                  "boot-id", BOOT_ID_2,
+                                  NULL);
+  g_assert_cmpuint (get_usage (rebooted_ledger, SOME_DAY + 11 * HOUR_SECS), ==, 0);
+
+  /* A new session is counted normally, and when it ends, no sessions are
+   * active. */
+  record_session_start (rebooted_ledger, SOME_DAY + 12 * HOUR_SECS);
+  g_assert_cmpuint (get_usage (rebooted_ledger, SOME_DAY + 12 * HOUR_SECS + 600), ==, 600);
+
+  record_session_end (rebooted_ledger, SOME_DAY + 13 * HOUR_SECS);
+  g_assert_cmpuint (get_usage (rebooted_ledger, SOME_DAY + 14 * HOUR_SECS), ==, HOUR_SECS);
+  g_assert_cmpuint (get_usage (rebooted_ledger, SOME_DAY + 20 * HOUR_SECS), ==, HOUR_SECS);
+
+  /* The same happens the next day. */
+  record_session_start (rebooted_ledger, SOME_DAY + DAY_SECS + 9 * HOUR_SECS);
+  record_session_end (rebooted_ledger, SOME_DAY + DAY_SECS + 10 * HOUR_SECS);
+  g_assert_cmpuint (get_usage (rebooted_ledger, SOME_DAY + DAY_SECS + 20 * HOUR_SECS), ==, HOUR_SECS);
+}
+
+/* Test that a partial record left by an interrupted append is ignored, and is
+ * overwritten by the next append. */
+static void
+test_usage_ledger_partial_record (LedgerFixture *fixture,
+                                  gconstpointer  test_data)
+{
+  FILE *file;
+
+  record_session_start (fixture->ledger, SOME_DAY + 9 * HOUR_SECS);
+
+  file = fopen (fixture->ledger_path, "ab");
+  g_assert_nonnull (file);
+  g_assert_cmpuint (fwrite ("\xff\xff\xff\xff\xff", 1, 5, file), ==, 5);
+  g_assert_cmpint (fclose (file), ==, 0);
+
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + 10 * HOUR_SECS), ==, HOUR_SECS);
+
+  record_session_end (fixture->ledger, SOME_DAY + 10 * HOUR_SECS);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + 11 * HOUR_SECS), ==, HOUR_SECS);
+}
+
+/* Get the size of the file at @path, in bytes. */
+static goffset
+get_file_size (const gchar *path)
+{
+  GStatBuf statbuf;
+
+  g_assert_cmpint (g_stat (path, &statbuf), ==, 0);
+
+  return statbuf.st_size;
+}
+
+/* Test that the first record on a new day replaces the records from previous
+ * days, without losing any state which is still needed. */
+static void
+test_usage_ledger_compaction (LedgerFixture *fixture,
+                              gconstpointer  test_data)
+{
+  goffset record_size;
+
+  record_session_start (fixture->ledger, SOME_DAY + 9 * HOUR_SECS);
+  record_size = get_file_size (fixture->ledger_path);
+  g_assert_cmpint (record_size, >, 0);
+
+  record_session_end (fixture->ledger, SOME_DAY + 10 * HOUR_SECS);
+  record_session_start (fixture->ledger, SOME_DAY + 23 * HOUR_SECS);
+  g_assert_cmpint (get_file_size (fixture->ledger_path), ==, 3 * record_size);
+
+  /* The session active over midnight is still counted after compaction. */
+  record_session_start (fixture->ledger, SOME_DAY + DAY_SECS + HOUR_SECS);
+  g_assert_cmpint (get_file_size (fixture->ledger_path), ==, record_size);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + DAY_SECS + 2 * HOUR_SECS), ==, 2 * HOUR_SECS);
+
+  record_session_end (fixture->ledger, SOME_DAY + DAY_SECS + 3 * HOUR_SECS);
+  record_session_end (fixture->ledger, SOME_DAY + DAY_SECS + 4 * HOUR_SECS);
+  g_assert_cmpint (get_file_size (fixture->ledger_path), ==, 3 * record_size);
+  g_assert_cmpuint (get_usage (fixture->ledger, SOME_DAY + DAY_SECS + 5 * HOUR_SECS), ==, 4 * HOUR_SECS);
+}
+
+/* Test that the ledger, and the directory it’s in, are only accessible by
+ * their owner, as they record when the user logs in and out. */
+static void
+test_usage_ledger_permissions (LedgerFixture *fixture,
+                               gconstpointer  test_data)
+{
+  GStatBuf statbuf;
+
+  record_session_start (fixture->ledger, SOME_DAY + 9 * HOUR_SECS);
+
+  g_assert_cmpint (g_stat (fixture->ledger_dir, &statbuf), ==, 0);
+  g_assert_cmpint (statbuf.st_mode & 0777, ==, 0700);
+  g_assert_cmpint (g_stat (fixture->ledger_path, &statbuf), ==, 0);
+  g_assert_cmpint (statbuf.st_mode & 0777, ==, 0600);
+}
+
+/* Test that errors accessing the ledger are reported. */
+static void
+test_usage_ledger_error (LedgerFixture *fixture,
+                         gconstpointer  test_data)
+{
+  g_autoptr(GError) local_error = NULL;
+  guint64 usage_secs;
+
+  /* Make the ledger path a directory. */
+  g_assert_cmpint (g_mkdir_with_parents (fixture->ledger_path, 0755), ==, 0);
+
+  g_assert_false (mct_usage_ledger_record_session_start (fixture->ledger, usec (SOME_DAY),
+                                                         &local_error));
+  g_assert_error (local_error, G_IO_ERROR, G_IO_ERROR_IS_DIRECTORY);
+  g_clear_error (&local_error);
+
+  g_rmdir (fixture->ledger_path);
+  g_assert_cmpint (g_mkdir_with_parents (fixture->ledger_dir, 0755), ==, 0);
+  g_assert_true (g_file_set_contents (fixture->ledger_path, "", 0, NULL));
+  g_assert_cmpint (g_chmod (fixture->ledger_path, 0), ==, 0);
+
+  /* Root can read the file regardless of its permissions. */
+  if (mct_usage_ledger_get_usage (fixture->ledger, usec (SOME_DAY), &usage_secs, &local_error))
+    {
+      g_test_skip ("Test can’t be run as root");
+      return;
+    }
+
+  g_assert_error (local_error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED);
+}
+
+/* Test the performance of getting the usage from ledgers with varying amounts
+ * of history. Lookups should take constant time. */
+static void
+test_usage_ledger_perf_get_usage (LedgerFixture *fixture,
+                                  gconstpointer  test_data)
+{
+  const guint n_sessions[] = { 1, 100, 10000 };
+  guint n_recorded_sessions = 0;
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Performance tests not enabled");
+      return;
+    }
+
+  for (gsize i = 0; i < G_N_ELEMENTS (n_sessions); i++)
+    {
+      g_autoptr(GTimer) timer = NULL;
+      const guint n_iterations = 10000;
+      gdouble elapsed_secs;
+
+      /* Record one session an hour. */
+      for (; n_recorded_sessions < n_sessions[i]; n_recorded_sessions++)
+        {
+          record_session_start (fixture->ledger, SOME_DAY + n_recorded_sessions * HOUR_SECS);
+          record_session_end (fixture->ledger, SOME_DAY + n_recorded_sessions * HOUR_SECS + 1800);
+        }
+
+      timer = g_timer_new ();
+
+      for (guint j = 0; j < n_iterations; j++)
+        get_usage (fixture->ledger, SOME_DAY + n_recorded_sessions * HOUR_SECS);
+
+      elapsed_secs = g_timer_elapsed (timer, NULL);
+      g_test_minimized_result (elapsed_secs * 1e6 / n_iterations,
+                               "mct_usage_ledger_get_usage() with %u sessions: %.2f µs per call",
+                               n_sessions[i], elapsed_secs * 1e6 / n_iterations);
+    }
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  setlocale (LC_ALL, "");
+
+  /* Usage is totalled per day in the local time zone. */
+  g_setenv ("TZ", "UTC", TRUE);
+
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/usage-ledger/types", test_usage_ledger_types);
+  g_test_add_func ("/usage-ledger/properties", test_usage_ledger_properties);
+  g_test_add ("/usage-ledger/empty", LedgerFixture, NULL,
+              setup, test_usage_ledger_empty, teardown);
+  g_test_add ("/usage-ledger/sessions", LedgerFixture, NULL,
+              setup, test_usage_ledger_sessions, teardown);
+  g_test_add ("/usage-ledger/concurrent-sessions", LedgerFixture, NULL,
+              setup, test_usage_ledger_concurrent_sessions, teardown);
+  g_test_add ("/usage-ledger/midnight", LedgerFixture, NULL,
+              setup, test_usage_ledger_midnight, teardown);
+  g_test_add ("/usage-ledger/reboot", LedgerFixture, NULL,
+              setup, test_usage_ledger_reboot, teardown);
+  g_test_add ("/usage-ledger/partial-record", LedgerFixture, NULL,
+              setup, test_usage_ledger_partial_record, teardown);
+  g_test_add ("/usage-ledger/compaction", LedgerFixture, NULL,
+              setup, test_usage_ledger_compaction, teardown);
+  g_test_add ("/usage-ledger/permissions", LedgerFixture, NULL,
+              setup, test_usage_ledger_permissions, teardown);
+  g_test_add ("/usage-ledger/error", LedgerFixture, NULL,
+              setup, test_usage_ledger_error, teardown);
+  g_test_add ("/usage-ledger/perf/get-usage", LedgerFixture, NULL,
+              setup, test_usage_ledger_perf_get_usage, teardown);
+
+  return g_test_run ();
+}
@@ -0,0 +1,776 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2020 Endless Mobile, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <glib-object.h>
+#include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <libmalcontent/usage-ledger.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* Length of a boot ID in bytes, once parsed from its UUID form. */
+#define BOOT_ID_SIZE 16
+
+/* A record in a usage ledger, appended whenever a session starts or ends.
+ * @day_usage_secs is the total time spent in sessions on the local day
+ * containing @timestamp_secs, up to @timestamp_secs; and @n_active_sessions is
+ * the number of sessions active after it, during the boot identified by
+ * @boot_id. Concurrent sessions are only counted once.
+ *
+ * On disk, records are stored back to back with no header, each as
+ * %LEDGER_RECORD_SIZE bytes: @timestamp_secs as a 64-bit integer, followed by
+ * @day_usage_secs and @n_active_sessions as 32-bit unsigned integers, all
+ * little-endian, and then the %BOOT_ID_SIZE bytes of @boot_id. */
+typedef struct
+{
+  gint64 timestamp_secs;  /* seconds since the Unix epoch */
+  guint32 day_usage_secs;
+  guint32 n_active_sessions;
+  guint8 boot_id[BOOT_ID_SIZE];
+} LedgerRecord;
+
+#define LEDGER_RECORD_SIZE (16 + BOOT_ID_SIZE)
+
+/* Where the kernel exposes the ID of the current boot. */
+#define BOOT_ID_PATH "/proc/sys/kernel/random/boot_id"
+
+/**
+ * MctUsageLedger:
+ *
+ * #MctUsageLedger records how long a user spends in sessions, so that a daily
+ * quota can be enforced by
+ * mct_session_limits_check_time_remaining_with_ledger().
+ *
+ * The ledger is a file with a small record appended each time a session
+ * starts or ends. Each record carries the running total of usage for its day,
+ * so the usage so far today can be worked out from the last record alone,
+ * however long the ledger is. The totals are reset at midnight, local time.
+ * As only the last record is needed, the first record appended on a new day
+ * replaces all the records from previous days, so the ledger never holds more
+ * than a day’s worth of records.
+ *
+ * Appends from different processes are serialised with an advisory lock on
+ * the file, and a partial record left by an interrupted append is ignored and
+ * later overwritten. Each call to mct_usage_ledger_record_session_start()
+ * should be paired with a later call to mct_usage_ledger_record_session_end()
+ * for the same session. Each record is tagged with the ID of the boot it was
+ * made in (see #MctUsageLedger:boot-id), and sessions which were still active
+ * in a previous boot are treated as having ended at the last record of that
+ * boot; so if the computer crashes or loses power, a session which was never
+ * ended stops being counted once the computer restarts. A session which is
+ * never ended without the computer restarting is counted until it restarts.
+ *
+ * The ledger for each user is kept in a system directory by default (see
+ * mct_usage_ledger_new_for_user()). As the ledgers record when users log in
+ * and out, the directory is created with mode 0700 and the ledgers with mode
+ * 0600, so they are only accessible by the user which writes them — root,
+ * for `pam_malcontent.so`.
+ *
+ * Since: 0.11.0
+ */
+struct _MctUsageLedger
+{
+  GObject parent_instance;
+
+  gchar *path;  /* (owned) (not nullable) (type filename) */
+
+  /* ID of the current boot, as a UUID string in @boot_id_str (which is %NULL
+   * if it couldn’t be determined) and parsed into @boot_id (which is all zeros
+   * in that case). */
+  gchar *boot_id_str;  /* (owned) (nullable) */
+  guint8 boot_id[BOOT_ID_SIZE];
+};
+
+G_DEFINE_TYPE (MctUsageLedger, mct_usage_ledger, G_TYPE_OBJECT)
+
+typedef enum
+{
+  PROP_PATH = 1,
+  PROP_BOOT_ID,
+} MctUsageLedgerProperty;
+
+static GParamSpec *props[PROP_BOOT_ID + 1] = { NULL, };
+
+static void
+mct_usage_ledger_init (MctUsageLedger *self)
+{
+  /* Nothing to do here. */
+}
+
+static void
+mct_usage_ledger_get_property (GObject    *object,
+                               guint       property_id,
+                               GValue     *value,
+                               GParamSpec *spec)
+{
+  MctUsageLedger *self = MCT_USAGE_LEDGER (object);
+
+  switch ((MctUsageLedgerProperty) property_id)
+    {
+    case PROP_PATH:
+      g_value_set_string (value, self->path);
+      break;
+
+    case PROP_BOOT_ID:
+      g_value_set_string (value, self->boot_id_str);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, spec);
+      break;
+    }
+}
+
+static void
+mct_usage_ledger_set_property (GObject      *object,
+                               guint         property_id,
+                               const GValue *value,
+                               GParamSpec   *spec)
+{
+  MctUsageLedger *self = MCT_USAGE_LEDGER (object);
+
+  switch ((MctUsageLedgerProperty) property_id)
+    {
+    case PROP_PATH:
+      /* Construct only. */
+      g_assert (self->path == NULL);
+      self->path = g_value_dup_string (value);
+      break;
+
+    case PROP_BOOT_ID:
+      /* Construct only. */
+      g_assert (self->boot_id_str == NULL);
+      self->boot_id_str = g_value_dup_string (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, spec);
+      break;
+    }
+}
+
+/* Parse @str, a UUID in its usual string form, into @boot_id. If @str is not
+ * a valid UUID, %FALSE is returned. */
+static gboolean
+parse_boot_id (const gchar *str,
+               guint8       boot_id[BOOT_ID_SIZE])
+{
+  gsize i = 0;
+
+  if (!g_uuid_string_is_valid (str))
+    return FALSE;
+
+  for (const gchar *p = str; *p != '\0' && i < BOOT_ID_SIZE; p++)
+    {
+      if (*p == '-')
+        continue;
+
+      boot_id[i++] = (g_ascii_xdigit_value (p[0]) << 4) | g_ascii_xdigit_value (p[1]);
+      p++;
+    }
+
+  return (i == BOOT_ID_SIZE);
+}
+
+static void
+mct_usage_ledger_constructed (GObject *object)
+{
+  MctUsageLedger *self = MCT_USAGE_LEDGER (object);
+
+  /* Chain up. */
+  G_OBJECT_CLASS (mct_usage_ledger_parent_class)->constructed (object);
+
+  g_assert (self->path != NULL);
+
+  /* Default to the ID of the current boot. */
+  if (self->boot_id_str == NULL)
+    {
+      g_autoptr(GError) local_error = NULL;
+
+      if (g_file_get_contents (BOOT_ID_PATH, &self->boot_id_str, NULL, &local_error))
+        g_strstrip (self->boot_id_str);
+      else
+        g_debug ("%s: Error getting boot ID: %s", G_STRFUNC, local_error->message);
+    }
+
+  if (self->boot_id_str != NULL &&
+      !parse_boot_id (self->boot_id_str, self->boot_id))
+    {
+      g_warning ("%s: Invalid boot ID ‘%s’", G_STRFUNC, self->boot_id_str);
+      g_clear_pointer (&self->boot_id_str, g_free);
+      memset (self->boot_id, 0, sizeof (self->boot_id));
+    }
+}
+
+static void
+mct_usage_ledger_finalize (GObject *object)
+{
+  MctUsageLedger *self = MCT_USAGE_LEDGER (object);
+
+  g_clear_pointer (&self->path, g_free);
+  g_clear_pointer (&self->boot_id_str, g_free);
+
+  G_OBJECT_CLASS (mct_usage_ledger_parent_class)->finalize (object);
+}
+
+static void
+mct_usage_ledger_class_init (MctUsageLedgerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->constructed = mct_usage_ledger_constructed;
+  object_class->finalize = mct_usage_ledger_finalize;
+  object_class->get_property = mct_usage_ledger_get_property;
+  object_class->set_property = mct_usage_ledger_set_property;
+
+  /**
+   * MctUsageLedger:path: (type filename) (not nullable)
+   *
+   * Path to the file the ledger is stored in. It, and its parent directories,
+   * are created when the first session is recorded.
+   *
+   * Since: 0.11.0
+   */
+  props[PROP_PATH] = g_param_spec_string ("path",
+                                          "Path",
+                                          "Path to the file the ledger is stored in.",
+                                          NULL,
+                                          G_PARAM_READWRITE |
+                                          G_PARAM_CONSTRUCT_ONLY |
+                                          G_PARAM_STATIC_STRINGS);
+
+  /**
+   * MctUsageLedger:boot-id: (nullable)
+   *
+   * ID of the current boot of the computer, as a UUID string. Sessions which
+   * were recorded as active during a different boot are treated as having
+   * ended, as they can’t still be running.
+   *
+   * If not set at construction, this defaults to the ID from
+   * `/proc/sys/kernel/random/boot_id`. It is %NULL if that can’t be read, in
+   * which case all records are assumed to be from the current boot.
+   *
+   * Since: 0.11.0
+   */
+  props[PROP_BOOT_ID] = g_param_spec_string ("boot-id",
+                                             "Boot ID",
+                                             "ID of the current boot of the computer.",
+                                             NULL,
+                                             G_PARAM_READWRITE |
+                                             G_PARAM_CONSTRUCT_ONLY |
+                                             G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class,
+                                     G_N_ELEMENTS (props),
+                                     props);
+}
+
+/**
+ * mct_usage_ledger_new:
+ * @path: (type filename): path to the file to store the ledger in
+ *
+ * Create a new #MctUsageLedger stored in the file at @path. The file doesn’t
+ * need to exist yet.
+ *
+ * Returns: (transfer full): a new #MctUsageLedger
+ * Since: 0.11.0
+ */
+MctUsageLedger *
+mct_usage_ledger_new (const gchar *path)
+{
+  g_return_val_if_fail (path != NULL, NULL);
+
+  return g_object_new (MCT_TYPE_USAGE_LEDGER,
+                       "path", path,
+                       NULL);
+}
+
+/**
+ * mct_usage_ledger_new_for_user:
+ * @user_id: ID of the user to record usage for
+ *
+ * Create a new #MctUsageLedger for the user with ID @user_id, stored in the
+ * system directory for usage ledgers. This is the ledger which
+ * `pam_malcontent.so` records sessions in, and checks daily quotas against
+ * using mct_session_limits_check_time_remaining_with_ledger().
+ *
+ * Returns: (transfer full): a new #MctUsageLedger
+ * Since: 0.11.0
+ */
+MctUsageLedger *
+mct_usage_ledger_new_for_user (uid_t user_id)
+{
+  g_autofree gchar *filename = NULL;
+  g_autofree gchar *path = NULL;
+
+  filename = g_strdup_printf ("%u", (guint) user_id);
+  path = g_build_filename (USAGE_LEDGER_DIR, filename, NULL);
+
+  return mct_usage_ledger_new (path);
+}
+
+/**
+ * mct_usage_ledger_get_path:
+ * @self: an #MctUsageLedger
+ *
+ * Get the value of #MctUsageLedger:path.
+ *
+ * Returns: (type filename): path to the file the ledger is stored in
+ * Since: 0.11.0
+ */
+const gchar *
+mct_usage_ledger_get_path (MctUsageLedger *self)
+{
+  g_return_val_if_fail (MCT_IS_USAGE_LEDGER (self), NULL);
+
+  return self->path;
+}
+
+/**
+ * mct_usage_ledger_get_boot_id:
+ * @self: an #MctUsageLedger
+ *
+ * Get the value of #MctUsageLedger:boot-id.
+ *
+ * Returns: (nullable): ID of the current boot, or %NULL if unknown
+ * Since: 0.11.0
+ */
+const gchar *
+mct_usage_ledger_get_boot_id (MctUsageLedger *self)
+{
+  g_return_val_if_fail (MCT_IS_USAGE_LEDGER (self), NULL);
+
+  return self->boot_id_str;
+}
+
+static void
+set_error_from_errno (GError      **error,
+                      int           errsv,
+                      const gchar  *path)
+{
+  g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+               _("Error accessing usage ledger ‘%s’: %s"),
+               path, g_strerror (errsv));
+}
+
+/* Get the start of the local day containing @time_secs, in seconds since the
+ * Unix epoch. */
+static gint64
+local_day_start (gint64 time_secs)
+{
+  g_autoptr(GDateTime) date_time = NULL;
+  g_autoptr(GDateTime) day_start = NULL;
+
+  date_time = g_date_time_new_from_unix_local (time_secs);
+  if (date_time != NULL)
+    day_start = g_date_time_new_local (g_date_time_get_year (date_time),
+                                       g_date_time_get_month (date_time),
+                                       g_date_time_get_day_of_month (date_time),
+                                       0, 0, 0.0);
+
+  /* Times which can’t be represented are treated as the start of their day. */
+  return (day_start != NULL) ? g_date_time_to_unix (day_start) : time_secs;
+}
+
+/* Get the number of sessions which are active after @record, and still
+ * active in the boot identified by @boot_id. Sessions can’t outlive the boot
+ * they were started in, so if @record is from a different boot, its active
+ * sessions must have ended when the computer was shut down. */
+static guint32
+ledger_record_get_n_active_sessions (const LedgerRecord *record,
+                                     const guint8       *boot_id)
+{
+  if (memcmp (record->boot_id, boot_id, BOOT_ID_SIZE) != 0)
+    return 0;
+
+  return record->n_active_sessions;
+}
+
+/* Work out the usage on the local day containing @now_secs, continuing on from
+ * @last_record, which is the last record in the ledger (or %NULL if it is
+ * empty). @boot_id identifies the current boot. The time between a record from
+ * a previous boot and the end of that boot isn’t known, so isn’t counted. */
+static guint32
+ledger_record_get_usage (const LedgerRecord *last_record,
+                         const guint8       *boot_id,
+                         gint64              now_secs)
+{
+  gint64 day_start_secs, active_from_secs;
+  guint64 usage_secs;
+
+  if (last_record == NULL)
+    return 0;
+
+  day_start_secs = local_day_start (now_secs);
+
+  /* The running total is reset at the start of each day. */
+  usage_secs = (last_record->timestamp_secs >= day_start_secs) ? last_record->day_usage_secs : 0;
+
+  if (ledger_record_get_n_active_sessions (last_record, boot_id) > 0)
+    {
+      active_from_secs = MAX (last_record->timestamp_secs, day_start_secs);
+
+      /* Ignore the clock going backwards. */
+      if (now_secs > active_from_secs)
+        usage_secs += (guint64) (now_secs - active_from_secs);
+    }
+
+  return (guint32) MIN (usage_secs, G_MAXUINT32);
+}
+
+static void
+ledger_record_encode (const LedgerRecord *record,
+                      guint8             *data)
+{
+  guint64 timestamp_le = GUINT64_TO_LE ((guint64) record->timestamp_secs);
+  guint32 day_usage_le = GUINT32_TO_LE (record->day_usage_secs);
+  guint32 n_active_sessions_le = GUINT32_TO_LE (record->n_active_sessions);
+
+  memcpy (data, &timestamp_le, sizeof (timestamp_le));
+  memcpy (data + 8, &day_usage_le, sizeof (day_usage_le));
+  memcpy (data + 12, &n_active_sessions_le, sizeof (n_active_sessions_le));
+  memcpy (data + 16, record->boot_id, BOOT_ID_SIZE);
+}
+
+static void
+ledger_record_decode (const guint8 *data,
+                      LedgerRecord *record)
+{
+  guint64 timestamp_le;
+  guint32 day_usage_le, n_active_sessions_le;
+
+  memcpy (&timestamp_le, data, sizeof (timestamp_le));
+  memcpy (&day_usage_le, data + 8, sizeof (day_usage_le));
+  memcpy (&n_active_sessions_le, data + 12, sizeof (n_active_sessions_le));
+  memcpy (record->boot_id, data + 16, BOOT_ID_SIZE);
+
+  record->timestamp_secs = (gint64) GUINT64_FROM_LE (timestamp_le);
+  record->day_usage_secs = GUINT32_FROM_LE (day_usage_le);
+  record->n_active_sessions = GUINT32_FROM_LE (n_active_sessions_le);
+}
+
+/* Read the record at @offset in the ledger open as @fd into @record_out. If
+ * the ledger is shorter than that, errno is set to %EIO. On error, errno is
+ * set and %FALSE is returned. */
+static gboolean
+read_record (int           fd,
+             off_t         offset,
+             LedgerRecord *record_out)
+{
+  guint8 data[LEDGER_RECORD_SIZE];
+  ssize_t n_read;
+
+  do
+    n_read = pread (fd, data, sizeof (data), offset);
+  while (n_read < 0 && errno == EINTR);
+
+  if (n_read < 0)
+    return FALSE;
+  if (n_read != sizeof (data))
+    {
+      errno = EIO;
+      return FALSE;
+    }
+
+  ledger_record_decode (data, record_out);
+
+  return TRUE;
+}
+
+/* Read the last complete record in the ledger open as @fd into @record_out,
+ * setting @found_out to whether there was one. The length of the complete
+ * records in the ledger is returned in @records_size_out; anything after that
+ * is a partial record from an interrupted append. On error, errno is set and
+ * %FALSE is returned.
+ *
+ * If @fd isn’t locked, the ledger may be compacted between checking its size
+ * and reading the record, in which case the read comes up short and is
+ * retried. */
+static gboolean
+read_last_record (int           fd,
+                  LedgerRecord *record_out,
+                  gboolean     *found_out,
+                  off_t        *records_size_out)
+{
+  struct stat statbuf;
+  off_t records_size;
+  guint n_attempts = 0;
+
+  do
+    {
+      if (fstat (fd, &statbuf) != 0)
+        return FALSE;
+
+      records_size = statbuf.st_size - statbuf.st_size % LEDGER_RECORD_SIZE;
+      *records_size_out = records_size;
+      *found_out = (records_size > 0);
+
+      if (records_size == 0)
+        return TRUE;
+
+      if (read_record (fd, records_size - LEDGER_RECORD_SIZE, record_out))
+        return TRUE;
+    }
+  while (errno == EIO && ++n_attempts < 3);
+
+  return FALSE;
+}
+
+/* Append a record to the ledger open as @fd, which must be locked, for a
+ * change of @n_sessions_delta in the number of active sessions at @now_secs,
+ * during the boot identified by @boot_id. On error, errno is set and %FALSE is
+ * returned.
+ *
+ * If the ledger contains records from before the local day containing
+ * @now_secs, they are all replaced by the new record, which carries
+ * everything needed from them. Unlocked readers only ever read the last
+ * record, so the new record is written at the start of the ledger before the
+ * rest of it is truncated, and a reader sees either the old last record or
+ * the new one. */
+static gboolean
+append_record (int           fd,
+               const guint8 *boot_id,
+               gint64        now_secs,
+               gint          n_sessions_delta)
+{
+  LedgerRecord first_record, last_record, record;
+  gboolean found;
+  off_t records_size, offset;
+  guint8 data[LEDGER_RECORD_SIZE];
+  gsize n_written = 0;
+
+  if (!read_last_record (fd, &last_record, &found, &records_size))
+    return FALSE;
+
+  /* Append after the last complete record, overwriting any partial one.
+   * Compact the ledger if it has more than one record and the first is from
+   * a previous day; with a single record, overwriting it in place could
+   * give a reader a torn record, and there’s nothing to save anyway. */
+  offset = records_size;
+
+  if (records_size > LEDGER_RECORD_SIZE)
+    {
+      if (!read_record (fd, 0, &first_record))
+        return FALSE;
+
+      if (first_record.timestamp_secs < local_day_start (now_secs))
+        offset = 0;
+    }
+
+  record.timestamp_secs = now_secs;
+  record.day_usage_secs = ledger_record_get_usage (found ? &last_record : NULL, boot_id, now_secs);
+  record.n_active_sessions = found ? ledger_record_get_n_active_sessions (&last_record, boot_id) : 0;
+  memcpy (record.boot_id, boot_id, BOOT_ID_SIZE);
+
+  if (n_sessions_delta > 0 && record.n_active_sessions < G_MAXUINT32)
+    record.n_active_sessions++;
+  else if (n_sessions_delta < 0 && record.n_active_sessions > 0)
+    record.n_active_sessions--;
+
+  ledger_record_encode (&record, data);
+
+  while (n_written < sizeof (data))
+    {
+      ssize_t n = pwrite (fd, data + n_written, sizeof (data) - n_written, offset + n_written);
+
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0)
+        return FALSE;
+
+      n_written += n;
+    }
+
+  /* Drop any records from previous days, or the rest of a partial record. */
+  return (ftruncate (fd, offset + LEDGER_RECORD_SIZE) == 0);
+}
+
+static gboolean
+record_session_change (MctUsageLedger  *self,
+                       guint64          now_usecs,
+                       gint             n_sessions_delta,
+                       GError         **error)
+{
+  g_autofree gchar *dir = NULL;
+  int fd, errsv;
+  gboolean success;
+
+  /* The ledgers record when users log in and out, so keep them private. */
+  dir = g_path_get_dirname (self->path);
+  if (g_mkdir_with_parents (dir, 0700) != 0)
+    {
+      set_error_from_errno (error, errno, self->path);
+      return FALSE;
+    }
+
+  /* Records are written at explicit offsets, as the ledger is sometimes
+   * compacted, so don’t use %O_APPEND. */
+  fd = g_open (self->path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0)
+    {
+      set_error_from_errno (error, errno, self->path);
+      return FALSE;
+    }
+
+  /* Serialise appends from concurrent sessions, so each record continues on
+   * from the last. The lock is released when @fd is closed. */
+  do
+    success = (flock (fd, LOCK_EX) == 0);
+  while (!success && errno == EINTR);
+
+  if (success)
+    success = append_record (fd, self->boot_id, (gint64) (now_usecs / G_USEC_PER_SEC), n_sessions_delta);
+
+  errsv = errno;
+  g_close (fd, NULL);
+
+  if (!success)
+    {
+      set_error_from_errno (error, errsv, self->path);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * mct_usage_ledger_record_session_start:
+ * @self: an #MctUsageLedger
+ * @now_usecs: current time as microseconds since the Unix epoch (UTC),
+ *     typically queried using g_get_real_time()
+ * @error: return location for a #GError, or %NULL
+ *
+ * Record that a session started at @now_usecs. Usage is counted from then
+ * until the matching call to mct_usage_ledger_record_session_end(), or until
+ * the computer is restarted.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ * Since: 0.11.0
+ */
+gboolean
+mct_usage_ledger_record_session_start (MctUsageLedger  *self,
+                                       guint64          now_usecs,
+                                       GError         **error)
+{
+  g_return_val_if_fail (MCT_IS_USAGE_LEDGER (self), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  return record_session_change (self, now_usecs, 1, error);
+}
+
+/**
+ * mct_usage_ledger_record_session_end:
+ * @self: an #MctUsageLedger
+ * @now_usecs: current time as microseconds since the Unix epoch (UTC),
+ *     typically queried using g_get_real_time()
+ * @error: return location for a #GError, or %NULL
+ *
+ * Record that a session, previously recorded with
+ * mct_usage_ledger_record_session_start(), ended at @now_usecs.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ * Since: 0.11.0
+ */
+gboolean
+mct_usage_ledger_record_session_end (MctUsageLedger  *self,
+                                     guint64          now_usecs,
+                                     GError         **error)
+{
+  g_return_val_if_fail (MCT_IS_USAGE_LEDGER (self), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  return record_session_change (self, now_usecs, -1, error);
+}
+
+/**
+ * mct_usage_ledger_get_usage:
+ * @self: an #MctUsageLedger
+ * @now_usecs: current time as microseconds since the Unix epoch (UTC),
+ *     typically queried using g_get_real_time()
+ * @usage_secs_out: (out): return location for the number of seconds spent in
+ *     sessions so far today
+ * @error: return location for a #GError, or %NULL
+ *
+ * Get the time spent in sessions on the local day containing @now_usecs, up
+ * to @now_usecs, including any sessions which are still active. Time spent in
+ * concurrent sessions is only counted once.
+ *
+ * This only reads the last record in the ledger, so takes the same time
+ * however much history the ledger contains. If the ledger doesn’t exist yet,
+ * the usage is zero.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ * Since: 0.11.0
+ */
+gboolean
+mct_usage_ledger_get_usage (MctUsageLedger  *self,
+                            guint64          now_usecs,
+                            guint64         *usage_secs_out,
+                            GError         **error)
+{
+  LedgerRecord last_record;
+  gboolean found;
+  off_t records_size;
+  int fd, errsv;
+  gboolean success;
+
+  g_return_val_if_fail (MCT_IS_USAGE_LEDGER (self), FALSE);
+  g_return_val_if_fail (usage_secs_out != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  /* Reads don’t need the lock: only the last record is read, a partial one
+   * is ignored, and the read is retried if the ledger is compacted at the same
+   * time. */
+  fd = g_open (self->path, O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0 && errno == ENOENT)
+    {
+      *usage_secs_out = 0;
+      return TRUE;
+    }
+  else if (fd < 0)
+    {
+      set_error_from_errno (error, errno, self->path);
+      return FALSE;
+    }
+
+  success = read_last_record (fd, &last_record, &found, &records_size);
+  errsv = errno;
+  g_close (fd, NULL);
+
+  if (!success)
+    {
+      set_error_from_errno (error, errsv, self->path);
+      return FALSE;
+    }
+
+  *usage_secs_out = ledger_record_get_usage (found ? &last_record : NULL,
+                                             self->boot_id,
+                                             (gint64) (now_usecs / G_USEC_PER_SEC));
+
+  return TRUE;
+}
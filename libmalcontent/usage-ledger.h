@@ -0,0 +1,50 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2020 Endless Mobile, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib-object.h>
+#include <sys/types.h>
+
+G_BEGIN_DECLS
+
+#define MCT_TYPE_USAGE_LEDGER mct_usage_ledger_get_type ()
+G_DECLARE_FINAL_TYPE (MctUsageLedger, mct_usage_ledger, MCT, USAGE_LEDGER, GObject)
+
+MctUsageLedger *mct_usage_ledger_new          (const gchar *path);
+MctUsageLedger *mct_usage_ledger_new_for_user (uid_t        user_id);
+
+const gchar    *mct_usage_ledger_get_path     (MctUsageLedger *self);
+const gchar    *mct_usage_ledger_get_boot_id  (MctUsageLedger *self);
+
+gboolean        mct_usage_ledger_record_session_start (MctUsageLedger  *self,
+                                                       guint64          now_usecs,
+                                                       GError         **error);
+gboolean        mct_usage_ledger_record_session_end   (MctUsageLedger  *self,
+                                                       guint64          now_usecs,
+                                                       GError         **error);
+
+gboolean        mct_usage_ledger_get_usage            (MctUsageLedger  *self,
+                                                       guint64          now_usecs,
+                                                       guint64         *usage_secs_out,
+                                                       GError         **error);
+
+G_END_DECLS
@@ -23,6 +23,7 @@
 #include "config.h"
 
 #define PAM_SM_ACCOUNT
+#define PAM_SM_SESSION
 
 #include <glib.h>
 #include <glib/gi18n-lib.h>
@@ -38,7 +39,8 @@
  *
  * Here’s an example of a PAM file which uses `pam_malcontent.so`. Note
  * that `pam_malcontent.so` must be listed before `pam_systemd.so`, and it must
- * have type `account`.
+ * have type `account`. It may also have type `session`, to record how long the
+ * user spends in sessions so that daily quotas can be enforced.
  *
  * ```
  * auth     sufficient pam_unix.so nullok try_first_pass
@@ -55,6 +57,7 @@
  * -session optional   pam_keyinit.so revoke
  * -session optional   pam_loginuid.so
  * -session optional   pam_systemd.so
+ * -session optional   pam_malcontent.so
  * session  sufficient pam_unix.so
  * ```
 */
@@ -121,6 +124,7 @@ pam_sm_acct_mgmt (pam_handle_t  *handle,
   g_autoptr(GDBusConnection) connection = NULL;
   g_autoptr(MctManager) manager = NULL;
   g_autoptr(MctSessionLimits) limits = NULL;
+  g_autoptr(MctUsageLedger) ledger = NULL;
   g_autoptr(GError) local_error = NULL;
   g_autofree gchar *runtime_max_sec_str = NULL;
   guint64 now = g_get_real_time ();
@@ -175,9 +179,12 @@ pam_sm_acct_mgmt (pam_handle_t  *handle,
         }
     }
 
-  /* Check if there’s time left. */
-  if (!mct_session_limits_check_time_remaining (limits, now, &time_remaining_secs,
-                                                &time_limit_enabled))
+  /* Check if there’s time left, including what’s left of any daily quota. */
+  ledger = mct_usage_ledger_new_for_user (pw->pw_uid);
+
+  if (!mct_session_limits_check_time_remaining_with_ledger (limits, now, ledger,
+                                                            &time_remaining_secs,
+                                                            &time_limit_enabled))
     {
       pam_error (handle, _("User ‘%s’ has no time remaining"), username);
       return PAM_AUTH_ERR;
@@ -204,3 +211,62 @@ pam_sm_acct_mgmt (pam_handle_t  *handle,
 
   return PAM_SUCCESS;
 }
+
+/* Record the start or end of a session in the user’s usage ledger, so that
+ * daily quotas can be enforced. Failing to record usage is logged, but doesn’t
+ * stop the session from starting or ending. */
+static int
+record_session_change (pam_handle_t *handle,
+                       gboolean      session_start)
+{
+  int retval;
+  const char *username = NULL;
+  const struct passwd *pw = NULL;
+  g_autoptr(MctUsageLedger) ledger = NULL;
+  g_autoptr(GError) local_error = NULL;
+  guint64 now = g_get_real_time ();
+  gboolean success;
+
+  /* Look up the user data from the handle. */
+  retval = get_user_data (handle, &username, &pw);
+  if (retval != PAM_SUCCESS)
+    {
+      /* The error has already been logged. */
+      return PAM_SESSION_ERR;
+    }
+
+  /* Root never has session limits, so there’s no need to record its usage. */
+  if (pw->pw_uid == 0)
+    return PAM_SUCCESS;
+
+  ledger = mct_usage_ledger_new_for_user (pw->pw_uid);
+
+  if (session_start)
+    success = mct_usage_ledger_record_session_start (ledger, now, &local_error);
+  else
+    success = mct_usage_ledger_record_session_end (ledger, now, &local_error);
+
+  if (!success)
+    pam_syslog (handle, LOG_ERR, "Failed to record session usage for user ‘%s’: %s",
+                username, local_error->message);
+
+  return PAM_SUCCESS;
+}
+
+PAM_EXTERN int
+pam_sm_open_session (pam_handle_t  *handle,
+                     int            flags,
+                     int            argc,
+                     const char   **argv)
+{
+  return record_session_change (handle, TRUE);
+}
+
+PAM_EXTERN int
+pam_sm_close_session (pam_handle_t  *handle,
+                      int            flags,
+                      int            argc,
+                      const char   **argv)
+{
+  return record_session_change (handle, FALSE);
+}
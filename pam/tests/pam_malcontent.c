@@ -52,6 +52,10 @@ test_pam_malcontent_dlopen (void)
   /* Check the appropriate symbols exist. */
   fn = dlsym (handle, "pam_sm_acct_mgmt");
   g_assert_nonnull (fn);
+  fn = dlsym (handle, "pam_sm_open_session");
+  g_assert_nonnull (fn);
+  fn = dlsym (handle, "pam_sm_close_session");
+  g_assert_nonnull (fn);
 
   retval = dlclose (handle);
   g_assert_cmpint (retval, ==, 0);